@@ -0,0 +1,247 @@
+/**
+ * @file bench_sim.cpp
+ * @author Purdue Solar Racing
+ * @brief Benchmarks and load scenarios that need the simulated bus
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_bench.hpp"
+
+#if PSR_CAN_MODE == 4
+
+#include "can_sim.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <queue>
+
+namespace PSR
+{
+
+namespace CanBench
+{
+
+static constexpr uint64_t MILLISECOND = 1000000; // Simulated time is in nanoseconds
+
+/**
+ * @brief A stream of frames sent by one node of a load scenario
+ */
+struct Stream
+{
+	uint32_t Node;   // Index of the sending node
+	uint32_t Id;     // Extended identifier, the priority field selects the latency result
+	uint64_t Period; // Time between releases in nanoseconds, 0 releases the next frames once the previous ones were sent
+	uint32_t Burst;  // Frames released at once
+	uint64_t Offset; // Time of the first release in nanoseconds
+};
+
+/**
+ * @brief Time the polled receive path, the frames are stored without a bus so only the library is measured
+ */
+static void RunReceive(Reporter& reporter, uint32_t samples)
+{
+	CanSimController controller("translate", CanSimController::MAX_RX_DEPTH);
+	CanBus bus(&controller);
+
+	CanBus::Frame frame;
+	frame.Id         = CanBus::CanId::FromParts(0x01, 0x02, 0x03, 0x04, CanBus::Priority::Normal);
+	frame.IsExtended = true;
+	frame.Length     = 8;
+	frame.Data.Value = 0x0123456789ABCDEFULL;
+
+	Samples receive;
+	for (uint32_t sample = 0; sample < samples; sample++)
+	{
+		for (uint32_t i = 0; i < CanSimController::MAX_RX_DEPTH; i++)
+			controller.Store(frame, CanBus::RX_FIFO0, 0);
+
+		CanBus::Frame received;
+		uint32_t start = CanOs::CycleCount();
+		for (uint32_t i = 0; i < CanSimController::MAX_RX_DEPTH; i++)
+			bus.Receive(received);
+		receive.Add((double)(CanOs::CycleCount() - start) / CanSimController::MAX_RX_DEPTH);
+	}
+
+	reporter.Add(receive.Summarize("rx/receive", TIME_UNIT));
+}
+
+/**
+ * @brief Run a load scenario and report its results under `load/<name>/`
+ */
+static void RunScenario(Reporter& reporter, const std::string& name, uint32_t nodes, const std::vector<Stream>& streams, uint64_t duration)
+{
+	CanSimBus simBus(500000);
+
+	std::vector<std::unique_ptr<CanSimController>> controllers;
+	std::vector<std::unique_ptr<CanBus>> buses;
+	for (uint32_t node = 0; node < nodes; node++)
+	{
+		controllers.emplace_back(new CanSimController("node"));
+		simBus.Attach(*controllers.back());
+		buses.emplace_back(new CanBus(controllers.back().get()));
+	}
+
+	// The poller accepts every frame into a FIFO with as many elements as bxCAN and polls it from a 1 ms task
+	CanSimController pollerController("poller");
+	simBus.Attach(pollerController);
+	CanBus poller(&pollerController);
+
+	CanBus::Filter all;
+	all.Type = CanBus::FilterType::ID_MASK;
+	all.Id   = 0;
+	all.Mask = 0;
+
+	uint32_t index;
+	all.IsExtended = false;
+	pollerController.AddFilter(all, CanBus::RX_FIFO0, false, index);
+	all.IsExtended = true;
+	pollerController.AddFilter(all, CanBus::RX_FIFO0, false, index);
+
+	// Frames that were released but did not fit in a mailbox wait in a software queue, highest priority first
+	auto lower = [](const CanBus::Frame& a, const CanBus::Frame& b)
+	{ return CanSimBus::ArbitrationValue(a) > CanSimBus::ArbitrationValue(b) || (a.Id == b.Id && a.Data.Words[1] > b.Data.Words[1]); };
+	std::vector<std::priority_queue<CanBus::Frame, std::vector<CanBus::Frame>, decltype(lower)>> backlogs(
+		nodes, std::priority_queue<CanBus::Frame, std::vector<CanBus::Frame>, decltype(lower)>(lower));
+
+	uint64_t begin = CanSimBus::Now();
+	uint64_t end   = begin + duration;
+
+	std::vector<uint64_t> releases(streams.size());
+	std::vector<uint32_t> outstanding(streams.size(), 0);
+	for (size_t s = 0; s < streams.size(); s++)
+		releases[s] = begin + streams[s].Offset;
+
+	// The payload carries the stream index and the release time relative to the start, which is why scenarios are limited to 4 s
+	Samples latencies[4];
+	simBus.Sent = [&](const CanSimController&, const CanBus::Frame& frame, uint64_t, uint64_t, uint64_t sent)
+	{
+		if (frame.Data.Words[0] >= streams.size())
+			return;
+
+		outstanding[frame.Data.Words[0]]--;
+		latencies[CanBus::CanId::FromValue(frame.Id).Priority].Add((double)(sent - begin - frame.Data.Words[1]) / 1000);
+	};
+
+	simBus.ResetStatistics();
+	uint64_t nextPoll = begin + MILLISECOND;
+	uint64_t polled   = 0;
+	while (CanSimBus::Now() < end)
+	{
+		uint64_t now = CanSimBus::Now();
+		for (size_t s = 0; s < streams.size(); s++)
+		{
+			const Stream& stream = streams[s];
+			bool due             = stream.Period == 0 ? outstanding[s] == 0 && releases[s] <= now : releases[s] <= now;
+			if (!due)
+				continue;
+
+			if (stream.Period == 0)
+				releases[s] = now;
+
+			for (uint32_t i = 0; i < stream.Burst; i++)
+			{
+				CanBus::Frame frame;
+				frame.Id            = stream.Id;
+				frame.IsExtended    = true;
+				frame.Length        = 8;
+				frame.Data.Words[0] = (uint32_t)s;
+				frame.Data.Words[1] = (uint32_t)(releases[s] - begin);
+				backlogs[stream.Node].push(frame);
+			}
+			outstanding[s] += stream.Burst;
+			releases[s] += stream.Period;
+		}
+
+		for (uint32_t node = 0; node < nodes; node++)
+		{
+			while (!backlogs[node].empty() && buses[node]->TryTransmit(backlogs[node].top()))
+				backlogs[node].pop();
+		}
+
+		if (now >= nextPoll)
+		{
+			CanBus::Frame frame;
+			while (poller.Receive(frame))
+				polled++;
+
+			nextPoll += MILLISECOND;
+		}
+
+		if (!simBus.Step())
+		{
+			// The bus is idle, skip to the next release or poll
+			uint64_t next = std::min(nextPoll, end);
+			for (size_t s = 0; s < streams.size(); s++)
+			{
+				if (streams[s].Period != 0)
+					next = std::min(next, releases[s]);
+			}
+
+			if (next > CanSimBus::Now())
+				CanSimBus::Advance(next - CanSimBus::Now());
+		}
+	}
+
+	const CanSimBus::Statistics& statistics = simBus.GetStatistics();
+	double seconds                          = (double)(CanSimBus::Now() - begin) / 1e9;
+
+	std::string prefix = "load/" + name + "/";
+	reporter.Add(Single(prefix + "bus_load", "%", simBus.GetLoad() * 100));
+	reporter.Add(Single(prefix + "frames_per_second", "frames/s", statistics.Frames / seconds));
+	for (uint32_t priority = 0; priority < 4; priority++)
+	{
+		if (latencies[priority].Size() != 0)
+			reporter.Add(latencies[priority].Summarize(prefix + "latency/priority=" + std::to_string(priority), "us"));
+	}
+	reporter.Add(Single(prefix + "poller_received", "frames", (double)polled));
+	reporter.Add(Single(prefix + "poller_overruns", "frames", (double)pollerController.Fifos[0].Overruns));
+}
+
+void RunSimulated(Reporter& reporter, bool quick)
+{
+	RunReceive(reporter, quick ? 31 : 200);
+
+	using CanId     = CanBus::CanId;
+	using Priority  = CanBus::Priority;
+	uint64_t length = (quick ? 200 : 2000) * MILLISECOND;
+
+	// Every node always has frames waiting, the lower priorities starve
+	RunScenario(reporter, "saturated", 4,
+	            {
+					{ 0, CanId::FromParts(0xFF, 0x01, 0x01, 0x01, Priority::Highest), 0, 3, 0 },
+					{ 1, CanId::FromParts(0xFF, 0x02, 0x01, 0x02, Priority::High), 0, 3, 0 },
+					{ 2, CanId::FromParts(0xFF, 0x03, 0x01, 0x03, Priority::Normal), 0, 3, 0 },
+					{ 3, CanId::FromParts(0xFF, 0x04, 0x01, 0x04, Priority::Low), 0, 3, 0 },
+				},
+	            length);
+
+	// Every node releases a burst at the same instant, the bus is idle in between
+	RunScenario(reporter, "bursty", 4,
+	            {
+					{ 0, CanId::FromParts(0xFF, 0x01, 0x02, 0x01, Priority::Highest), 10 * MILLISECOND, 8, 0 },
+					{ 1, CanId::FromParts(0xFF, 0x02, 0x02, 0x02, Priority::High), 10 * MILLISECOND, 8, 0 },
+					{ 2, CanId::FromParts(0xFF, 0x03, 0x02, 0x03, Priority::Normal), 10 * MILLISECOND, 8, 0 },
+					{ 3, CanId::FromParts(0xFF, 0x04, 0x02, 0x04, Priority::Low), 10 * MILLISECOND, 8, 0 },
+				},
+	            length);
+
+	// Periodic telemetry at several rates over saturated low priority traffic, like a firmware download during a run
+	RunScenario(reporter, "mixed", 4,
+	            {
+					{ 0, CanId::FromParts(0xFF, 0x01, 0x03, 0x01, Priority::Highest), 1 * MILLISECOND, 1, 0 },
+					{ 1, CanId::FromParts(0xFF, 0x02, 0x03, 0x02, Priority::High), 5 * MILLISECOND, 4, 250000 },
+					{ 2, CanId::FromParts(0xFF, 0x03, 0x03, 0x03, Priority::Normal), 10 * MILLISECOND, 8, 500000 },
+					{ 3, CanId::FromParts(0x10, 0x04, 0x03, 0x04, Priority::Low), 0, 1, 0 },
+				},
+	            length);
+}
+
+} // namespace CanBench
+
+} // namespace PSR
+
+#endif
@@ -0,0 +1,454 @@
+/**
+ * @file can_bench.cpp
+ * @author Purdue Solar Racing
+ * @brief Benchmarks of the CAN library hot paths implementation file
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_bench.hpp"
+#include "can_fdcan_ram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace PSR
+{
+
+namespace CanBench
+{
+
+static volatile uint32_t Sink; // Results are stored here so the compiler cannot remove the measured code
+
+Result Samples::Summarize(const std::string& name, const std::string& unit) const
+{
+	Result result = { name, unit, (uint32_t)this->_values.size(), 0, 0, 0, 0, 0 };
+	if (this->_values.empty())
+		return result;
+
+	std::vector<double> sorted = this->_values;
+	std::sort(sorted.begin(), sorted.end());
+
+	size_t count = sorted.size();
+	double sum   = 0;
+	for (double value : sorted)
+		sum += value;
+
+	result.Min    = sorted.front();
+	result.Max    = sorted.back();
+	result.Mean   = sum / count;
+	result.Median = count % 2 == 1 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+	result.P99    = sorted[(size_t)std::ceil(0.99 * count) - 1];
+	return result;
+}
+
+Result Single(const std::string& name, const std::string& unit, double value)
+{
+	return { name, unit, 1, value, value, value, value, value };
+}
+
+Reporter::Reporter(Format format, std::function<void(const char*)> write, const std::string& label, const std::string& platform)
+	: _format(format), _write(write), _label(label), _platform(platform), _first(true)
+{
+}
+
+/**
+ * @brief Quote a string for JSON or CSV output
+ */
+static std::string Quote(const std::string& text)
+{
+	std::string quoted = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			quoted += c == '"' ? "\\\"" : "\\\\";
+		else if ((unsigned char)c >= 0x20)
+			quoted += c;
+	}
+
+	return quoted + "\"";
+}
+
+void Reporter::Begin()
+{
+	this->_first = true;
+
+	if (this->_format == Format::JSON)
+	{
+		std::string header = "{\"library\":\"can-lib\",\"label\":" + Quote(this->_label) + ",\"platform\":" + Quote(this->_platform) + ",\"results\":[";
+		this->_write(header.c_str());
+	}
+	else
+	{
+		this->_write("label,platform,name,unit,count,min,median,mean,p99,max\n");
+	}
+}
+
+void Reporter::Add(const Result& result)
+{
+	char numbers[160];
+	if (this->_format == Format::JSON)
+	{
+		snprintf(numbers, sizeof(numbers), "\"count\":%lu,\"min\":%.3f,\"median\":%.3f,\"mean\":%.3f,\"p99\":%.3f,\"max\":%.3f", (unsigned long)result.Count,
+		         result.Min, result.Median, result.Mean, result.P99, result.Max);
+
+		std::string line = std::string(this->_first ? "\n" : ",\n") + "{\"name\":" + Quote(result.Name) + ",\"unit\":" + Quote(result.Unit) + "," + numbers + "}";
+		this->_write(line.c_str());
+	}
+	else
+	{
+		snprintf(numbers, sizeof(numbers), "%lu,%.3f,%.3f,%.3f,%.3f,%.3f\n", (unsigned long)result.Count, result.Min, result.Median, result.Mean, result.P99,
+		         result.Max);
+
+		std::string line = Quote(this->_label) + "," + Quote(this->_platform) + "," + Quote(result.Name) + "," + Quote(result.Unit) + "," + numbers;
+		this->_write(line.c_str());
+	}
+
+	this->_first = false;
+}
+
+void Reporter::End()
+{
+	if (this->_format == Format::JSON)
+		this->_write("\n]}\n");
+}
+
+void RunCore(Reporter& reporter, uint32_t samples, uint32_t iterations)
+{
+	using CanId = CanBus::CanId;
+
+	reporter.Add(Measure("canid/from_parts", samples, iterations,
+	                     [](uint32_t i) { Sink = CanId::FromParts(i & 0xFF, (i >> 8) & 0xFF, i & 0x3F, (i >> 6) & 0x1F, i & 0x3); }));
+
+	reporter.Add(Measure("canid/fields", samples, iterations,
+	                     [](uint32_t i)
+	                     {
+		                     CanId id = CanId::FromValue(i * 2654435761U);
+		                     Sink     = id.Dst + id.Src + id.Message + id.Type + id.Priority;
+	                     }));
+
+	reporter.Add(Measure("canid/mask_match", samples, iterations,
+	                     [](uint32_t i)
+	                     {
+		                     const CanId target = CanId(0x12, 0, 0, 0, 0) & CanId::DstMask();
+		                     CanId id            = CanId::FromValue(i * 2654435761U);
+		                     Sink                = (id & CanId::DstMask()) == target;
+	                     }));
+
+	// A typical telemetry frame: a float, a 16 bit value and two flags bytes
+	reporter.Add(Measure("payload/pack", samples, iterations,
+	                     [](uint32_t i)
+	                     {
+		                     CanBus::Payload payload;
+		                     float value = (float)i * 0.5f;
+		                     memcpy(&payload.Words[0], &value, sizeof(value));
+		                     payload.HalfWords[2] = (uint16_t)i;
+		                     payload.Bytes[6]     = (uint8_t)(i >> 16);
+		                     payload.Bytes[7]     = (uint8_t)(i >> 24);
+		                     Sink                 = payload.Lower ^ payload.Upper;
+	                     }));
+
+	CanBus::Payload packed[16];
+	for (uint32_t i = 0; i < 16; i++)
+		packed[i].Value = 0x9E3779B97F4A7C15ULL * (i + 1);
+
+	reporter.Add(Measure("payload/unpack", samples, iterations,
+	                     [&packed](uint32_t i)
+	                     {
+		                     const CanBus::Payload& payload = packed[i & 15];
+		                     float value;
+		                     memcpy(&value, &payload.Words[0], sizeof(value));
+		                     Sink = (uint32_t)(int32_t)value + payload.HalfWords[2] + payload.Bytes[6] + payload.Bytes[7];
+	                     }));
+}
+
+/**
+ * @brief The fields HAL_FDCAN_GetRxMessage fills in, as in FDCAN_RxHeaderTypeDef
+ */
+struct HalRxHeader
+{
+	uint32_t Identifier;
+	uint32_t IdType;
+	uint32_t RxFrameType;
+	uint32_t DataLength;
+	uint32_t ErrorStateIndicator;
+	uint32_t BitRateSwitch;
+	uint32_t FDFormat;
+	uint32_t RxTimestamp;
+	uint32_t FilterIndex;
+	uint32_t IsFilterMatchingFrame;
+};
+
+/**
+ * @brief The registers and handle state HAL_FDCAN_GetRxMessage reads
+ */
+struct HalFifo
+{
+	volatile uint32_t Status;      // RXF0S
+	volatile uint32_t Acknowledge; // RXF0A
+	volatile uint32_t State;       // The handle state, checked before every access
+	uint32_t OperationMode;        // RX FIFO 0 operation mode, overwrite mode skips the element being overwritten
+	uint32_t* Elements;            // Start address of the FIFO
+};
+
+/**
+ * @brief The steps of HAL_FDCAN_GetRxFifoFillLevel and HAL_FDCAN_GetRxMessage for RX FIFO 0 of the STM32G4 HAL
+ */
+static bool HalGetRxMessage(HalFifo& fifo, HalRxHeader& header, uint8_t* data)
+{
+	static const uint8_t dlcToBytes[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64 };
+	static constexpr uint32_t busy    = 2;
+
+	if ((fifo.Status & FdcanRam::FIFO_STATUS_FILL) == 0 || fifo.State != busy)
+		return false;
+
+	uint32_t index = 0;
+	if ((fifo.Status & (1U << 24)) != 0 && fifo.OperationMode != 0)
+		index = 1;
+	index += (fifo.Status & FdcanRam::FIFO_STATUS_GET) >> FdcanRam::FIFO_STATUS_GET_POS;
+
+	const volatile uint32_t* address = fifo.Elements + index * 18;
+	header.IdType                    = *address & FdcanRam::ELEMENT_MASK_XTD;
+	if (header.IdType == 0)
+		header.Identifier = (*address & FdcanRam::ELEMENT_MASK_STDID) >> 18;
+	else
+		header.Identifier = *address & FdcanRam::ELEMENT_MASK_EXTID;
+	header.RxFrameType         = *address & FdcanRam::ELEMENT_MASK_RTR;
+	header.ErrorStateIndicator = *address & 0x80000000U;
+	address++;
+
+	header.RxTimestamp           = *address & FdcanRam::ELEMENT_MASK_RXTS;
+	header.DataLength            = (*address & FdcanRam::ELEMENT_MASK_DLC) >> 16;
+	header.BitRateSwitch         = *address & 0x00100000U;
+	header.FDFormat              = *address & 0x00200000U;
+	header.FilterIndex           = (*address & FdcanRam::ELEMENT_MASK_FIDX) >> 24;
+	header.IsFilterMatchingFrame = (*address & FdcanRam::ELEMENT_MASK_ANMF) >> 31;
+	address++;
+
+	const volatile uint8_t* payload = reinterpret_cast<const volatile uint8_t*>(address);
+	for (uint32_t i = 0; i < dlcToBytes[header.DataLength]; i++)
+		data[i] = payload[i];
+
+	fifo.Acknowledge = index;
+	return true;
+}
+
+void RunFdcanRx(Reporter& reporter, uint32_t samples, uint32_t iterations)
+{
+	// Three elements of the fixed STM32G4 layout, two header words and 64 bytes of data, alternating standard and extended frames
+	static constexpr uint32_t elements = 3;
+	static uint32_t image[elements * 18];
+	for (uint32_t i = 0; i < elements; i++)
+	{
+		uint32_t* element = image + i * 18;
+		element[0]        = i % 2 == 0 ? (0x123U << FdcanRam::ELEMENT_STDID_POS) : (FdcanRam::ELEMENT_MASK_XTD | 0x1234567U);
+		element[1]        = (8U << FdcanRam::ELEMENT_DLC_POS) | (i << FdcanRam::ELEMENT_FIDX_POS) | (0x1000U * i);
+		element[2]        = 0x01234567U * (i + 1);
+		element[3]        = 0x89ABCDEFU * (i + 1);
+	}
+
+	HalFifo fifo = { 0, 0, 2, 0, image };
+
+	reporter.Add(Measure("rx/fdcan_translate/path=direct", samples, iterations,
+	                     [&fifo](uint32_t i)
+	                     {
+		                     fifo.Status = 1 | ((i % elements) << FdcanRam::FIFO_STATUS_GET_POS);
+
+		                     CanBus::Frame frame;
+		                     uint32_t index;
+		                     if (FdcanRam::ReadRxFifo(fifo.Status, fifo.Elements, 18, frame, index))
+			                     fifo.Acknowledge = index;
+		                     Sink = frame.Id ^ frame.Data.Lower ^ frame.Timestamp;
+	                     }));
+
+	reporter.Add(Measure("rx/fdcan_translate/path=hal", samples, iterations,
+	                     [&fifo](uint32_t i)
+	                     {
+		                     fifo.Status = 1 | ((i % elements) << FdcanRam::FIFO_STATUS_GET_POS);
+
+		                     // The conversion TranslateNextFrame applies with PSR_CAN_HAL_RX
+		                     CanBus::Frame frame;
+		                     HalRxHeader header;
+		                     if (HalGetRxMessage(fifo, header, frame.Data.Bytes))
+		                     {
+			                     bool isExtended       = header.IdType != 0;
+			                     frame.Id              = header.Identifier & (isExtended ? CanBus::EXT_ID_MASK : CanBus::STD_ID_MASK);
+			                     frame.Length          = header.DataLength;
+			                     frame.IsRTR           = header.RxFrameType != 0;
+			                     frame.IsExtended      = isExtended;
+			                     frame.IsFilterMatched = header.IsFilterMatchingFrame == 0;
+			                     frame.FilterIndex     = header.FilterIndex;
+			                     frame.Timestamp       = header.RxTimestamp;
+		                     }
+		                     Sink = frame.Id ^ frame.Data.Lower ^ frame.Timestamp;
+	                     }));
+
+	// The loop of the receive interrupt, TranslateNextFrame runs until the FIFO is empty and each acknowledge advances the get index
+	reporter.Add(Measure("rx/fdcan_translate/drain=3", samples, iterations,
+	                     [&fifo](uint32_t)
+	                     {
+		                     uint32_t status = elements;
+
+		                     CanBus::Frame frame;
+		                     uint32_t index;
+		                     while (FdcanRam::ReadRxFifo(status, fifo.Elements, 18, frame, index))
+		                     {
+			                     fifo.Acknowledge = index;
+			                     status           = ((status & FdcanRam::FIFO_STATUS_FILL) - 1) | (((index + 1) % elements) << FdcanRam::FIFO_STATUS_GET_POS);
+			                     Sink             = frame.Id ^ frame.Data.Lower;
+		                     }
+	                     }));
+}
+
+void RunBus(Reporter& reporter, CanBus& bus, const std::function<void()>& settle, uint32_t samples)
+{
+	CanOs::EnableCycleCount();
+
+	// No filter accepts this identifier, so the transmit benchmarks do not raise receive interrupts
+	CanBus::Frame frame;
+	frame.Id         = 0x7F0;
+	frame.Length     = 8;
+	frame.Data.Value = 0x0123456789ABCDEFULL;
+
+	Samples transmit;
+	for (uint32_t i = 0; i < samples; i++)
+	{
+		uint32_t start = CanOs::CycleCount();
+		bus.Transmit(frame);
+		transmit.Add(CanOs::CycleCount() - start);
+		settle();
+	}
+	reporter.Add(transmit.Summarize("tx/transmit", TIME_UNIT));
+
+	Samples tryTransmit;
+	for (uint32_t i = 0; i < samples; i++)
+	{
+		uint32_t start = CanOs::CycleCount();
+		bus.TryTransmit(frame);
+		tryTransmit.Add(CanOs::CycleCount() - start);
+		settle();
+	}
+	reporter.Add(tryTransmit.Summarize("tx/try_transmit", TIME_UNIT));
+
+	// Every transmit buffer is busy, so Transmit waits until the bus has sent a frame
+	Samples contended;
+	for (uint32_t i = 0; i < samples; i++)
+	{
+		while (bus.TryTransmit(frame)) {}
+
+		uint32_t start = CanOs::CycleCount();
+		bus.Transmit(frame);
+		contended.Add(CanOs::CycleCount() - start);
+		settle();
+	}
+	reporter.Add(contended.Summarize("tx/transmit_contended", TIME_UNIT));
+
+	// The receive interrupt is timed from its start event to its end event, each frame matches the filter added last
+	uint32_t start    = 0;
+	Samples* dispatch = nullptr;
+
+	std::function<void(const CanBus*)> previousStart = bus.RxStartEvent;
+	std::function<void(const CanBus*)> previousEnd   = bus.RxEndEvent;
+	bus.RxStartEvent = [&start](const CanBus*) { start = CanOs::CycleCount(); };
+	bus.RxEndEvent   = [&start, &dispatch](const CanBus*)
+	{
+		if (dispatch != nullptr)
+			dispatch->Add(CanOs::CycleCount() - start);
+	};
+
+	static constexpr uint32_t checkpoints[] = { 1, 2, 4, 8, 16, 28, 36 };
+
+	uint32_t added = 0;
+	CanBus::Frame matching;
+	matching.Length     = 8;
+	matching.Data.Value = 0x0123456789ABCDEFULL;
+	for (uint32_t checkpoint : checkpoints)
+	{
+		bool full = false;
+		while (added < checkpoint)
+		{
+			CanBus::Filter filter;
+			filter.Type       = CanBus::FilterType::ID_MASK;
+			filter.IsExtended = added >= 28;
+			filter.Id         = filter.IsExtended ? 0x1000 + added - 28 : 0x100 + added;
+			filter.Mask       = filter.IsExtended ? CanBus::EXT_ID_MASK : CanBus::STD_ID_MASK;
+
+			// Controllers with fewer filters stop the sweep early
+			if (!bus.AddRxCallback([](CanBus*, const CanBus::Frame& received) { Sink = received.Data.Lower; }, filter, CanBus::RX_FIFO0))
+			{
+				full = true;
+				break;
+			}
+
+			matching.Id         = filter.Id;
+			matching.IsExtended = filter.IsExtended;
+			added++;
+		}
+
+		if (full)
+			break;
+
+		Samples measured;
+		dispatch = &measured;
+		for (uint32_t i = 0; i < samples; i++)
+		{
+			bus.Transmit(matching);
+			settle();
+		}
+		dispatch = nullptr;
+
+		reporter.Add(measured.Summarize("rx/dispatch/filters=" + std::to_string(checkpoint), TIME_UNIT));
+	}
+
+	bus.RxStartEvent = previousStart;
+	bus.RxEndEvent   = previousEnd;
+}
+
+#if PSR_CAN_MODE == 2 || PSR_CAN_MODE == 4
+void RunUrgent(Reporter& reporter, CanBus& bus, const std::function<void()>& settle, uint32_t samples)
+{
+	CanBus::Filter bulkFilter;
+	bulkFilter.Type       = CanBus::FilterType::ID_MASK;
+	bulkFilter.IsExtended = false;
+	bulkFilter.Id         = 0x7E0;
+	bulkFilter.Mask       = CanBus::STD_ID_MASK;
+
+	CanBus::Filter urgentFilter = bulkFilter;
+	urgentFilter.Id             = 0x010;
+
+	uint32_t handled = 0;
+	if (!bus.AddRxCallback([](CanBus*, const CanBus::Frame& received) { Sink = received.Data.Lower; }, bulkFilter, CanBus::RX_FIFO0) ||
+	    !bus.AddRxUrgentCallback([&handled](CanBus*, const CanBus::Frame&) { handled++; }, urgentFilter))
+		return;
+
+	CanBus::Frame bulk;
+	bulk.Id         = bulkFilter.Id;
+	bulk.Length     = 8;
+	bulk.Data.Value = 0x0123456789ABCDEFULL;
+
+	CanBus::Frame urgent = bulk;
+	urgent.Id            = urgentFilter.Id;
+
+	// Each urgent frame is queued behind bulk frames, so it arrives while the bulk frames are received
+	bus.ResetUrgentLatency();
+	for (uint32_t i = 0; i < samples; i++)
+	{
+		bus.TryTransmit(bulk);
+		bus.TryTransmit(urgent);
+		bus.TryTransmit(bulk);
+		settle();
+	}
+
+	if (handled != 0)
+		reporter.Add(Single("rx/urgent/worst_latency", "bits", bus.GetUrgentWorstLatency()));
+}
+#endif
+
+} // namespace CanBench
+
+} // namespace PSR
@@ -0,0 +1,208 @@
+/**
+ * @file can_bench.hpp
+ * @author Purdue Solar Racing
+ * @brief Benchmarks of the CAN library hot paths
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * The suites in this header only use the public library interface, so they run both on the host against the simulated bus and on a
+ * target. Times are read with CanOs::CycleCount: nanoseconds on the host, core clock cycles from the DWT counter on a target.
+ */
+
+#pragma once
+
+#include "can_lib.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace PSR
+{
+
+namespace CanBench
+{
+
+#if PSR_CAN_MODE == 3 || PSR_CAN_MODE == 4
+static constexpr const char* TIME_UNIT = "ns";
+#else
+static constexpr const char* TIME_UNIT = "cycles";
+#endif
+
+/**
+ * @brief Output format of the results
+ */
+enum class Format
+{
+	JSON, // One document with a results array
+	CSV   // A header row followed by one row per result
+};
+
+/**
+ * @brief A summarized measurement
+ */
+struct Result
+{
+	std::string Name; // Benchmark name, parameters are appended as `/name=value`
+	std::string Unit; // Unit of the statistics
+	uint32_t Count;   // Number of samples
+	double Min;
+	double Median;
+	double Mean;
+	double P99;
+	double Max;
+};
+
+/**
+ * @brief Collects samples and reduces them to a Result
+ */
+class Samples
+{
+  private:
+	std::vector<double> _values;
+
+  public:
+	void Add(double value)
+	{
+		this->_values.push_back(value);
+	}
+
+	size_t Size() const
+	{
+		return this->_values.size();
+	}
+
+	/**
+	 * @brief Compute the statistics of the collected samples
+	 */
+	Result Summarize(const std::string& name, const std::string& unit) const;
+};
+
+/**
+ * @brief Create a result holding a single value
+ */
+Result Single(const std::string& name, const std::string& unit, double value);
+
+/**
+ * @brief Writes results in a machine readable format so runs of different library versions can be compared
+ */
+class Reporter
+{
+  private:
+	Format _format;
+	std::function<void(const char*)> _write;
+	std::string _label;
+	std::string _platform;
+	bool _first;
+
+  public:
+	/**
+	 * @brief Create a reporter
+	 *
+	 * @param format The output format
+	 * @param write Writes a piece of text, e.g. to stdout or a UART
+	 * @param label Identifies the run, e.g. the library version or commit
+	 * @param platform Identifies where the benchmarks ran
+	 */
+	Reporter(Format format, std::function<void(const char*)> write, const std::string& label, const std::string& platform);
+
+	/**
+	 * @brief Write the header, call once before the first result
+	 */
+	void Begin();
+
+	/**
+	 * @brief Write a result
+	 */
+	void Add(const Result& result);
+
+	/**
+	 * @brief Write the footer, call once after the last result
+	 */
+	void End();
+};
+
+/**
+ * @brief Measure a body that runs in a loop, each sample is the average time of one iteration
+ *
+ * @param name The benchmark name
+ * @param samples The number of samples
+ * @param iterations Iterations of the body per sample
+ * @param body The code to measure, called with the iteration number
+ */
+template <typename Body>
+Result Measure(const std::string& name, uint32_t samples, uint32_t iterations, Body&& body)
+{
+	CanOs::EnableCycleCount();
+
+	Samples collected;
+	for (uint32_t sample = 0; sample < samples; sample++)
+	{
+		uint32_t start = CanOs::CycleCount();
+		for (uint32_t i = 0; i < iterations; i++)
+			body(i);
+		uint32_t elapsed = CanOs::CycleCount() - start;
+
+		collected.Add((double)elapsed / iterations);
+	}
+
+	return collected.Summarize(name, TIME_UNIT);
+}
+
+/**
+ * @brief Benchmark identifier construction and masking and payload packing, needs no bus
+ */
+void RunCore(Reporter& reporter, uint32_t samples = 31, uint32_t iterations = 1000);
+
+/**
+ * @brief Benchmark reading a received frame from FDCAN message RAM, directly and through the steps of HAL_FDCAN_GetRxMessage
+ * @remark Runs on an image of a three element RX FIFO in ordinary RAM, needs no bus. The direct path is the code TranslateNextFrame runs
+ * without `PSR_CAN_HAL_RX`. The HAL path repeats what HAL_FDCAN_GetRxMessage does, followed by the conversion TranslateNextFrame applies
+ * to its result, so both can be compared on any platform.
+ */
+void RunFdcanRx(Reporter& reporter, uint32_t samples = 31, uint32_t iterations = 1000);
+
+/**
+ * @brief Benchmark transmission and receive dispatch on a bus that receives its own frames.
+ * @remark The bus must be initialized in internal loopback mode on a target, or be simulated with loopback enabled. Filters for
+ * identifiers 0x100-0x11B and 0x1000-0x1007 are added, so use a bus without other callbacks.
+ *
+ * @param reporter Receives the results
+ * @param bus The bus to measure
+ * @param settle Waits until queued frames have been sent and received, e.g. a 1 ms delay on a target or stepping the simulated bus
+ * @param samples The number of samples per benchmark
+ */
+void RunBus(Reporter& reporter, CanBus& bus, const std::function<void()>& settle, uint32_t samples = 200);
+
+#if PSR_CAN_MODE == 2 || PSR_CAN_MODE == 4
+/**
+ * @brief Measure the worst case time from the start of an urgent frame on the bus to its callback while bulk frames are received.
+ * @remark Reports GetUrgentWorstLatency in nominal bit times. Uses the same kind of bus as RunBus, with filters for identifiers 0x010 and
+ * 0x7E0, and resets the latency measurement of the bus.
+ *
+ * @param reporter Receives the results
+ * @param bus The bus to measure
+ * @param settle Waits until queued frames have been sent and received
+ * @param samples The number of urgent frames sent
+ */
+void RunUrgent(Reporter& reporter, CanBus& bus, const std::function<void()>& settle, uint32_t samples = 200);
+#endif
+
+#if PSR_CAN_MODE == 4
+/**
+ * @brief Benchmark polled reception and run the load scenarios on simulated buses.
+ * @remark Load scenarios report the bus load, the latency from release to the end of transmission per priority, and the frames lost by
+ * a node that polls a three element FIFO every millisecond. All times are simulated, so the results do not depend on the host.
+ *
+ * @param reporter Receives the results
+ * @param quick Whether to simulate 200 ms per scenario instead of 2 s
+ */
+void RunSimulated(Reporter& reporter, bool quick);
+#endif
+
+} // namespace CanBench
+
+} // namespace PSR
@@ -0,0 +1,87 @@
+/**
+ * @file main.cpp
+ * @author Purdue Solar Racing
+ * @brief Host benchmark runner on the simulated bus
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Usage: can_bench [--format json|csv] [--label <text>] [--quick]
+ */
+
+#include "can_bench.hpp"
+#include "can_sim.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace PSR;
+
+int main(int argc, char** argv)
+{
+	CanBench::Format format = CanBench::Format::JSON;
+	std::string label       = "local";
+	bool quick              = false;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+		{
+			i++;
+			if (strcmp(argv[i], "csv") == 0)
+				format = CanBench::Format::CSV;
+			else if (strcmp(argv[i], "json") == 0)
+				format = CanBench::Format::JSON;
+			else
+			{
+				fprintf(stderr, "Unknown format %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--label") == 0 && i + 1 < argc)
+		{
+			label = argv[++i];
+		}
+		else if (strcmp(argv[i], "--quick") == 0)
+		{
+			quick = true;
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [--format json|csv] [--label <text>] [--quick]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	CanBench::Reporter reporter(format, [](const char* text) { fputs(text, stdout); }, label, "host-sim");
+	reporter.Begin();
+
+	CanBench::RunCore(reporter, quick ? 11 : 31, quick ? 1000 : 10000);
+	CanBench::RunFdcanRx(reporter, quick ? 11 : 31, quick ? 1000 : 10000);
+
+	// A single controller on its own bus receives its own frames, like internal loopback on a target
+	CanSimBus simBus(500000);
+	CanSimController controller("loopback");
+	controller.Loopback = true;
+	simBus.Attach(controller);
+
+	CanBus bus(&controller);
+	bus.Init();
+	CanBench::RunBus(reporter, bus, [&simBus]() { while (simBus.Step()) {} }, quick ? 31 : 200);
+
+	// The urgent path gets a bus of its own, RunBus leaves filters on the loopback bus
+	CanSimBus urgentBus(500000);
+	CanSimController urgentController("urgent");
+	urgentController.Loopback = true;
+	urgentBus.Attach(urgentController);
+
+	CanBus urgent(&urgentController);
+	urgent.Init();
+	CanBench::RunUrgent(reporter, urgent, [&urgentBus]() { while (urgentBus.Step()) {} }, quick ? 31 : 200);
+
+	CanBench::RunSimulated(reporter, quick);
+
+	reporter.End();
+	return 0;
+}
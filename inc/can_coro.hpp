@@ -0,0 +1,420 @@
+/**
+ * @file can_coro.hpp
+ * @author Purdue Solar Racing
+ * @brief C++20 coroutine interface for awaiting CAN frames, transmissions and timeouts
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Coroutine frames are allocated from a fixed pool, its size is set with the following definitions:
+ *  - `PSR_CAN_CORO_BLOCK_SIZE`: the size of one coroutine frame in bytes (default 512), a coroutine with a larger frame cannot be spawned
+ *  - `PSR_CAN_CORO_BLOCKS`: the maximum number of live coroutines (default 64)
+ *  - `PSR_CAN_CORO_RX_QUEUE`: the number of received frames buffered between calls to Poll (default 32)
+ */
+
+#pragma once
+
+#include "can_lib.hpp"
+
+#if !defined(__cpp_impl_coroutine)
+#error "can_coro.hpp requires C++20 coroutine support"
+#endif
+
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+
+#ifndef PSR_CAN_CORO_BLOCK_SIZE
+#define PSR_CAN_CORO_BLOCK_SIZE 512
+#endif
+
+#ifndef PSR_CAN_CORO_BLOCKS
+#define PSR_CAN_CORO_BLOCKS 64
+#endif
+
+#ifndef PSR_CAN_CORO_RX_QUEUE
+#define PSR_CAN_CORO_RX_QUEUE 32
+#endif
+
+namespace PSR
+{
+
+/**
+ * @brief Fixed pool of equally sized blocks that coroutine frames are allocated from
+ */
+class CanCoroutinePool
+{
+  public:
+	static constexpr size_t BLOCK_SIZE = PSR_CAN_CORO_BLOCK_SIZE;
+	static constexpr size_t BLOCKS     = PSR_CAN_CORO_BLOCKS;
+
+  private:
+	union Block
+	{
+		Block* Next;
+		alignas(std::max_align_t) unsigned char Storage[BLOCK_SIZE];
+	};
+
+	static Block _blocks[BLOCKS];
+	static Block* _free;
+	static size_t _available;
+	static bool _initialized;
+
+  public:
+	/**
+	 * @brief Allocate a block
+	 *
+	 * @param size The number of bytes required
+	 * @return void* The block, or nullptr if the size is larger than a block or the pool is empty
+	 */
+	static void* Allocate(size_t size) noexcept;
+
+	/**
+	 * @brief Return a block to the pool
+	 *
+	 * @param block A block returned by Allocate
+	 */
+	static void Free(void* block) noexcept;
+
+	/**
+	 * @brief Get the number of free blocks
+	 */
+	static size_t Available() noexcept;
+};
+
+/**
+ * @brief A detached coroutine started by CanExecutor::Spawn.
+ *
+ * The coroutine frame is allocated from CanCoroutinePool and freed when the coroutine returns. If the pool is exhausted the task is
+ * invalid and Spawn fails.
+ */
+class CanTask
+{
+  public:
+	struct promise_type
+	{
+		CanTask get_return_object() noexcept
+		{
+			return CanTask(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+
+		static CanTask get_return_object_on_allocation_failure() noexcept
+		{
+			return CanTask(nullptr);
+		}
+
+		std::suspend_always initial_suspend() noexcept
+		{
+			return {};
+		}
+
+		std::suspend_never final_suspend() noexcept
+		{
+			return {};
+		}
+
+		void return_void() noexcept {}
+
+		void unhandled_exception() noexcept
+		{
+			std::terminate();
+		}
+
+		static void* operator new(size_t size) noexcept
+		{
+			return CanCoroutinePool::Allocate(size);
+		}
+
+		static void operator delete(void* block) noexcept
+		{
+			CanCoroutinePool::Free(block);
+		}
+	};
+
+  private:
+	std::coroutine_handle<promise_type> _handle;
+
+	explicit CanTask(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+	friend class CanExecutor;
+
+  public:
+	CanTask(CanTask&& other) noexcept : _handle(other._handle)
+	{
+		other._handle = nullptr;
+	}
+
+	CanTask(const CanTask&)            = delete;
+	CanTask& operator=(const CanTask&) = delete;
+	CanTask& operator=(CanTask&&)      = delete;
+
+	~CanTask()
+	{
+		// A task that was never spawned has not started, so its frame is released here
+		if (this->_handle)
+			this->_handle.destroy();
+	}
+
+	/**
+	 * @brief Check whether the coroutine frame was allocated
+	 */
+	bool IsValid() const
+	{
+		return (bool)this->_handle;
+	}
+};
+
+/**
+ * @brief Runs coroutines that await CAN frames, transmissions and timeouts.
+ *
+ * The executor is single threaded: coroutines only run inside Poll, which is called from the main loop. Received frames are queued from
+ * the receive callback and handed to waiting coroutines on the next Poll. Waiting coroutines are kept in intrusive lists threaded
+ * through their awaiters, so a suspended coroutine costs only its pooled frame.
+ *
+ * @code
+ * CanTask Handshake(CanExecutor& exec, CanBus& bus)
+ * {
+ *     co_await exec.Send(bus, hello);
+ *     std::optional<CanBus::Frame> reply = co_await exec.Next(bus, replyFilter, 100);
+ *     if (!reply)
+ *         co_return;
+ *     co_await exec.Timeout(10);
+ * }
+ *
+ * exec.Spawn(Handshake(exec, bus));
+ * @endcode
+ */
+class CanExecutor
+{
+  public:
+	static constexpr uint32_t MAX_BUSES     = 4;                     // Maximum number of attached buses
+	static constexpr uint32_t RX_QUEUE_SIZE = PSR_CAN_CORO_RX_QUEUE; // Received frames buffered between polls
+	static constexpr uint32_t READY_SIZE    = PSR_CAN_CORO_BLOCKS;   // Every live coroutine can be ready at once
+	static constexpr uint32_t NO_TIMEOUT    = 0xFFFFFFFF;            // Wait without a deadline
+	static constexpr uint32_t SEND_TIMEOUT  = 100;                   // Default time for a frame to be sent in milliseconds
+
+  private:
+	struct Waiter
+	{
+		Waiter* Next;                   // The next waiter in the same list
+		void* Owner;                    // The awaiter the waiter belongs to
+		std::coroutine_handle<> Handle; // The suspended coroutine
+		uint32_t Deadline;              // Tick at which the wait times out
+		bool HasDeadline;               // Whether the deadline is used
+	};
+
+	struct BusState
+	{
+		CanBus* Bus;
+		volatile uint32_t Completed; // Number of frames sent, counted from the TX interrupt
+		uint32_t Submitted;          // Number of frames queued by Send
+		uint32_t Blocked;            // Number of sends waiting for a free transmit buffer
+	};
+
+	struct Received
+	{
+		CanBus* Bus;
+		CanBus::Frame Frame;
+	};
+
+	BusState _buses[MAX_BUSES];
+	uint32_t _busCount;
+
+	Received _rxQueue[RX_QUEUE_SIZE];
+	volatile uint32_t _rxHead;
+	volatile uint32_t _rxTail;
+	volatile uint32_t _rxDropped;
+
+	std::coroutine_handle<> _ready[READY_SIZE];
+	uint32_t _readyHead;
+	uint32_t _readyCount;
+
+	Waiter* _frameWaiters;
+	Waiter* _sendWaiters;
+	Waiter* _blockedSends; // Sends waiting for a free transmit buffer, oldest first
+	Waiter* _timers;
+
+	BusState* FindBus(const CanBus* bus);
+	void Feed(CanBus* bus, const CanBus::Frame& frame);
+	void Schedule(std::coroutine_handle<> handle);
+	void Expire(Waiter*& list, uint32_t now);
+	void RetryBlockedSends(uint32_t now);
+	static void Push(Waiter*& list, Waiter* waiter);
+
+  public:
+	/**
+	 * @brief Awaits the next frame accepted by a filter, the result is empty if the wait timed out
+	 */
+	class FrameAwaiter
+	{
+	  private:
+		Waiter _waiter;
+		CanExecutor* _executor;
+		const CanBus* _bus;
+		CanBus::Filter _filter;
+		CanBus::Frame _frame;
+		bool _received;
+
+		friend class CanExecutor;
+
+	  public:
+		FrameAwaiter(CanExecutor* executor, const CanBus* bus, const CanBus::Filter& filter, uint32_t timeout);
+
+		bool await_ready() const noexcept
+		{
+			return false;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle) noexcept;
+
+		std::optional<CanBus::Frame> await_resume() const noexcept
+		{
+			if (!this->_received)
+				return std::nullopt;
+
+			return this->_frame;
+		}
+	};
+
+	/**
+	 * @brief Awaits the transmission of a frame, the result is whether it was sent before the timeout
+	 */
+	class SendAwaiter
+	{
+	  private:
+		Waiter _waiter;
+		CanExecutor* _executor;
+		BusState* _state;
+		CanBus::Frame _frame;
+		uint32_t _ticket;
+		bool _queued;
+		bool _blocked;
+
+		friend class CanExecutor;
+
+		void TakeTicket();
+
+	  public:
+		SendAwaiter(CanExecutor* executor, CanBus& bus, const CanBus::Frame& frame, uint32_t timeout);
+
+		bool await_ready() const noexcept
+		{
+			return !this->_queued && !this->_blocked;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle) noexcept;
+
+		bool await_resume() const noexcept
+		{
+			return this->_queued && (int32_t)(this->_state->Completed - this->_ticket) >= 0;
+		}
+	};
+
+	/**
+	 * @brief Awaits a delay
+	 */
+	class TimeoutAwaiter
+	{
+	  private:
+		Waiter _waiter;
+		CanExecutor* _executor;
+
+		friend class CanExecutor;
+
+	  public:
+		TimeoutAwaiter(CanExecutor* executor, uint32_t timeout);
+
+		bool await_ready() const noexcept
+		{
+			return (int32_t)(CanBus::GetTick() - this->_waiter.Deadline) >= 0;
+		}
+
+		void await_suspend(std::coroutine_handle<> handle) noexcept;
+
+		void await_resume() const noexcept {}
+	};
+
+	CanExecutor();
+
+	CanExecutor(const CanExecutor&)            = delete;
+	CanExecutor& operator=(const CanExecutor&) = delete;
+
+	/**
+	 * @brief Receive frames accepted by a filter and track transmissions on a bus
+	 * @remark Chains onto the existing TxCompleteEvent of the bus. The executor must outlive the bus.
+	 *
+	 * @param bus The bus to attach to
+	 * @param filter The filter for frames that coroutines may await
+	 * @param fifo The number of the FIFO buffer to receive from
+	 * @return bool Whether the filter was added correctly
+	 */
+	bool Attach(CanBus& bus, const CanBus::Filter& filter, uint32_t fifo);
+
+	/**
+	 * @brief Start a coroutine on the next Poll
+	 *
+	 * @param task The coroutine to start
+	 * @return bool Whether the task was valid and has been scheduled
+	 */
+	bool Spawn(CanTask&& task);
+
+	/**
+	 * @brief Await the next frame on a bus that is accepted by a filter
+	 * @remark Only frames received after the coroutine suspends are delivered, every waiting coroutine whose filter accepts a frame
+	 * receives it.
+	 *
+	 * @param bus The bus to receive from, must be attached
+	 * @param filter The filter to match against
+	 * @param timeout Time to wait in milliseconds, or NO_TIMEOUT
+	 * @return FrameAwaiter The awaitable, resumes with the frame or an empty result on timeout
+	 */
+	FrameAwaiter Next(const CanBus& bus, const CanBus::Filter& filter, uint32_t timeout = NO_TIMEOUT)
+	{
+		return FrameAwaiter(this, &bus, filter, timeout);
+	}
+
+	/**
+	 * @brief Transmit a frame and await its transmission
+	 * @remark Completions are counted per bus, so Send assumes frames leave the controller in the order they were queued and that other
+	 * code does not transmit on the bus at the same time. The executor never blocks on a full controller, the coroutine waits instead and
+	 * Poll queues its frame once a transmit buffer is free, in the order Send was called.
+	 *
+	 * @param bus The bus to transmit on, must be attached
+	 * @param frame The frame to transmit
+	 * @param timeout Time to wait for the transmission in milliseconds
+	 * @return SendAwaiter The awaitable, resumes with whether the frame was sent
+	 */
+	SendAwaiter Send(CanBus& bus, const CanBus::Frame& frame, uint32_t timeout = SEND_TIMEOUT)
+	{
+		return SendAwaiter(this, bus, frame, timeout);
+	}
+
+	/**
+	 * @brief Await a delay
+	 *
+	 * @param timeout Time to wait in milliseconds
+	 * @return TimeoutAwaiter The awaitable
+	 */
+	TimeoutAwaiter Timeout(uint32_t timeout)
+	{
+		return TimeoutAwaiter(this, timeout);
+	}
+
+	/**
+	 * @brief Deliver received frames, complete transmissions and timeouts, and run every ready coroutine, call from the main loop
+	 */
+	void Poll();
+
+	/**
+	 * @brief Get the number of frames dropped because the receive queue was full
+	 */
+	uint32_t DroppedCount() const
+	{
+		return this->_rxDropped;
+	}
+};
+
+} // namespace PSR
@@ -0,0 +1,102 @@
+/**
+ * @file can_fdcan_ram.hpp
+ * @author Purdue Solar Racing
+ * @brief Decoding of FDCAN message RAM receive elements
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Used by the FDCAN backend to read received frames without HAL_FDCAN_GetRxMessage. The functions only touch the element words and the
+ * FIFO status value they are given, so the benchmarks also run them on a message RAM image on the host.
+ */
+
+#pragma once
+
+#include "can_lib.hpp"
+
+#include <cstdint>
+
+namespace PSR
+{
+
+namespace FdcanRam
+{
+
+// Message RAM element fields, see the "Rx Buffer and FIFO Element" section of the reference manual
+static constexpr uint32_t ELEMENT_MASK_XTD   = 0x40000000U; // Extended identifier
+static constexpr uint32_t ELEMENT_MASK_RTR   = 0x20000000U; // Remote transmission request
+static constexpr uint32_t ELEMENT_MASK_EXTID = 0x1FFFFFFFU; // Extended identifier
+static constexpr uint32_t ELEMENT_MASK_STDID = 0x1FFC0000U; // Standard identifier
+static constexpr uint32_t ELEMENT_MASK_DLC   = 0x000F0000U; // Data length code
+static constexpr uint32_t ELEMENT_MASK_FIDX  = 0x7F000000U; // Filter index
+static constexpr uint32_t ELEMENT_MASK_ANMF  = 0x80000000U; // Accepted non-matching frame
+static constexpr uint32_t ELEMENT_MASK_RXTS  = 0x0000FFFFU; // Timestamp captured at the start of frame
+
+static constexpr uint32_t ELEMENT_STDID_POS = 18;
+static constexpr uint32_t ELEMENT_DLC_POS   = 16;
+static constexpr uint32_t ELEMENT_FIDX_POS  = 24;
+
+// RXF0S and RXF1S fields, the widest layout is used, the upper bits are reserved and read as 0 on controllers with smaller FIFOs
+static constexpr uint32_t FIFO_STATUS_FILL    = 0x0000007FU; // Fill level
+static constexpr uint32_t FIFO_STATUS_GET     = 0x00003F00U; // Get index
+static constexpr uint32_t FIFO_STATUS_GET_POS = 8;
+
+/**
+ * @brief Decode the header words of a message RAM element into a frame
+ *
+ * @param element The element in message RAM
+ * @param frame The frame to be updated, the payload is not modified. Timestamp holds the raw counter value
+ */
+static inline void DecodeRxHeader(const volatile uint32_t* element, CanBus::Frame& frame)
+{
+	uint32_t r0 = element[0];
+	uint32_t r1 = element[1];
+
+	bool isExtended       = (r0 & ELEMENT_MASK_XTD) != 0;
+	uint32_t dlc          = (r1 & ELEMENT_MASK_DLC) >> ELEMENT_DLC_POS;
+	frame.Id              = isExtended ? (r0 & ELEMENT_MASK_EXTID) : ((r0 & ELEMENT_MASK_STDID) >> ELEMENT_STDID_POS);
+	frame.Length          = dlc > 8 ? 8 : dlc;
+	frame.IsRTR           = (r0 & ELEMENT_MASK_RTR) != 0;
+	frame.IsExtended      = isExtended;
+	frame.IsFilterMatched = (r1 & ELEMENT_MASK_ANMF) == 0;
+	frame.FilterIndex     = (r1 & ELEMENT_MASK_FIDX) >> ELEMENT_FIDX_POS;
+	frame.Timestamp       = r1 & ELEMENT_MASK_RXTS;
+}
+
+/**
+ * @brief Copy the payload of a message RAM element into a frame using word loads
+ */
+static inline void DecodeRxPayload(const volatile uint32_t* element, CanBus::Frame& frame)
+{
+	frame.Data.Words[0] = element[2];
+	frame.Data.Words[1] = element[3];
+}
+
+/**
+ * @brief Decode the oldest element of a RX FIFO
+ * @remark The element is not released, write the returned index to the acknowledge register once the frame is no longer read
+ *
+ * @param status The value of the FIFO status register
+ * @param elements The first element of the FIFO
+ * @param elementWords The size of an element in words
+ * @param frame The frame to be updated, Timestamp holds the raw counter value
+ * @param index The index of the decoded element
+ * @return bool Whether the FIFO held a frame
+ */
+static inline bool ReadRxFifo(uint32_t status, const volatile uint32_t* elements, uint32_t elementWords, CanBus::Frame& frame, uint32_t& index)
+{
+	if ((status & FIFO_STATUS_FILL) == 0)
+		return false;
+
+	index                            = (status & FIFO_STATUS_GET) >> FIFO_STATUS_GET_POS;
+	const volatile uint32_t* element = elements + index * elementWords;
+
+	DecodeRxHeader(element, frame);
+	DecodeRxPayload(element, frame);
+	return true;
+}
+
+} // namespace FdcanRam
+
+} // namespace PSR
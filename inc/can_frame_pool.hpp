@@ -0,0 +1,182 @@
+/**
+ * @file can_frame_pool.hpp
+ * @author Purdue Solar Racing
+ * @brief Fixed pool of packed frames shared through reference counted handles
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * The number of frames in the pool is set with `PSR_CAN_FRAME_POOL_BLOCKS` (default 32).
+ */
+
+#pragma once
+
+#include "can_lib.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+#ifndef PSR_CAN_FRAME_POOL_BLOCKS
+#define PSR_CAN_FRAME_POOL_BLOCKS 32
+#endif
+
+namespace PSR
+{
+
+/**
+ * @brief Fixed pool of packed frames, a frame stays allocated while any handle refers to it.
+ *
+ * A received frame is stored once and the handle is passed to every consumer, copying a handle only updates the count. Frames are
+ * immutable once allocated, so consumers on different tasks or interrupts never see a partial update. Handles may be copied and released
+ * from interrupts.
+ */
+class CanFramePool
+{
+  public:
+	static constexpr size_t BLOCKS = PSR_CAN_FRAME_POOL_BLOCKS;
+
+	static_assert(BLOCKS > 0 && BLOCKS < 0xFFFF, "PSR_CAN_FRAME_POOL_BLOCKS must be between 1 and 65534");
+
+  private:
+	static constexpr uint16_t NONE = 0xFFFF; // Index of no block
+
+	static CanBus::PackedFrame _frames[BLOCKS];
+	static uint16_t _references[BLOCKS]; // Handles referring to each block, 0 when it is free
+	static uint16_t _next[BLOCKS];       // Next free block, only valid while the block is free
+	static uint16_t _free;
+	static size_t _available;
+	static bool _initialized;
+
+	static void Retain(uint16_t index);
+	static void Release(uint16_t index);
+
+  public:
+	/**
+	 * @brief A reference to a pooled frame, the frame is freed when the last handle is destroyed
+	 */
+	class Handle
+	{
+	  private:
+		uint16_t _index;
+
+		explicit Handle(uint16_t index) : _index(index) {}
+
+		friend class CanFramePool;
+
+	  public:
+		/**
+		 * @brief Construct a handle that refers to no frame
+		 */
+		Handle() : _index(NONE) {}
+
+		Handle(const Handle& other) : _index(other._index)
+		{
+			if (this->_index != NONE)
+				Retain(this->_index);
+		}
+
+		Handle(Handle&& other) noexcept : _index(other._index)
+		{
+			other._index = NONE;
+		}
+
+		Handle& operator=(const Handle& other)
+		{
+			if (other._index != NONE)
+				Retain(other._index);
+
+			this->Reset();
+			this->_index = other._index;
+			return *this;
+		}
+
+		Handle& operator=(Handle&& other) noexcept
+		{
+			if (this != &other)
+			{
+				this->Reset();
+				this->_index = other._index;
+				other._index = NONE;
+			}
+
+			return *this;
+		}
+
+		~Handle()
+		{
+			this->Reset();
+		}
+
+		/**
+		 * @brief Drop the reference, freeing the frame if this was the last handle
+		 */
+		void Reset()
+		{
+			if (this->_index != NONE)
+				Release(this->_index);
+
+			this->_index = NONE;
+		}
+
+		/**
+		 * @brief Check whether the handle refers to a frame
+		 */
+		explicit operator bool() const
+		{
+			return this->_index != NONE;
+		}
+
+		/**
+		 * @brief Get the packed frame, the handle must refer to a frame
+		 */
+		const CanBus::PackedFrame& operator*() const
+		{
+			return _frames[this->_index];
+		}
+
+		const CanBus::PackedFrame* operator->() const
+		{
+			return &_frames[this->_index];
+		}
+
+		/**
+		 * @brief Unpack the frame, the handle must refer to a frame
+		 */
+		CanBus::Frame ToFrame() const
+		{
+			return _frames[this->_index].ToFrame();
+		}
+
+		/**
+		 * @brief Get the number of handles referring to the frame, 0 for an empty handle
+		 */
+		uint32_t References() const;
+	};
+
+	/**
+	 * @brief Store a frame in the pool
+	 *
+	 * @param frame The frame to store
+	 * @return Handle The only handle to the frame, empty if the pool is exhausted
+	 */
+	static Handle Allocate(const CanBus::PackedFrame& frame);
+
+	/**
+	 * @brief Pack a frame and store it in the pool
+	 *
+	 * @param frame The frame to store
+	 * @return Handle The only handle to the frame, empty if the pool is exhausted
+	 */
+	static Handle Allocate(const CanBus::Frame& frame)
+	{
+		return Allocate(CanBus::PackedFrame::FromFrame(frame));
+	}
+
+	/**
+	 * @brief Get the number of free frames
+	 */
+	static size_t Available();
+};
+
+} // namespace PSR
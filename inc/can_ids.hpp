@@ -58,6 +58,10 @@ struct GenericMessage
 	static constexpr uint8_t ERRORS_2 = 0x22;
 	static constexpr uint8_t ERRORS_3 = 0x23;
 
+	// Clock synchronization, see can_time_sync.hpp
+	static constexpr uint8_t TIME_SYNC      = 0x3D;
+	static constexpr uint8_t TIME_FOLLOW_UP = 0x3E;
+
 	static constexpr uint8_t RESET = 0x3F;
 };
 
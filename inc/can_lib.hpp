@@ -10,16 +10,27 @@
 
 #pragma once
 
-#ifndef STM32_PROCESSOR
+#if defined(PSR_CAN_SOCKETCAN)
+#define PSR_CAN_MODE 3
+#elif defined(PSR_CAN_SIMULATED)
+#define PSR_CAN_MODE 4
+#elif !defined(STM32_PROCESSOR)
 #error "A STM32 processor is not selected"
 #endif
 
 #include <cstdbool>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <tuple>
 #include <vector>
 
+#if PSR_CAN_MODE == 3
+// Linux SocketCAN
+#include <mutex>
+#elif PSR_CAN_MODE == 4
+// Simulated controllers, see can_sim.hpp
+#else
 // STM32 Includes
 #include "stm32_includer.h"
 #include STM32_INCLUDE(STM32_PROCESSOR, hal.h)
@@ -46,10 +57,17 @@
 #elif PSR_CAN_MODE == 1
 #include STM32_INCLUDE(STM32_PROCESSOR, hal_can.h)
 #endif
+#endif
+
+#include "can_os.hpp"
 
 namespace PSR
 {
 
+#if PSR_CAN_MODE == 4
+class CanSimController;
+#endif
+
 class CanBus
 {
   public:
@@ -60,6 +78,19 @@ class CanBus
 	typedef FDCAN_HandleTypeDef Interface;
 #elif PSR_CAN_MODE == 1
 	typedef CAN_HandleTypeDef Interface;
+#elif PSR_CAN_MODE == 3
+	/**
+	 * @brief Represents a SocketCAN network interface
+	 */
+	struct SocketCanInterface
+	{
+		const char* Name; // Name of the network interface, e.g. "can0" or "vcan0"
+		int Socket;       // Raw CAN socket, opened by Init
+	};
+
+	typedef SocketCanInterface Interface;
+#elif PSR_CAN_MODE == 4
+	typedef CanSimController Interface;
 #endif
 
 	/**
@@ -108,6 +139,31 @@ class CanBus
 		};
 		FilterType Type;   // Type of filter
 		bool IsExtended;   // Whether the filter is an extended or standard frame
+
+		/**
+		 * @brief Check whether an identifier is accepted by the filter
+		 *
+		 * @param id The identifier to check
+		 * @param isExtended Whether the identifier is an extended identifier
+		 * @return bool Whether the identifier is accepted
+		 */
+		bool Matches(uint32_t id, bool isExtended) const
+		{
+			if (isExtended != this->IsExtended)
+				return false;
+
+			switch (this->Type)
+			{
+			case FilterType::ID_MASK:
+				return (id & this->Mask) == (this->Id & this->Mask);
+			case FilterType::DUAL:
+				return id == this->Id || id == this->Id2;
+			case FilterType::RANGE:
+				return id >= this->Id && id <= this->Id2;
+			default:
+				return false;
+			}
+		}
 	};
 
 	/**
@@ -121,14 +177,90 @@ class CanBus
 		bool IsFilterMatched; // Whether the frame matched a filter (only used when receiving frames)
 		uint32_t FilterIndex; // The filter that matched the frame (only used when receiving frames)
 		uint32_t Length;      // Length of payload in bytes
+		uint32_t Timestamp;   // Time of the frame on the bus in microseconds of the GetTimestamp clock, every value is valid as the clock wraps (only used when receiving frames)
 		Payload Data;         // CAN Payload
 
 		/**
 		 * @brief Construct a new Frame object
 		 */
-		constexpr Frame() : Id(0), IsRTR(false), IsExtended(false), IsFilterMatched(false), FilterIndex(0), Length(0), Data() {}
+		constexpr Frame() : Id(0), IsRTR(false), IsExtended(false), IsFilterMatched(false), FilterIndex(0), Length(0), Timestamp(0), Data() {}
+	};
+
+	/**
+	 * @brief A frame packed into 16 bytes for queues and pools, half the size of Frame
+	 * @remark The filter index is limited to 10 bits and the timestamp is not kept, unpacked frames have a Timestamp of 0. Keep the Frame
+	 * where the time of reception is needed.
+	 */
+	struct PackedFrame
+	{
+		static constexpr uint32_t ID_MASK       = 0x1FFFFFFF; // Identifier bits of Header
+		static constexpr uint32_t RTR_FLAG      = 1U << 29;   // Remote Transmission Request
+		static constexpr uint32_t EXTENDED_FLAG = 1U << 30;   // Extended identifier
+		static constexpr uint32_t MATCHED_FLAG  = 1U << 31;   // The frame matched a filter
+		static constexpr uint32_t LENGTH_MASK   = 0xF;        // Length bits of Info
+		static constexpr uint32_t FILTER_POS    = 4;          // Position of the filter index in Info
+		static constexpr uint32_t FILTER_MASK   = 0x3FF;      // Filter index bits of Info, after shifting
+
+		uint32_t Header; // Identifier and flags
+		uint32_t Info;   // Length and filter index, the upper 18 bits are unused
+		Payload Data;    // CAN Payload
+
+		/**
+		 * @brief Pack a frame
+		 */
+		static PackedFrame FromFrame(const Frame& frame)
+		{
+			PackedFrame packed;
+			packed.Header = (frame.Id & ID_MASK) | (frame.IsRTR ? RTR_FLAG : 0) | (frame.IsExtended ? EXTENDED_FLAG : 0) |
+			                (frame.IsFilterMatched ? MATCHED_FLAG : 0);
+			packed.Info   = (frame.Length > 8 ? 8 : frame.Length) | (frame.FilterIndex & FILTER_MASK) << FILTER_POS;
+			packed.Data   = frame.Data;
+			return packed;
+		}
+
+		/**
+		 * @brief Unpack the frame
+		 */
+		Frame ToFrame() const
+		{
+			Frame frame;
+			frame.Id              = this->Header & ID_MASK;
+			frame.IsRTR           = (this->Header & RTR_FLAG) != 0;
+			frame.IsExtended      = (this->Header & EXTENDED_FLAG) != 0;
+			frame.IsFilterMatched = (this->Header & MATCHED_FLAG) != 0;
+			frame.FilterIndex     = (this->Info >> FILTER_POS) & FILTER_MASK;
+			frame.Length          = this->Info & LENGTH_MASK;
+			frame.Data            = this->Data;
+			return frame;
+		}
+
+		/**
+		 * @brief Get the identifier without unpacking the frame
+		 */
+		uint32_t Id() const
+		{
+			return this->Header & ID_MASK;
+		}
+
+		/**
+		 * @brief Check whether the identifier is extended without unpacking the frame
+		 */
+		bool IsExtended() const
+		{
+			return (this->Header & EXTENDED_FLAG) != 0;
+		}
+
+		/**
+		 * @brief Get the payload length without unpacking the frame
+		 */
+		uint32_t Length() const
+		{
+			return this->Info & LENGTH_MASK;
+		}
 	};
 
+	static_assert(sizeof(PackedFrame) == 16, "PackedFrame must stay 16 bytes");
+
 	/**
 	 * @brief Defines a general callback for CAN
 	 *
@@ -137,12 +269,33 @@ class CanBus
 	 */
 	using Callback = std::function<void(CanBus*, const Frame&)>;
 
+#if PSR_CAN_MODE == 2
+	/**
+	 * @brief Defines a callback that reads a frame directly from FDCAN message RAM
+	 * @remark Runs inside the RX interrupt before the element is released, the payload pointer is only valid for the duration of the call
+	 *
+	 * @param frame The received CAN frame header (Data is not populated)
+	 * @param payload The payload words in message RAM
+	 * @return void
+	 */
+	using PeekCallback = std::function<void(CanBus*, const Frame&, const volatile uint32_t*)>;
+#endif
+
 	struct RxCallbackStore
 	{
 		Callback Function;
+#if PSR_CAN_MODE == 2
+		PeekCallback Peek;
+#endif
 		FilterType Type;
 		bool IsExtended;
 		uint32_t FilterNumber;
+		Filter Definition;   // The filter as it was added
+		bool Urgent = false; // Whether the callback runs in the urgent receive path
+#if PSR_CAN_MODE == 2
+		uint32_t Arrivals = 0; // Frames received since the last rebalance, counted when FIFO balancing is enabled
+		uint32_t Cycles   = 0; // Time spent dispatching those frames in CanOs::CycleCount units
+#endif
 	};
 
 	struct Priority
@@ -260,19 +413,156 @@ class CanBus
 #elif PSR_CAN_MODE == 1
 	static constexpr uint32_t RX_FIFO0 = CAN_RX_FIFO0;
 	static constexpr uint32_t RX_FIFO1 = CAN_RX_FIFO1;
+#elif PSR_CAN_MODE == 3
+	// SocketCAN has a single receive queue, the FIFO only selects which callback list a filter belongs to
+	static constexpr uint32_t RX_FIFO0 = 0;
+	static constexpr uint32_t RX_FIFO1 = 1;
+
+	static constexpr size_t RX_QUEUE_SIZE = 64; // Frames kept for Receive when no callback consumes them
+#elif PSR_CAN_MODE == 4
+	static constexpr uint32_t RX_FIFO0 = 0;
+	static constexpr uint32_t RX_FIFO1 = 1;
 #endif
 
 	static constexpr uint32_t MAX_FILTERS = 8;
 
+#if PSR_CAN_MODE == 2
+	/**
+	 * @brief Represents a transmit slot whose header is encoded once and only has its payload rewritten on each send
+	 */
+	struct TxSlot
+	{
+		uint32_t Header[2]; // Pre-encoded T0 and T1 words of the TX element
+		uint32_t Buffer;    // The dedicated TX buffer, or TX_SLOT_SHARED when sent through the TX FIFO/queue
+	};
+
+	static constexpr uint32_t TX_SLOT_SHARED = 0xFFFFFFFF;
+#endif
+
+	/**
+	 * @brief What happens to a queued frame that is no longer worth sending, see Transmit
+	 */
+	enum class TxPolicy : uint8_t
+	{
+		None,      // The frame is sent whenever it wins arbitration
+		Supersede, // A frame with the same identifier that is still waiting is replaced, only the newest value is sent
+		Deadline   // The frame is dropped if it cannot start before the deadline
+	};
+
+	/**
+	 * @brief Represents an automatic answer to remote frames, the payload is double buffered so it can be replaced while an interrupt sends it
+	 */
+	struct RtrResponder
+	{
+		Frame Response;           // Identifier, type and length of the data frame sent in response
+		Payload Buffers[2];       // The payloads, the receive interrupt only reads the one selected by Active
+		volatile uint32_t Active; // Index of the payload that is sent
+	};
+
+	/**
+	 * @brief Fault confinement state of the controller, from its transmit and receive error counters
+	 */
+	enum class ErrorState : uint8_t
+	{
+		Active,  // Both error counters are below 96
+		Warning, // An error counter reached 96
+		Passive, // An error counter reached 128, the node only sends recessive error flags
+		BusOff   // The transmit error counter passed 255, the node takes no part in bus traffic until it is recovered
+	};
+
+	static constexpr uint32_t MAX_THROTTLE_LEVEL = 7;  // At the highest level one in 128 throttled frames is sent
+	static constexpr uint32_t THROTTLE_COUNTERS  = 32; // Counters of offered frames while throttling, identifiers are hashed onto them
+
+	/**
+	 * @brief Configures bus load estimation, bus-off recovery and throttling, see SetHealthConfig
+	 */
+	struct HealthConfig
+	{
+		uint32_t Bitrate          = 0;     // Nominal bitrate in bits per second, 0 disables bus load estimation
+		uint32_t LoadWindow       = 100;   // Length of a bus load window in milliseconds, throttling is adjusted once per window
+		bool AutoRetransmission   = true;  // Whether the controller resends frames that hit an error or lost arbitration, applied by Init
+		bool AutoRecover          = true;  // Whether UpdateHealth restarts the controller after bus-off
+		uint32_t RecoveryDelay    = 10;    // Wait from bus-off to the first recovery attempt in milliseconds
+		uint32_t MaxRecoveryDelay = 1000;  // The wait doubles after every attempt up to this limit, in milliseconds
+		uint32_t StableTime       = 5000;  // Time after the last bus-off at which the wait returns to RecoveryDelay, in milliseconds
+		uint16_t ThrottleLoad     = 800;   // Bus load in tenths of a percent at which throttling increases, 0 to ignore the load
+		uint8_t ThrottleErrors    = 96;    // Transmit error count at which throttling increases, 0 to ignore the counter
+		uint32_t ThrottleId       = (uint32_t)Priority::Low << CanId::PriorityOffset; // Lowest throttled identifier, standard identifiers count as their 11 bits shifted left by 18
+	};
+
+	/**
+	 * @brief A snapshot of the bus health, see GetHealthStatus
+	 */
+	struct HealthStatus
+	{
+		ErrorState State;          // Error state read by UpdateHealth, bus-off is reported as soon as the interrupt runs
+		uint8_t TxErrors;          // Transmit error counter read by UpdateHealth
+		uint8_t RxErrors;          // Receive error counter read by UpdateHealth
+		uint8_t ThrottleLevel;     // 0 when not throttling, otherwise one in 2^level throttled frames is sent
+		uint16_t Load;             // Bus load of the last complete window in tenths of a percent
+		uint32_t BusOffCount;      // Times the controller went bus-off
+		uint32_t Recoveries;       // Recovery attempts made by UpdateHealth and RecoverBusOff
+		uint32_t ThrottledFrames;  // Frames refused by throttling
+		uint32_t SupersededFrames; // Waiting frames replaced by a newer frame sent with TxPolicy::Supersede
+		uint32_t ExpiredFrames;    // Frames sent with TxPolicy::Deadline that were dropped before they started
+	};
+
 	// Static Private Definitions
   private:
+	/**
+	 * @brief The bus health counters, fields shared with interrupts are volatile
+	 */
+	struct HealthState
+	{
+		HealthConfig Config;
+		volatile uint32_t Bits          = 0; // Bits counted in the current load window
+		uint32_t WindowStart            = 0; // Tick at which the current load window started
+		volatile ErrorState State       = ErrorState::Active;
+		uint8_t TxErrors                = 0;
+		uint8_t RxErrors                = 0;
+		volatile uint8_t ThrottleLevel  = 0;
+		uint16_t Load                   = 0;
+		volatile uint32_t BusOffCount   = 0;
+		volatile uint32_t BusOffTime    = 0;  // Tick of the last bus-off
+		volatile uint32_t RecoveryAt    = 0;  // Tick of the next recovery attempt while bus-off
+		uint32_t RecoveryDelay          = 10; // Wait before the next recovery attempt in milliseconds
+		uint32_t Recoveries             = 0;
+		volatile uint32_t Throttled     = 0;
+		volatile uint32_t Superseded    = 0;
+		volatile uint32_t Expired       = 0;
+
+		volatile uint8_t ThrottleCounts[THROTTLE_COUNTERS] = {}; // Frames offered per identifier while throttling, select the ones still sent
+	};
+
 	static std::vector<std::tuple<CanBus*, CanBus::Interface*>> RegisteredInterfaces;
 #if PSR_CAN_MODE == 2
 	static void RxCallbackFifo0(CanBus::Interface* hcan, uint32_t rxFifo0ITs);
 	static void RxCallbackFifo1(CanBus::Interface* hcan, uint32_t rxFifo0ITs);
+	static void TxCompleteCallback(CanBus::Interface* hcan, uint32_t bufferIndexes);
+	static void HighPriorityCallback(CanBus::Interface* hcan);
+	static void ErrorStatusCallback(CanBus::Interface* hcan, uint32_t errorStatusITs);
+	static void TxEventCallback(CanBus::Interface* hcan, uint32_t txEventFifoITs);
+	static void TimestampWraparoundCallback(CanBus::Interface* hcan);
+	static void TxAbortCallback(CanBus::Interface* hcan, uint32_t bufferIndexes);
+
+	static constexpr uint32_t TX_BUFFERS = 32; // Most TX buffers a message RAM holds
 #elif PSR_CAN_MODE == 1
 	static void RxCallbackFifo0(CanBus::Interface* hcan);
 	static void RxCallbackFifo1(CanBus::Interface* hcan);
+	static void TxCompleteCallback(CanBus::Interface* hcan);
+	static void ErrorCallback(CanBus::Interface* hcan);
+	static void TxAbortCallback0(CanBus::Interface* hcan);
+	static void TxAbortCallback1(CanBus::Interface* hcan);
+	static void TxAbortCallback2(CanBus::Interface* hcan);
+	static void TxAbortCallback(CanBus::Interface* hcan, uint32_t mailboxes);
+
+	static constexpr uint32_t TX_BUFFERS = 3; // Transmit mailboxes
+#elif PSR_CAN_MODE == 3
+	static void DispatchLoop();
+#elif PSR_CAN_MODE == 4
+	static void TxCompleteCallback(CanBus::Interface* hcan);
+	static void TxTimestampCallback(CanBus::Interface* hcan, const Frame& frame);
+	static void TxAbortCallback(CanBus::Interface* hcan);
 #endif
 	static void RxCallback(CanBus::Interface* hcan, uint32_t fifo);
 
@@ -281,9 +571,181 @@ class CanBus
 	Interface* _interface;                        // The handle to the CAN interface
 	std::vector<RxCallbackStore> _fifo0Callbacks; // The callbacks for FIFO 0
 	std::vector<RxCallbackStore> _fifo1Callbacks; // The callbacks for FIFO 1
+	mutable CanOs::Signal _rxSignal;              // Set when a frame is received, wakes ReceiveFor
+	mutable CanOs::Signal _txSignal;              // Set when a transmission completes, wakes TransmitFor
+	std::vector<RtrResponder> _rtrResponders;     // The remote frame responders, fixed once Init has been called
+	volatile uint32_t _rtrMissed;                 // Remote frames not answered because no transmit buffer was free
+	mutable HealthState _health;                  // Bus load, error state and throttling, updated by UpdateHealth and the interrupts
+#if PSR_CAN_MODE == 1 || PSR_CAN_MODE == 2
+	mutable uint32_t _txDeadlines[TX_BUFFERS];  // Tick by which the frame in each TX buffer must start, valid while its bit is set in _txDeadlineMask
+	mutable volatile uint32_t _txDeadlineMask;  // TX buffers holding a frame sent with TxPolicy::Deadline
+	mutable volatile uint32_t _txSupersedeMask; // TX buffers being cancelled because a newer frame replaces them
+	mutable volatile uint32_t _txExpireMask;    // TX buffers being cancelled because their deadline passed
+
+	void ApplyTxPolicy(const Frame& frame, uint32_t buffers, TxPolicy policy, uint32_t deadline) const;
+#endif
+#if PSR_CAN_MODE == 2
+	std::vector<TxSlot> _txSlots;          // The pinned transmit slots
+	volatile uint64_t _urgentClaimed;      // FIFO 1 elements whose urgent callbacks have run, indexed by element
+	volatile uint32_t _urgentWorstLatency; // Longest time from start of frame to an urgent callback in bit times
+	volatile uint32_t _urgentLost;         // Urgent frames discarded because FIFO 1 was full
+	bool _fifoBalancing;                   // Whether dispatch statistics are collected for RebalanceFifos
+	volatile uint32_t _fifoHighWater[2];   // Most elements found waiting in each RX FIFO
+	volatile uint32_t _timestampWraps;     // Times the 16 bit timestamp counter wrapped, extends it to 48 bits
+	uint32_t _timestampScale;              // Microseconds per timestamp counter tick in 16.16 fixed point, set by Init
+
+	bool ClaimUrgent(uint32_t index);
+	void RecordUrgentLatency(const volatile uint32_t* element);
+	bool AddToTxFifo(const Frame& frame, bool timestamped, TxPolicy policy, uint32_t deadline) const;
+	uint64_t ReadTimestampCounter() const;
+	uint32_t ConvertTimestamp(uint32_t captured) const;
+#elif PSR_CAN_MODE == 1
+	bool AddToMailbox(const Frame& frame, TxPolicy policy, uint32_t deadline) const;
+#elif PSR_CAN_MODE == 3
+	std::vector<Filter> _stdFilters;               // Standard ID filters, in filter index order
+	std::vector<Filter> _extFilters;               // Extended ID filters, in filter index order
+	mutable std::recursive_mutex _rxLock;          // Guards the callbacks, filters and receive queue against the dispatch thread
+	mutable Frame _rxQueue[RX_QUEUE_SIZE];         // Received frames that no callback consumed
+	mutable size_t _rxHead;                        // Index of the oldest queued frame
+	mutable size_t _rxCount;                       // Number of queued frames
+	mutable std::vector<uint32_t> _timestampedIds; // Identifiers of frames sent with TransmitTimestamped whose echo has not been received
+	mutable std::vector<uint32_t> _txIds;          // Sorted identifiers of every frame sent, the kernel filters let their echoes through
+
+	bool ApplyKernelFilters() const;
+	bool TrackTxId(uint32_t id) const;
+	void QueueFrame(const Frame& frame);
+	void HandleErrorFrame(uint32_t id, const uint8_t data[8]);
+#elif PSR_CAN_MODE == 4
+	volatile uint32_t _urgentWorstLatency; // Longest time from start of frame to an urgent callback in bit times of the simulated bus
+
+	void RecordUrgentLatency(const Frame& frame);
+#endif
 
 	static void EmptyFunction(const CanBus*) {}
 
+	/**
+	 * @brief Answer a received remote frame from the responder table, called from the receive interrupt
+	 *
+	 * @param request The received remote frame
+	 * @return bool Whether a responder exists for the identifier of the frame
+	 */
+	bool RespondRemote(const Frame& request)
+	{
+		for (RtrResponder& responder : this->_rtrResponders)
+		{
+			if (responder.Response.Id != request.Id || responder.Response.IsExtended != request.IsExtended)
+				continue;
+
+			Frame response = responder.Response;
+			response.Data  = responder.Buffers[responder.Active];
+			if (!this->TryTransmit(response))
+				this->_rtrMissed = this->_rtrMissed + 1;
+
+			return true;
+		}
+
+		return false;
+	}
+
+	/**
+	 * @brief Add a frame seen on the bus to the current load window, called for every frame sent and received
+	 */
+	void CountFrame(const Frame& frame) const
+	{
+		if (this->_health.Config.Bitrate == 0)
+			return;
+
+		uint32_t bits = EstimateFrameBits(frame);
+
+		CanOs::CriticalSection section;
+		this->_health.Bits = this->_health.Bits + bits;
+	}
+
+	/**
+	 * @brief Decide whether throttling refuses a frame, called by every transmit function before the frame is queued
+	 * @remark Identifiers are compared in arbitration order, standard identifiers as if they were the upper 11 bits of an extended one.
+	 * Frames are counted per identifier, so every message keeps one in 2^level of its frames whatever the rate of the others. Identifiers
+	 * that hash onto the same counter are thinned together.
+	 *
+	 * @return bool Whether the frame must not be sent
+	 */
+	bool Throttle(const Frame& frame) const
+	{
+		uint32_t level = this->_health.ThrottleLevel;
+		if (level == 0)
+			return false;
+
+		uint32_t id = frame.IsExtended ? frame.Id & CanBus::EXT_ID_MASK : (frame.Id & CanBus::STD_ID_MASK) << 18;
+		if (id < this->_health.Config.ThrottleId)
+			return false;
+
+		// Fibonacci hashing spreads identifiers that only differ in a few bits, like the message field of CanId, over the counters
+		uint32_t counter = (id * 2654435761U) >> 27;
+		static_assert(THROTTLE_COUNTERS == 32, "the hash selects one of 32 counters");
+
+		uint32_t count;
+		{
+			CanOs::CriticalSection section;
+			count                                 = this->_health.ThrottleCounts[counter];
+			this->_health.ThrottleCounts[counter] = (uint8_t)(count + 1);
+		}
+		if ((count & ((1U << level) - 1)) == 0)
+			return false;
+
+		this->_health.Throttled = this->_health.Throttled + 1;
+		return true;
+	}
+
+#if PSR_CAN_MODE == 1 || PSR_CAN_MODE == 2
+	/**
+	 * @brief Count the frames cancelled by a transmit policy and forget the TX buffers they used, called from the interrupt reporting the cancellation
+	 * @remark Buffers that were not being cancelled are only forgotten, the controller also reports buffers whose frame was sent anyway
+	 *
+	 * @param finished The TX buffers whose cancellation finished, one bit each
+	 * @param dropped The finished buffers whose frame was not sent
+	 */
+	void NoteTxCancelled(uint32_t finished, uint32_t dropped) const
+	{
+		uint32_t superseded = dropped & this->_txSupersedeMask;
+		uint32_t expired    = dropped & this->_txExpireMask & ~superseded;
+
+		for (; superseded != 0; superseded &= superseded - 1)
+			this->_health.Superseded = this->_health.Superseded + 1;
+		for (; expired != 0; expired &= expired - 1)
+			this->_health.Expired = this->_health.Expired + 1;
+
+		this->_txSupersedeMask = this->_txSupersedeMask & ~finished;
+		this->_txExpireMask    = this->_txExpireMask & ~finished;
+		this->_txDeadlineMask  = this->_txDeadlineMask & ~finished;
+	}
+#endif
+
+	/**
+	 * @brief Record that the controller went bus-off and schedule the recovery, safe to call from the error interrupt
+	 */
+	void NoteBusOff();
+
+	/**
+	 * @brief Read the error counters and state from the controller
+	 *
+	 * @param txErrors The transmit error counter
+	 * @param rxErrors The receive error counter
+	 * @return ErrorState The fault confinement state
+	 */
+	ErrorState ReadErrorState(uint8_t& txErrors, uint8_t& rxErrors) const;
+
+#if PSR_CAN_MODE == 2
+	/**
+	 * @brief Configure a hardware filter and store the callbacks that receive its frames.
+	 *
+	 * @param store The callbacks to store, the filter fields are filled in
+	 * @param filter The filter to match frames against.
+	 * @param fifo The number of the FIFO buffer to receive from
+	 * @return bool Whether the filter was configured correctly.
+	 */
+	bool AddRxCallbackStore(RxCallbackStore& store, const Filter& filter, uint32_t fifo);
+#endif
+
 	// Public Instance Definitions
   public:
 	std::function<void(const CanBus*)> TxStartEvent = EmptyFunction; // The event to call when a transmission starts
@@ -293,8 +755,34 @@ class CanBus
 	std::function<void(const CanBus*)> RxEndEvent   = EmptyFunction; // The event to call when a reception completes
 	std::function<void(const CanBus*)> RxErrorEvent = EmptyFunction; // The event to call when a reception errors
 
+	std::function<void(const CanBus*)> TxCompleteEvent = EmptyFunction; // The event to call when a frame has been sent on the bus (called from the TX interrupt)
+
+	std::function<void(const CanBus*, const Frame&)> TxTimestampEvent; // The event to call with the time a frame sent by TransmitTimestamped was on the bus, the payload is not included (called from the TX interrupt)
+
   public:
-	CanBus() : _interface(nullptr), _fifo0Callbacks(), _fifo1Callbacks() {}
+#if PSR_CAN_MODE == 3
+	CanBus()
+		: _interface(nullptr), _fifo0Callbacks(), _fifo1Callbacks(), _rtrResponders(), _rtrMissed(0), _health(), _stdFilters(), _extFilters(), _rxHead(0), _rxCount(0),
+		  _timestampedIds(), _txIds()
+	{
+	}
+#elif PSR_CAN_MODE == 2
+	CanBus()
+		: _interface(nullptr), _fifo0Callbacks(), _fifo1Callbacks(), _rtrResponders(), _rtrMissed(0), _health(), _txDeadlines(), _txDeadlineMask(0), _txSupersedeMask(0),
+		  _txExpireMask(0), _urgentClaimed(0), _urgentWorstLatency(0), _urgentLost(0), _fifoBalancing(false), _fifoHighWater(), _timestampWraps(0), _timestampScale(0)
+	{
+	}
+#elif PSR_CAN_MODE == 1
+	CanBus()
+		: _interface(nullptr), _fifo0Callbacks(), _fifo1Callbacks(), _rtrResponders(), _rtrMissed(0), _health(), _txDeadlines(), _txDeadlineMask(0), _txSupersedeMask(0),
+		  _txExpireMask(0)
+	{
+	}
+#elif PSR_CAN_MODE == 4
+	CanBus() : _interface(nullptr), _fifo0Callbacks(), _fifo1Callbacks(), _rtrResponders(), _rtrMissed(0), _health(), _urgentWorstLatency(0) {}
+#else
+	CanBus() : _interface(nullptr), _fifo0Callbacks(), _fifo1Callbacks(), _rtrResponders(), _rtrMissed(0), _health() {}
+#endif
 
 	/**
 	 * @brief Create a new CAN object
@@ -318,6 +806,110 @@ class CanBus
 	 */
 	bool Transmit(const Frame& frame) const;
 
+	/**
+	 * @brief Transmit a CAN frame only if a transmit buffer is free, without waiting
+	 * @remark Safe to call from an interrupt, callers transmitting on the same bus from several interrupts must serialize the calls
+	 *
+	 * @param frame The frame data to send
+	 * @return bool Whether the frame was queued for transmission
+	 */
+	bool TryTransmit(const Frame& frame) const;
+
+	/**
+	 * @brief Transmit a CAN frame and report the time it was on the bus through TxTimestampEvent
+	 * @remark The time is taken from the same clock as received frames, see GetTimestamp. Not supported on bxCAN.
+	 * - FDCAN: uses the TX event FIFO, the time is captured by the controller at the start of frame.
+	 * - SocketCAN: the time of the echo of the frame, taken by the kernel after the end of frame.
+	 *
+	 * @param frame The frame data to send
+	 * @return bool Whether the frame was queued for transmission
+	 */
+	bool TransmitTimestamped(const Frame& frame) const;
+
+	/**
+	 * @brief Transmit a CAN frame with a policy for when it is no longer worth sending
+	 * @remark Cancellations are counted in SupersededFrames and ExpiredFrames of GetHealthStatus. Frames that already started are always completed.
+	 * - FDCAN: pending TX FIFO/queue buffers are cancelled. A superseding frame is queued again, in FIFO mode it goes behind the frames queued
+	 *   since, in queue mode it keeps its place. The older frames are only cancelled once the new one is queued, a throttled frame or one
+	 *   that finds no free buffer replaces nothing.
+	 * - bxCAN: pending mailboxes are aborted once the superseding frame is queued again, which waits for a free mailbox.
+	 * - SocketCAN: frames handed to the kernel cannot be cancelled. Supersede sends the frame normally and Deadline only drops frames whose
+	 *   deadline passed before the call.
+	 * - Simulated: a superseding frame replaces the pending one in its mailbox, expired mailboxes are dropped before each arbitration.
+	 *
+	 * @param frame The frame data to send
+	 * @param policy What happens to the frame, or to earlier frames with the same identifier, when it is not sent in time
+	 * @param deadline With TxPolicy::Deadline, the GetTick value by which the frame must have started
+	 * @return bool Whether the frame was queued for transmission
+	 */
+	bool Transmit(const Frame& frame, TxPolicy policy, uint32_t deadline = 0) const;
+
+	/**
+	 * @brief Cancel the waiting frames whose TxPolicy::Deadline has passed, call every few milliseconds from the main loop
+	 * @remark Deadlines are only checked here, their resolution is the interval between calls. Does nothing on SocketCAN.
+	 */
+	void ExpireTxFrames() const;
+
+	/**
+	 * @brief Read the clock that frame timestamps are taken from
+	 * @remark FDCAN: the timestamp counter, which counts nominal bit times and is converted to microseconds. SocketCAN: CLOCK_REALTIME,
+	 * which the kernel uses for software timestamps. Simulated: the simulated time of the controller. bxCAN: the HAL tick and the SysTick
+	 * counter, received frames are stamped in software when the receive interrupt starts or when Receive reads them, after the end of frame.
+	 *
+	 * @return uint32_t The time in microseconds, wraps every 2^32 microseconds
+	 */
+	uint32_t GetTimestamp() const;
+
+	/**
+	 * @brief Whether frame timestamps are taken at the start of frame, otherwise they are taken after the end of frame
+	 */
+#if PSR_CAN_MODE == 1 || PSR_CAN_MODE == 3
+	static constexpr bool TIMESTAMP_AT_START_OF_FRAME = false;
+#else
+	static constexpr bool TIMESTAMP_AT_START_OF_FRAME = true;
+#endif
+
+#if PSR_CAN_MODE == 2
+	/**
+	 * @brief Select whether the shared TX buffers operate as a FIFO or as a priority queue.
+	 * @remark Must be called before Init. In queue mode the controller sends the pending frame with the lowest ID first.
+	 *
+	 * @param enable Whether to use TX queue mode
+	 */
+	void SetTxPriorityQueue(bool enable);
+
+	/**
+	 * @brief Pin a frame to a transmit slot so later sends only rewrite the payload.
+	 * @remark Must be called before Init. Slots use a dedicated TX buffer when the controller has them, otherwise the pre-encoded header is
+	 * written to the next free TX FIFO/queue element.
+	 *
+	 * @param frame The frame whose identifier, type and length are pinned
+	 * @param slot The handle of the new slot
+	 * @return bool Whether the slot was added correctly
+	 */
+	bool AddTxSlot(const Frame& frame, uint32_t& slot);
+
+	/**
+	 * @brief Transmit a new payload from a pinned transmit slot
+	 *
+	 * @param slot The handle returned by AddTxSlot
+	 * @param data The payload to send
+	 * @return bool Whether the frame was queued for transmission
+	 */
+	bool TransmitSlot(uint32_t slot, const Payload& data) const;
+#endif
+
+#if PSR_CAN_MODE == 3
+	/**
+	 * @brief Transmit several CAN frames with a single system call
+	 *
+	 * @param frames The frames to send
+	 * @param count The number of frames
+	 * @return size_t The number of frames that were queued by the kernel, in order
+	 */
+	size_t TransmitBatch(const Frame* frames, size_t count) const;
+#endif
+
 	/**
 	 * @brief Add a callback that receives frames that match a specific filter.
 	 *
@@ -328,6 +920,218 @@ class CanBus
 	 */
 	bool AddRxCallback(Callback callback, const Filter& filter, uint32_t fifo);
 
+	/**
+	 * @brief Add a callback for safety critical frames that runs ahead of every other receive callback.
+	 * @remark Urgent frames are always received into FIFO 1, keep bulk traffic on FIFO 0.
+	 * - FDCAN: the filter sets the high priority flag and the callback runs directly in the high priority message interrupt, routed to
+	 * interrupt line 1. Call UrgentIrqHandler from FDCANx_IT1_IRQHandler instead of HAL_FDCAN_IRQHandler, which would also service the
+	 * flags of line 0, and give FDCANx_IT1 a higher NVIC priority than FDCANx_IT0.
+	 * - bxCAN: the callback runs in the FIFO 1 interrupt, give CAN_RX1 a higher NVIC priority than CAN_RX0.
+	 * - SocketCAN: urgent callbacks run before the other callbacks of each received batch.
+	 *
+	 * @param callback The callback to run, from interrupt context on STM32
+	 * @param filter The filter to match frames against.
+	 * @return bool Whether the callback was added correctly.
+	 */
+	bool AddRxUrgentCallback(Callback callback, const Filter& filter);
+
+	/**
+	 * @brief Answer remote frames for an identifier straight from the receive interrupt with a stored payload.
+	 * @remark Must be called before Init. Remote frames answered by a responder are never passed to receive callbacks. A remote frame that
+	 * arrives while every transmit buffer is busy is not answered and counted by GetRtrMissedCount.
+	 *
+	 * @param response The data frame sent in response, its identifier and type select the remote frames that are answered and its payload
+	 * is the first response
+	 * @param fifo The number of the FIFO buffer remote frames are received in
+	 * @param responder The handle of the new responder
+	 * @return bool Whether the responder was added correctly
+	 */
+	bool AddRtrResponder(const Frame& response, uint32_t fifo, uint32_t& responder);
+
+	/**
+	 * @brief Replace the payload sent by a responder
+	 * @remark The new payload is written to the buffer the interrupt is not reading and then selected with a single store, so a response
+	 * always carries either the previous or the new payload in full. Call from a single context.
+	 *
+	 * @param responder The handle returned by AddRtrResponder
+	 * @param data The new payload
+	 * @return bool Whether the handle was valid
+	 */
+	bool UpdateRtrResponse(uint32_t responder, const Payload& data)
+	{
+		if (responder >= this->_rtrResponders.size())
+			return false;
+
+#if PSR_CAN_MODE == 3
+		// The dispatch thread is not an interrupt and may be preempted while copying, so it is excluded instead
+		std::lock_guard<std::recursive_mutex> lock(this->_rxLock);
+#endif
+		RtrResponder& entry = this->_rtrResponders[responder];
+		uint32_t next       = entry.Active ^ 1;
+		entry.Buffers[next] = data;
+		entry.Active        = next;
+		return true;
+	}
+
+	/**
+	 * @brief Get the number of remote frames that were not answered because no transmit buffer was free
+	 */
+	uint32_t GetRtrMissedCount() const
+	{
+		return this->_rtrMissed;
+	}
+
+	/**
+	 * @brief Configure bus load estimation, bus-off recovery and throttling
+	 * @remark AutoRetransmission is applied by Init, the other settings take effect immediately
+	 */
+	void SetHealthConfig(const HealthConfig& config);
+
+	/**
+	 * @brief Get the bus health configuration
+	 */
+	const HealthConfig& GetHealthConfig() const
+	{
+		return this->_health.Config;
+	}
+
+	/**
+	 * @brief Read the error counters, recover from bus-off and adjust throttling, call periodically from the main loop
+	 * @remark Bus-off is reported by the error interrupt as soon as it happens, the recovery waits RecoveryDelay and doubles the wait after
+	 * every attempt. At the end of each load window throttling increases by one level while the load or the transmit error counter is over
+	 * its threshold or the controller is error passive, and decreases by one level once both are well below.
+	 * - bxCAN: give the CAN_SCE interrupt an NVIC priority, AutoBusOff is disabled by Init when AutoRecover is set.
+	 * - FDCAN: the error status interrupts use interrupt line 0.
+	 * - SocketCAN: the state comes from kernel error frames and the kernel restarts the interface, configure it with `restart-ms`.
+	 */
+	void UpdateHealth();
+
+	/**
+	 * @brief Restart a controller that is bus-off without waiting for the recovery delay
+	 * @remark The controller rejoins the bus after 128 occurrences of 11 recessive bits
+	 *
+	 * @return bool Whether the restart was requested, false on SocketCAN where only the kernel can restart the interface
+	 */
+	bool RecoverBusOff();
+
+	/**
+	 * @brief Get a snapshot of the bus load, error state and throttling without touching the controller
+	 */
+	HealthStatus GetHealthStatus() const
+	{
+		HealthStatus status;
+		status.State            = this->_health.State;
+		status.TxErrors         = this->_health.TxErrors;
+		status.RxErrors         = this->_health.RxErrors;
+		status.ThrottleLevel    = this->_health.ThrottleLevel;
+		status.Load             = this->_health.Load;
+		status.BusOffCount      = this->_health.BusOffCount;
+		status.Recoveries       = this->_health.Recoveries;
+		status.ThrottledFrames  = this->_health.Throttled;
+		status.SupersededFrames = this->_health.Superseded;
+		status.ExpiredFrames    = this->_health.Expired;
+		return status;
+	}
+
+	/**
+	 * @brief Estimate the number of bits a frame occupies on the bus
+	 * @remark Stuff bits are counted exactly from the start of frame to the end of the data field, the stuff bits of the CRC are not known
+	 * without computing it and are estimated as one. Includes the acknowledge slot, end of frame and interframe space.
+	 */
+	static uint32_t EstimateFrameBits(const Frame& frame);
+
+#if PSR_CAN_MODE == 2 || PSR_CAN_MODE == 4
+	/**
+	 * @brief Get the longest measured time from the start of an urgent frame on the bus to its callback
+	 * @remark FDCAN measures with the timestamp counter, which counts nominal bit times and wraps every 65536 bits. The simulated bus
+	 * measures with its clock, where interrupts run as soon as a frame ends, so the result is the lower bound set by the frame length.
+	 *
+	 * @return uint32_t The worst case latency in nominal bit times
+	 */
+	uint32_t GetUrgentWorstLatency() const
+	{
+		return this->_urgentWorstLatency;
+	}
+
+	/**
+	 * @brief Restart the worst case latency measurement
+	 */
+	void ResetUrgentLatency()
+	{
+		this->_urgentWorstLatency = 0;
+	}
+#endif
+
+#if PSR_CAN_MODE == 2
+	/**
+	 * @brief Get the number of urgent frames discarded because FIFO 1 was full
+	 */
+	uint32_t GetUrgentLostCount() const
+	{
+		return this->_urgentLost;
+	}
+
+	/**
+	 * @brief Service interrupt line 1 of a FDCAN instance, call from FDCANx_IT1_IRQHandler
+	 * @remark Only the flags routed to line 1 by AddRxUrgentCallback are serviced: the high priority message flag, and on controllers that
+	 * assign lines per interrupt group also transmit complete and cancellation finished, which share its group. The frames of FIFO 0 and
+	 * FIFO 1 stay with HAL_FDCAN_IRQHandler on line 0.
+	 *
+	 * @param hcan The FDCAN handle
+	 */
+	static void UrgentIrqHandler(CanBus::Interface* hcan);
+
+	/**
+	 * @brief Enable measuring the arrivals and dispatch time of each filter so RebalanceFifos can move filters between the RX FIFOs
+	 * @remark Starts the DWT cycle counter, cores without one are balanced on arrivals only
+	 *
+	 * @param enable Whether to collect the statistics
+	 */
+	void SetFifoBalancing(bool enable);
+
+	/**
+	 * @brief Reassign filters between RX FIFO 0 and RX FIFO 1 so both carry a similar load, call periodically from the main loop
+	 * @remark The load of a filter is the time its frames spent being dispatched since the last call, which is proportional to how long they
+	 * occupy the FIFO. Urgent filters stay in FIFO 1. Filters are moved by rewriting their message RAM element while the controller runs,
+	 * frames already stored in the previous FIFO are still dispatched once to the same callbacks.
+	 *
+	 * @return bool Whether any filter was moved
+	 */
+	bool RebalanceFifos();
+
+	/**
+	 * @brief Get the most elements that were waiting in a RX FIFO when its interrupt ran
+	 *
+	 * @param fifo The number of the FIFO buffer
+	 */
+	uint32_t GetFifoHighWater(uint32_t fifo) const
+	{
+		if (fifo != CanBus::RX_FIFO0 && fifo != CanBus::RX_FIFO1)
+			return 0;
+
+		return this->_fifoHighWater[fifo == CanBus::RX_FIFO0 ? 0 : 1];
+	}
+
+	/**
+	 * @brief Restart the RX FIFO high water measurement
+	 */
+	void ResetFifoHighWater()
+	{
+		this->_fifoHighWater[0] = 0;
+		this->_fifoHighWater[1] = 0;
+	}
+
+	/**
+	 * @brief Add a callback that reads matching frames straight from message RAM inside the RX interrupt.
+	 *
+	 * @param callback The callback to run before the message RAM element is released.
+	 * @param filter The filter to match frames against.
+	 * @param fifo The number of the FIFO buffer to receive from
+	 * @return bool Whether the callback was added correctly.
+	 */
+	bool AddRxPeekCallback(PeekCallback callback, const Filter& filter, uint32_t fifo);
+#endif
+
 	/**
 	 * @brief Poll whether a new frame is available.
 	 *
@@ -336,6 +1140,39 @@ class CanBus
 	 */
 	bool Receive(Frame& frame) const;
 
+	/**
+	 * @brief Wait for a new frame, blocking the calling task until one is received or the timeout expires.
+	 * @remark Only frames from FIFOs without callbacks are returned, frames of FIFOs with callbacks are dispatched to the callbacks instead.
+	 *
+	 * @param frame The received frame. Only modified if the function returns true.
+	 * @param timeout The maximum time to wait in milliseconds
+	 * @return bool Whether a new frame was received
+	 */
+	bool ReceiveFor(Frame& frame, uint32_t timeout) const;
+
+	/**
+	 * @brief Transmit a CAN frame, blocking the calling task while the transmit buffers are full.
+	 *
+	 * @param frame The frame data to send
+	 * @param timeout The maximum time to wait for a free transmit buffer in milliseconds
+	 * @return bool Whether the frame was transmitted correctly
+	 */
+	bool TransmitFor(const Frame& frame, uint32_t timeout) const;
+
+	/**
+	 * @brief Get the current time of the clock used for CAN timeouts
+	 *
+	 * @return uint32_t The time in milliseconds
+	 */
+#if PSR_CAN_MODE == 3 || PSR_CAN_MODE == 4
+	static uint32_t GetTick();
+#else
+	static uint32_t GetTick()
+	{
+		return HAL_GetTick();
+	}
+#endif
+
 	/**
 	 * @brief Destroy the CanBus object
 	 */
@@ -0,0 +1,273 @@
+/**
+ * @file can_os.hpp
+ * @author Purdue Solar Racing
+ * @brief Operating system abstraction used by the blocking CAN calls
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * The implementation is selected at compile time:
+ *  - `PSR_CAN_SOCKETCAN` or `PSR_CAN_SIMULATED`: std::mutex and std::condition_variable
+ *  - `PSR_CAN_OS_FREERTOS`: FreeRTOS binary semaphores, the waiting task is blocked until an interrupt gives the semaphore
+ *  - otherwise: bare metal, the core sleeps with WFI until an interrupt sets the signal or the timeout expires
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#if defined(PSR_CAN_SOCKETCAN) || defined(PSR_CAN_SIMULATED)
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#elif defined(PSR_CAN_OS_FREERTOS)
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+#endif
+
+namespace PSR
+{
+
+namespace CanOs
+{
+
+#if defined(PSR_CAN_SOCKETCAN) || defined(PSR_CAN_SIMULATED)
+
+/**
+ * @brief Prevents the dispatch thread and other threads from running a section at the same time
+ */
+class CriticalSection
+{
+  private:
+	static std::recursive_mutex& Lock()
+	{
+		static std::recursive_mutex lock;
+		return lock;
+	}
+
+  public:
+	CriticalSection()
+	{
+		Lock().lock();
+	}
+
+	~CriticalSection()
+	{
+		Lock().unlock();
+	}
+
+	CriticalSection(const CriticalSection&)            = delete;
+	CriticalSection& operator=(const CriticalSection&) = delete;
+};
+
+/**
+ * @brief Start the counter read by CycleCount, nothing to do on Linux
+ */
+inline void EnableCycleCount() {}
+
+/**
+ * @brief Read a free running counter for measuring short durations, counts nanoseconds on Linux
+ */
+inline uint32_t CycleCount()
+{
+	return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief A binary signal that wakes one waiting thread
+ */
+class Signal
+{
+  private:
+	std::mutex _lock;
+	std::condition_variable _condition;
+	bool _set;
+
+  public:
+	Signal() : _lock(), _condition(), _set(false) {}
+
+	/**
+	 * @brief Set the signal and wake the waiting thread
+	 */
+	void Notify()
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->_lock);
+			this->_set = true;
+		}
+		this->_condition.notify_one();
+	}
+
+	/**
+	 * @brief Wait until the signal is set and clear it
+	 *
+	 * @param timeout The maximum time to wait in milliseconds
+	 * @return bool Whether the signal was set before the timeout
+	 */
+	bool Wait(uint32_t timeout)
+	{
+		std::unique_lock<std::mutex> lock(this->_lock);
+		bool set   = this->_condition.wait_for(lock, std::chrono::milliseconds(timeout), [this]() { return this->_set; });
+		this->_set = false;
+		return set;
+	}
+};
+
+#else
+
+/**
+ * @brief Masks interrupts for the lifetime of the object, restoring the previous mask on exit
+ */
+class CriticalSection
+{
+  private:
+	uint32_t _primask;
+
+  public:
+	CriticalSection() : _primask(__get_PRIMASK())
+	{
+		__disable_irq();
+	}
+
+	~CriticalSection()
+	{
+		__set_PRIMASK(this->_primask);
+	}
+
+	CriticalSection(const CriticalSection&)            = delete;
+	CriticalSection& operator=(const CriticalSection&) = delete;
+};
+
+/**
+ * @brief Start the DWT cycle counter read by CycleCount
+ */
+inline void EnableCycleCount()
+{
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+}
+
+/**
+ * @brief Read a free running counter for measuring short durations, counts core clock cycles
+ * @remark Cores without a DWT cycle counter (Cortex-M0/M0+) always read 0
+ */
+inline uint32_t CycleCount()
+{
+#if defined(DWT_CTRL_CYCCNTENA_Msk)
+	return DWT->CYCCNT;
+#else
+	return 0;
+#endif
+}
+
+#if defined(PSR_CAN_OS_FREERTOS)
+
+/**
+ * @brief A binary semaphore that wakes one waiting task, safe to notify from an interrupt
+ */
+class Signal
+{
+  private:
+	StaticSemaphore_t _buffer;
+	SemaphoreHandle_t _semaphore;
+
+  public:
+	Signal() : _buffer(), _semaphore(xSemaphoreCreateBinaryStatic(&_buffer)) {}
+
+	/**
+	 * @brief Set the signal and wake the waiting task
+	 */
+	void Notify()
+	{
+		if (__get_IPSR() != 0)
+		{
+			BaseType_t woken = pdFALSE;
+			xSemaphoreGiveFromISR(this->_semaphore, &woken);
+			portYIELD_FROM_ISR(woken);
+		}
+		else
+		{
+			xSemaphoreGive(this->_semaphore);
+		}
+	}
+
+	/**
+	 * @brief Block the calling task until the signal is set and clear it
+	 *
+	 * @param timeout The maximum time to wait in milliseconds
+	 * @return bool Whether the signal was set before the timeout
+	 */
+	bool Wait(uint32_t timeout)
+	{
+		return xSemaphoreTake(this->_semaphore, pdMS_TO_TICKS(timeout)) == pdTRUE;
+	}
+};
+
+#else
+
+/**
+ * @brief A flag set from an interrupt, waiting sleeps the core until the next interrupt
+ */
+class Signal
+{
+  private:
+	volatile bool _set;
+
+  public:
+	Signal() : _set(false) {}
+
+	/**
+	 * @brief Set the signal
+	 */
+	void Notify()
+	{
+		this->_set = true;
+	}
+
+	/**
+	 * @brief Sleep until the signal is set and clear it
+	 * @remark Must not be called from an interrupt. The tick interrupt wakes the core at least once per millisecond, so the timeout is still
+	 * checked.
+	 *
+	 * @param timeout The maximum time to wait in milliseconds
+	 * @return bool Whether the signal was set before the timeout
+	 */
+	bool Wait(uint32_t timeout)
+	{
+		uint32_t tickStart = HAL_GetTick();
+		while (true)
+		{
+			uint32_t primask = __get_PRIMASK();
+			__disable_irq();
+
+			if (this->_set)
+			{
+				this->_set = false;
+				__set_PRIMASK(primask);
+				return true;
+			}
+
+			if ((HAL_GetTick() - tickStart) >= timeout)
+			{
+				__set_PRIMASK(primask);
+				return false;
+			}
+
+			// A pending interrupt ends WFI even while masked, so a notification after the check is not missed
+			__WFI();
+			__set_PRIMASK(primask);
+		}
+	}
+};
+
+#endif
+
+#endif
+
+} // namespace CanOs
+
+} // namespace PSR
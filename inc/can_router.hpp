@@ -0,0 +1,172 @@
+/**
+ * @file can_router.hpp
+ * @author Purdue Solar Racing
+ * @brief Gateway that forwards frames between CAN buses
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "can_lib.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace PSR
+{
+
+/**
+ * @brief Forwards frames between buses according to a routing table.
+ *
+ * Each route adds a filter on its source bus. Frames are forwarded from the receive interrupt, on FDCAN the payload is read straight from
+ * the RX FIFO element and written straight into a TX queue element. When the destination has no free transmit buffer the frame waits in a
+ * per destination queue ordered by arbitration priority, which is drained from the transmit complete interrupt. FDCAN destinations are
+ * switched to TX queue mode so the controller also sends pending frames lowest ID first.
+ *
+ * A frame is forwarded by every route of its source bus that accepts it, so routes may fan out to several destinations.
+ */
+class CanRouter
+{
+  public:
+	static constexpr uint32_t MAX_ROUTES = 16; // Maximum number of routes
+	static constexpr uint32_t MAX_BUSES  = 4;  // Maximum number of destination buses
+	static constexpr uint32_t QUEUE_SIZE = 32; // Frames held per destination while its transmit buffers are full
+
+	/**
+	 * @brief Describes which frames are forwarded and how
+	 */
+	struct Route
+	{
+		CanBus* Source;        // The bus frames are received from
+		CanBus::Filter Match;  // The frames that are forwarded
+		CanBus* Destination;   // The bus frames are sent on
+		uint32_t RewriteMask;  // Identifier bits replaced before sending
+		uint32_t RewriteValue; // New value of the replaced bits
+		uint32_t Rate;         // Maximum average frames per second, 0 for no limit
+		uint32_t Burst;        // Frames that may be sent back to back while under the average rate
+
+		/**
+		 * @brief Create a route that forwards frames unchanged
+		 *
+		 * @param source The bus frames are received from
+		 * @param match The frames that are forwarded
+		 * @param destination The bus frames are sent on
+		 */
+		Route(CanBus& source, const CanBus::Filter& match, CanBus& destination)
+			: Source(&source), Match(match), Destination(&destination), RewriteMask(0), RewriteValue(0), Rate(0), Burst(0)
+		{
+		}
+
+		/**
+		 * @brief Replace identifier bits of forwarded frames, `id = (id & ~mask) | (value & mask)`
+		 */
+		Route& Rewrite(uint32_t mask, uint32_t value)
+		{
+			this->RewriteMask  = mask;
+			this->RewriteValue = value;
+			return *this;
+		}
+
+		/**
+		 * @brief Limit the rate of forwarded frames, frames over the limit are dropped
+		 *
+		 * @param rate Maximum average frames per second
+		 * @param burst Frames that may be sent back to back, at least 1
+		 */
+		Route& Limit(uint32_t rate, uint32_t burst)
+		{
+			this->Rate  = rate;
+			this->Burst = burst > 0 ? burst : 1;
+			return *this;
+		}
+	};
+
+	/**
+	 * @brief Counts what happened to the frames a route accepted
+	 */
+	struct Counters
+	{
+		uint32_t Forwarded;   // Frames handed to the destination
+		uint32_t RateLimited; // Frames dropped by the rate limit
+		uint32_t Overflowed;  // Frames dropped because the destination queue was full
+	};
+
+  private:
+	struct RouteState
+	{
+		Route Config;
+		uint32_t Tokens;   // Rate limit budget in thousandths of a frame
+		uint32_t LastTick; // Tick of the last budget update
+		volatile uint32_t Forwarded;
+		volatile uint32_t RateLimited;
+		volatile uint32_t Overflowed;
+
+		RouteState(const Route& route);
+	};
+
+	struct Pending
+	{
+		uint32_t Priority; // Arbitration order, lower is sent first
+		uint32_t Sequence; // Order of arrival among frames with the same priority
+		CanBus::PackedFrame Frame;
+	};
+
+	struct Destination
+	{
+		CanBus* Bus;
+		Pending Queue[QUEUE_SIZE]; // Binary min-heap on priority then sequence
+		uint32_t Count;
+		uint32_t Sequence;
+		uint32_t HighWater;
+	};
+
+	std::vector<RouteState> _routes; // Reserved up front so interrupts never see a reallocation
+	Destination _destinations[MAX_BUSES];
+	uint32_t _destinationCount;
+
+	static uint32_t Priority(const CanBus::Frame& frame);
+	static bool Before(const Pending& a, const Pending& b);
+
+	Destination* FindDestination(const CanBus* bus);
+	bool TakeToken(RouteState& route);
+	void Enqueue(Destination& destination, const CanBus::Frame& frame);
+	void Drain(Destination& destination);
+	void Forward(CanBus* source, const CanBus::Frame& frame);
+
+  public:
+	CanRouter();
+
+	CanRouter(const CanRouter&)            = delete;
+	CanRouter& operator=(const CanRouter&) = delete;
+
+	/**
+	 * @brief Add a route
+	 * @remark Must be called before Init of the buses involved. Chains onto the existing TxCompleteEvent of a new destination bus. The
+	 * router must outlive the buses.
+	 *
+	 * @param route The route to add
+	 * @param fifo The number of the FIFO buffer of the source bus to receive from
+	 * @param index The handle of the new route, used to read its counters
+	 * @return bool Whether the route was added correctly
+	 */
+	bool AddRoute(const Route& route, uint32_t fifo, uint32_t& index);
+
+	/**
+	 * @brief Get the counters of a route
+	 *
+	 * @param index The handle returned by AddRoute
+	 * @return Counters A snapshot of the counters, all zero for an unknown handle
+	 */
+	Counters GetCounters(uint32_t index) const;
+
+	/**
+	 * @brief Get the most frames that have waited for a destination bus at once
+	 */
+	uint32_t GetQueueHighWater(const CanBus& bus) const;
+};
+
+} // namespace PSR
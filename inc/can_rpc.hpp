@@ -0,0 +1,138 @@
+/**
+ * @file can_rpc.hpp
+ * @author Purdue Solar Racing
+ * @brief Asynchronous request/response over CAN
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "can_lib.hpp"
+
+#include <cstdint>
+#include <functional>
+
+namespace PSR
+{
+
+/**
+ * @brief Sends requests to other nodes and matches their replies without blocking.
+ *
+ * A reply to a request sent to node `Dst` with message `Message` is the next extended frame with `Src == Dst`, `Dst == NodeId` and the
+ * same message ID. Outstanding requests are kept in an open addressing table keyed on the peer and message ID, so a reply is matched in
+ * constant time regardless of how many requests are in flight.
+ */
+class CanRpc
+{
+  public:
+	/**
+	 * @brief Represents the outcome of a request
+	 */
+	enum class Status : uint8_t
+	{
+		OK,         // A reply was received
+		TIMEOUT,    // No reply was received before the deadline
+		SEND_FAILED // The request could not be queued for transmission before the deadline
+	};
+
+	/**
+	 * @brief Defines the callback run when a request completes
+	 *
+	 * @param status The outcome of the request
+	 * @param reply The reply frame, only valid when status is OK
+	 * @return void
+	 */
+	using Completion = std::function<void(Status, const CanBus::Frame&)>;
+
+	static constexpr uint32_t MAX_PENDING = 32; // Maximum number of outstanding requests
+
+  private:
+	static constexpr uint32_t TABLE_SIZE = 2 * MAX_PENDING; // Power of two, at most half full
+	static constexpr uint16_t EMPTY_KEY  = 0xFFFF;
+
+	struct Pending
+	{
+		uint16_t Key;          // Peer and message ID of the request, EMPTY_KEY when unused
+		bool Sent;             // Whether the request was queued for transmission, replies to unsent requests are ignored
+		uint32_t Deadline;     // Tick at which the request times out
+		CanBus::Frame Request; // The request frame, kept until it was queued
+		Completion Done;       // The completion callback
+	};
+
+	CanBus* _bus;               // The bus requests are sent on
+	uint8_t _nodeId;            // The ID replies are addressed to
+	Pending _table[TABLE_SIZE]; // Outstanding requests
+	uint32_t _count;            // Number of outstanding requests
+
+	static constexpr uint16_t MakeKey(uint32_t peer, uint32_t message)
+	{
+		return (uint16_t)((peer << 6) | message);
+	}
+
+	static constexpr uint32_t Home(uint16_t key)
+	{
+		return (((uint32_t)key * 0x9E3779B1U) >> 16) & (TABLE_SIZE - 1);
+	}
+
+	uint32_t Find(uint16_t key) const;
+	void Remove(uint32_t index);
+	bool Send(uint16_t key, const CanBus::Frame& request);
+
+  public:
+	/**
+	 * @brief Create a new request/response layer
+	 *
+	 * @param bus The bus requests are sent on
+	 * @param nodeId The ID of this node, replies must be addressed to it
+	 */
+	CanRpc(CanBus& bus, uint8_t nodeId);
+
+	/**
+	 * @brief Register the filter that receives replies addressed to this node
+	 * @remark The request/response layer must outlive the bus
+	 *
+	 * @param fifo The number of the FIFO buffer to receive from
+	 * @return bool Whether the filter was added correctly
+	 */
+	bool Attach(uint32_t fifo);
+
+	/**
+	 * @brief Send a request and register its completion
+	 * @remark The request is queued without blocking. When every transmit buffer is busy, Poll sends it again until the deadline, a request
+	 * still unsent at the deadline completes with SEND_FAILED.
+	 *
+	 * @param request The request frame, its CanId Dst and Message fields identify the reply
+	 * @param timeout Time to wait for the reply in milliseconds
+	 * @param done The callback run exactly once when the request completes
+	 * @return bool Whether the request was registered, done is not called when false is returned
+	 */
+	bool Request(const CanBus::Frame& request, uint32_t timeout, Completion done);
+
+	/**
+	 * @brief Complete the request that a received frame replies to
+	 *
+	 * @param bus The bus the frame was received on
+	 * @param frame The received frame
+	 * @return bool Whether the frame was a reply to an outstanding request
+	 */
+	bool OnFrame(CanBus* bus, const CanBus::Frame& frame);
+
+	/**
+	 * @brief Send requests that could not be queued before and time out expired requests, call periodically from the main loop
+	 */
+	void Poll();
+
+	/**
+	 * @brief Get the number of outstanding requests
+	 */
+	uint32_t PendingCount() const
+	{
+		return this->_count;
+	}
+};
+
+} // namespace PSR
@@ -0,0 +1,319 @@
+/**
+ * @file can_sim.hpp
+ * @author Purdue Solar Racing
+ * @brief Simulated CAN controllers and bus for running the library on a host without hardware
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Defining `PSR_CAN_SIMULATED` instead of `STM32_PROCESSOR` builds the simulated backend. Every CanBus is given a CanSimController as
+ * its interface handle, and controllers attached to the same CanSimBus exchange frames through a model of arbitration and bit timing.
+ * The simulation is single threaded and only advances when the bus is stepped, so runs are deterministic.
+ */
+
+#pragma once
+
+#include "can_lib.hpp"
+
+#if PSR_CAN_MODE != 4
+#error "can_sim.hpp requires PSR_CAN_SIMULATED"
+#endif
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace PSR
+{
+
+class CanSimBus;
+
+/**
+ * @brief A simulated CAN controller, the interface handle of CanBus in simulated builds.
+ *
+ * Models the parts of bxCAN and FDCAN the library relies on: three transmit mailboxes, two receive FIFOs that drop new frames while full,
+ * and acceptance filters that reject frames no filter matches. Remote frames are only accepted by remote filters, like the FDCAN global
+ * filter. The pending mailbox with the lowest identifier enters arbitration first, mailboxes whose deadline passed are dropped before. The
+ * error counters are not changed by the bus, tests set them to inject faults. Each controller timestamps frames with its own clock, which can be offset and drift from the bus clock.
+ */
+class CanSimController
+{
+  public:
+	static constexpr uint32_t TX_MAILBOXES    = 3;  // Transmit mailboxes, as on bxCAN and the STM32G4 FDCAN
+	static constexpr uint32_t MAX_STD_FILTERS = 28; // Standard filter elements, as on the STM32G4 FDCAN
+	static constexpr uint32_t MAX_EXT_FILTERS = 8;  // Extended filter elements, as on the STM32G4 FDCAN
+	static constexpr uint32_t MAX_RX_DEPTH    = 64; // Largest supported receive FIFO
+
+	/**
+	 * @brief An acceptance filter element
+	 */
+	struct FilterElement
+	{
+		CanBus::Filter Definition; // The frames that are accepted
+		uint32_t Fifo;             // The FIFO accepted frames are stored in
+		bool Remote;               // Whether the element accepts remote frames instead of data frames
+	};
+
+	/**
+	 * @brief A transmit mailbox
+	 */
+	struct Mailbox
+	{
+		CanBus::Frame Frame; // The frame waiting for arbitration
+		uint64_t Queued;     // Simulated time the frame was queued in nanoseconds
+		uint64_t Deadline;   // Simulated time by which the frame must start in nanoseconds, 0 when it does not expire
+		bool Pending;        // Whether the mailbox holds a frame
+		bool Timestamped;    // Whether the time the frame is sent is reported through TxTimestampCallback
+	};
+
+	/**
+	 * @brief A receive FIFO
+	 */
+	struct RxFifo
+	{
+		CanBus::Frame Elements[MAX_RX_DEPTH];
+		uint32_t Head;      // Index of the oldest frame
+		uint32_t Count;     // Number of stored frames
+		uint32_t Overruns;  // Frames dropped because the FIFO was full
+		uint32_t HighWater; // Most frames stored at once
+	};
+
+	void (*RxFifoCallback)(CanSimController* controller, uint32_t fifo);                   // Receive interrupt, raised after a frame is stored
+	void (*TxCompleteCallback)(CanSimController* controller);                              // Transmit interrupt, raised after a frame is sent
+	void (*TxTimestampCallback)(CanSimController* controller, const CanBus::Frame& frame); // Transmit event, raised after a timestamped frame is sent
+	void (*TxAbortCallback)(CanSimController* controller);                                 // Transmit interrupt, raised after a frame is dropped at its deadline
+
+	const char* Name;    // Name shown in benchmark and debug output
+	CanSimBus* Bus;      // The bus the controller is attached to
+	uint32_t RxDepth;    // Elements per receive FIFO
+	bool Loopback;       // Whether sent frames are also received by this controller
+	uint32_t TxErrors;   // Transmit error counter, over 255 the controller is bus-off and neither sends nor receives
+	uint32_t RxErrors;   // Receive error counter
+	int64_t ClockOffset; // Offset of the timestamp clock from the bus clock in nanoseconds
+	int32_t ClockDrift;  // Rate error of the timestamp clock in parts per million
+
+	Mailbox Mailboxes[TX_MAILBOXES];
+	RxFifo Fifos[2];
+	std::vector<FilterElement> StdFilters; // Standard filter elements, in filter index order
+	std::vector<FilterElement> ExtFilters; // Extended filter elements, in filter index order
+
+	/**
+	 * @brief Create a controller that is not attached to a bus
+	 *
+	 * @param name Name shown in benchmark and debug output
+	 * @param rxDepth Elements per receive FIFO, at most MAX_RX_DEPTH
+	 */
+	CanSimController(const char* name, uint32_t rxDepth = 3);
+
+	CanSimController(const CanSimController&)            = delete;
+	CanSimController& operator=(const CanSimController&) = delete;
+
+	/**
+	 * @brief Add an acceptance filter element
+	 *
+	 * @param filter The frames that are accepted
+	 * @param fifo The FIFO accepted frames are stored in
+	 * @param remote Whether the element accepts remote frames instead of data frames
+	 * @param index The filter index reported with accepted frames
+	 * @return bool Whether a filter element was free
+	 */
+	bool AddFilter(const CanBus::Filter& filter, uint32_t fifo, bool remote, uint32_t& index);
+
+	/**
+	 * @brief Get the number of free transmit mailboxes
+	 */
+	uint32_t FreeMailboxes() const;
+
+	/**
+	 * @brief Queue a frame in a free transmit mailbox
+	 *
+	 * @param frame The frame to send
+	 * @param timestamped Whether to raise TxTimestampCallback with the time the frame is sent
+	 * @param deadline Simulated time by which the frame must start in nanoseconds, 0 when it does not expire
+	 * @return bool Whether a mailbox was free
+	 */
+	bool Queue(const CanBus::Frame& frame, bool timestamped = false, uint64_t deadline = 0);
+
+	/**
+	 * @brief Replace the frame of the pending mailbox with the same identifier and type, the mailbox keeps its place
+	 *
+	 * @param frame The newer frame
+	 * @return bool Whether a pending mailbox held a frame with the same identifier
+	 */
+	bool Replace(const CanBus::Frame& frame);
+
+	/**
+	 * @brief Drop the pending frames whose deadline has passed, raising TxAbortCallback for each of them
+	 *
+	 * @return uint32_t The number of frames dropped
+	 */
+	uint32_t ExpireMailboxes();
+
+	/**
+	 * @brief Convert a time of the bus clock to the timestamp clock of the controller
+	 *
+	 * @param time The bus time in nanoseconds
+	 * @return int64_t The local time in nanoseconds, negative before a negative offset has passed
+	 */
+	int64_t LocalTime(uint64_t time) const
+	{
+		return (int64_t)time + this->ClockOffset + (int64_t)time * this->ClockDrift / 1000000;
+	}
+
+	/**
+	 * @brief Run a frame seen on the bus through the filters and store it if accepted
+	 *
+	 * @return bool Whether the frame was stored
+	 */
+	bool Accept(const CanBus::Frame& frame);
+
+	/**
+	 * @brief Store a frame as if a filter had accepted it and raise the receive interrupt
+	 *
+	 * @param frame The frame to store
+	 * @param fifo The FIFO to store it in
+	 * @param filterIndex The filter index reported with the frame
+	 * @return bool Whether the FIFO had room
+	 */
+	bool Store(const CanBus::Frame& frame, uint32_t fifo, uint32_t filterIndex);
+
+	/**
+	 * @brief Read and remove the oldest frame of a FIFO
+	 *
+	 * @return bool Whether the FIFO held a frame
+	 */
+	bool Pop(uint32_t fifo, CanBus::Frame& frame);
+};
+
+/**
+ * @brief A simulated bus that connects CanSimController instances.
+ *
+ * Each step sends one frame: the pending mailbox with the lowest arbitration value across every attached controller wins, the clock
+ * advances by the exact length of the frame including stuff bits and interframe space, and the frame is offered to the filters of every
+ * other controller. All buses share one simulated clock, which is also the clock returned by CanBus::GetTick.
+ */
+class CanSimBus
+{
+  public:
+	/**
+	 * @brief Reports a frame that was sent
+	 *
+	 * @param sender The controller that won arbitration
+	 * @param frame The frame that was sent
+	 * @param queued Time the frame was queued in its mailbox in nanoseconds
+	 * @param start Time the start of frame bit was sent in nanoseconds
+	 * @param end Time the interframe space ended in nanoseconds
+	 */
+	using SentHandler = std::function<void(const CanSimController& sender, const CanBus::Frame& frame, uint64_t queued, uint64_t start, uint64_t end)>;
+
+	/**
+	 * @brief Counts the traffic sent since the last reset
+	 */
+	struct Statistics
+	{
+		uint64_t Frames;   // Frames sent
+		uint64_t Bits;     // Bits sent, including stuff bits and interframe space
+		uint64_t BusyTime; // Time the bus was not idle in nanoseconds
+		uint64_t Since;    // Time of the last reset in nanoseconds
+	};
+
+  private:
+	static uint64_t _now;
+
+	uint32_t _bitrate;
+	uint64_t _bitTime;
+	std::vector<CanSimController*> _controllers;
+	Statistics _statistics;
+	bool _stepping;
+
+  public:
+	SentHandler Sent; // Called after every frame that is sent
+
+	/**
+	 * @brief Create a bus
+	 *
+	 * @param bitrate The nominal bitrate in bits per second
+	 */
+	explicit CanSimBus(uint32_t bitrate = 500000);
+
+	CanSimBus(const CanSimBus&)            = delete;
+	CanSimBus& operator=(const CanSimBus&) = delete;
+
+	/**
+	 * @brief Connect a controller to the bus
+	 */
+	void Attach(CanSimController& controller);
+
+	/**
+	 * @brief Send the frame that wins arbitration
+	 * @remark Receive and transmit interrupts of the controllers run inside the call. Calls made from those interrupts do nothing.
+	 *
+	 * @return bool Whether a frame was sent, false when no mailbox is pending
+	 */
+	bool Step();
+
+	/**
+	 * @brief Send frames until no mailbox is pending or the clock reaches a time, idle time is skipped
+	 *
+	 * @param until The simulated time to stop at in nanoseconds
+	 */
+	void RunUntil(uint64_t until);
+
+	/**
+	 * @brief Get the nominal bitrate in bits per second
+	 */
+	uint32_t GetBitrate() const
+	{
+		return this->_bitrate;
+	}
+
+	/**
+	 * @brief Get the traffic sent since the last reset
+	 */
+	const Statistics& GetStatistics() const
+	{
+		return this->_statistics;
+	}
+
+	/**
+	 * @brief Get the fraction of time the bus was busy since the last reset, between 0 and 1
+	 */
+	double GetLoad() const;
+
+	/**
+	 * @brief Restart the traffic statistics
+	 */
+	void ResetStatistics();
+
+	/**
+	 * @brief Get the simulated time in nanoseconds
+	 */
+	static uint64_t Now()
+	{
+		return _now;
+	}
+
+	/**
+	 * @brief Advance the simulated clock without sending frames
+	 *
+	 * @param time The idle time in nanoseconds
+	 */
+	static void Advance(uint64_t time)
+	{
+		_now += time;
+	}
+
+	/**
+	 * @brief Get the number of bits a frame occupies on the bus
+	 * @remark Counts the stuff bits of the actual identifier, payload and CRC, the acknowledge slot, end of frame and interframe space
+	 */
+	static uint32_t FrameBits(const CanBus::Frame& frame);
+
+	/**
+	 * @brief Get the arbitration value of a frame, the lowest value wins
+	 */
+	static uint32_t ArbitrationValue(const CanBus::Frame& frame);
+};
+
+} // namespace PSR
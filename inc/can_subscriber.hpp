@@ -0,0 +1,224 @@
+/**
+ * @file can_subscriber.hpp
+ * @author Purdue Solar Racing
+ * @brief Subscriptions on CanId fields with constant time software demultiplexing
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "can_frame_pool.hpp"
+#include "can_lib.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace PSR
+{
+
+/**
+ * @brief Dispatches frames that follow the CanId layout to handlers subscribed on its fields.
+ *
+ * All subscriptions share a single hardware filter derived from their fields. The type and message ID of a received frame are looked up
+ * in a perfect hash table built by Attach, so the cost of dispatching does not depend on the number of subscriptions.
+ *
+ * Handlers added with SubscribePooled receive the frame stored in CanFramePool instead. The frame is stored once, on the first pooled
+ * handler that accepts it, and every pooled handler gets the same handle, so consumers that keep the frame share it without copying.
+ */
+class CanSubscriber
+{
+  public:
+	/**
+	 * @brief Defines a handler that receives a frame stored in CanFramePool
+	 * @remark The handle is released after the last handler returns, copy it to keep the frame
+	 *
+	 * @param bus The bus the frame was received on
+	 * @param frame The handle to the stored frame
+	 */
+	using PooledCallback = std::function<void(CanBus*, const CanFramePool::Handle&)>;
+
+	/**
+	 * @brief Represents the set of CanId values a handler is subscribed to
+	 */
+	struct Subscription
+	{
+		uint8_t Type;         // Device type of the sender
+		uint8_t MessageFirst; // First message ID in the subscribed range
+		uint8_t MessageLast;  // Last message ID in the subscribed range (inclusive)
+		uint8_t Dst;          // Destination ID to accept
+		uint8_t Src;          // Source ID to accept
+		bool AnyDst;          // Whether every destination is accepted
+		bool Multicast;       // Whether CanId::MulticastDestination is accepted in addition to Dst
+		bool AnySrc;          // Whether every source is accepted
+
+		/**
+		 * @brief Subscribe to every message of a device type
+		 *
+		 * @param type The device type of the sender
+		 */
+		constexpr Subscription(uint8_t type) : Type(type), MessageFirst(0), MessageLast(0x3F), Dst(0), Src(0), AnyDst(true), Multicast(false), AnySrc(true) {}
+
+		/**
+		 * @brief Restrict the subscription to a single message ID
+		 */
+		constexpr Subscription Message(uint8_t message) const
+		{
+			return Messages(message, message);
+		}
+
+		/**
+		 * @brief Restrict the subscription to an inclusive range of message IDs
+		 */
+		constexpr Subscription Messages(uint8_t first, uint8_t last) const
+		{
+			Subscription sub = *this;
+			sub.MessageFirst = first;
+			sub.MessageLast  = last;
+			return sub;
+		}
+
+		/**
+		 * @brief Restrict the subscription to frames sent to a node
+		 *
+		 * @param dst The destination ID of the node
+		 * @param multicast Whether frames sent to CanId::MulticastDestination are also accepted
+		 */
+		constexpr Subscription Destination(uint8_t dst, bool multicast) const
+		{
+			Subscription sub = *this;
+			sub.Dst          = dst;
+			sub.AnyDst       = false;
+			sub.Multicast    = multicast;
+			return sub;
+		}
+
+		/**
+		 * @brief Restrict the subscription to frames sent by a node
+		 */
+		constexpr Subscription Source(uint8_t src) const
+		{
+			Subscription sub = *this;
+			sub.Src          = src;
+			sub.AnySrc       = false;
+			return sub;
+		}
+
+		/**
+		 * @brief Check whether the destination and source of an identifier are accepted
+		 */
+		constexpr bool Accepts(CanBus::CanId id) const
+		{
+			return (AnyDst || id.Dst == Dst || (Multicast && id.Dst == CanBus::CanId::MulticastDestination)) && (AnySrc || id.Src == Src);
+		}
+	};
+
+  private:
+	struct Entry
+	{
+		Subscription Sub;
+		CanBus::Callback Handler;
+		PooledCallback Pooled; // Set instead of Handler for handlers added with SubscribePooled
+
+		Entry(const Subscription& sub, CanBus::Callback handler) : Sub(sub), Handler(handler), Pooled() {}
+		Entry(const Subscription& sub, PooledCallback pooled) : Sub(sub), Handler(), Pooled(pooled) {}
+	};
+
+	struct Route
+	{
+		uint16_t Key;   // Type and message ID of the route
+		uint16_t Entry; // Index of the subscription that receives the route
+	};
+
+	struct Slot
+	{
+		uint16_t Key;   // Type and message ID stored in the slot, EMPTY_KEY when unused
+		uint16_t First; // Index of the first route of the key
+		uint16_t Count; // Number of routes of the key
+	};
+
+	static constexpr uint16_t EMPTY_KEY = 0xFFFF;
+
+	std::vector<Entry> _entries;              // The subscriptions in the order they were added
+	std::vector<Route> _routes;               // The routes of every key, grouped by key
+	std::vector<Slot> _table;                 // The perfect hash table
+	uint32_t _seed;                           // Multiplier of the hash function
+	uint32_t _shift;                          // Shift that reduces the product to a table index
+	bool _attached;                           // Whether the table has been built
+	mutable volatile uint32_t _poolExhausted; // Frames pooled handlers missed because CanFramePool was empty
+
+	static constexpr uint16_t MakeKey(uint32_t type, uint32_t message)
+	{
+		return (uint16_t)((type << 6) | message);
+	}
+
+	uint32_t Hash(uint32_t key) const
+	{
+		return (key * this->_seed) >> this->_shift;
+	}
+
+	bool BuildTable();
+	bool AddEntry(const Entry& entry);
+
+  public:
+	CanSubscriber() : _entries(), _routes(), _table(), _seed(0), _shift(32), _attached(false), _poolExhausted(0) {}
+
+	/**
+	 * @brief Add a handler for the frames that match a subscription
+	 * @remark Must be called before Attach
+	 *
+	 * @param subscription The CanId fields to match
+	 * @param handler The handler that receives matching frames
+	 * @return bool Whether the subscription was added
+	 */
+	bool Subscribe(const Subscription& subscription, CanBus::Callback handler);
+
+	/**
+	 * @brief Add a handler that receives matching frames through CanFramePool
+	 * @remark Must be called before Attach. Frames that arrive while the pool is exhausted are not passed to pooled handlers, they are
+	 * counted by GetPoolExhaustedCount.
+	 *
+	 * @param subscription The CanId fields to match
+	 * @param handler The handler that receives the handle to each matching frame
+	 * @return bool Whether the subscription was added
+	 */
+	bool SubscribePooled(const Subscription& subscription, PooledCallback handler);
+
+	/**
+	 * @brief Derive the hardware filter that accepts every subscription
+	 *
+	 * @return CanBus::Filter An extended ID/mask filter
+	 */
+	CanBus::Filter GetFilter() const;
+
+	/**
+	 * @brief Build the dispatch table and register the derived filter on a bus
+	 * @remark The subscriber must outlive the bus
+	 *
+	 * @param bus The bus to receive from
+	 * @param fifo The number of the FIFO buffer to receive from
+	 * @return bool Whether the subscriber was attached correctly
+	 */
+	bool Attach(CanBus& bus, uint32_t fifo);
+
+	/**
+	 * @brief Run the handlers subscribed to a frame
+	 *
+	 * @param bus The bus the frame was received on
+	 * @param frame The received frame
+	 */
+	void Dispatch(CanBus* bus, const CanBus::Frame& frame) const;
+
+	/**
+	 * @brief Get the number of frames pooled handlers missed because CanFramePool was exhausted
+	 */
+	uint32_t GetPoolExhaustedCount() const
+	{
+		return this->_poolExhausted;
+	}
+};
+
+} // namespace PSR
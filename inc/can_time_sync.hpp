@@ -0,0 +1,149 @@
+/**
+ * @file can_time_sync.hpp
+ * @author Purdue Solar Racing
+ * @brief Two step clock synchronization over CAN using frame timestamps
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include "can_ids.hpp"
+#include "can_lib.hpp"
+
+#include <cstdint>
+#include <functional>
+
+namespace PSR
+{
+
+/**
+ * @brief Keeps the frame timestamps of every node in the timebase of one master node.
+ *
+ * The master periodically sends a SYNC frame with TransmitTimestamped and then a FOLLOW_UP frame carrying the time SYNC was on the bus,
+ * like the two step sync of gPTP. Followers take the receive timestamp of SYNC, so the time both frames spend in queues and interrupts
+ * does not affect the result. The rate error of the follower clock is estimated from consecutive syncs and corrected between them.
+ *
+ * SYNC carries the sequence number in byte 0, FOLLOW_UP carries the same sequence number in byte 0 and the master timestamp in word 1.
+ * Both are extended frames sent to CanId::MulticastDestination with the GenericMessage TIME_SYNC and TIME_FOLLOW_UP message IDs.
+ */
+class CanTimeSync
+{
+  public:
+	/**
+	 * @brief Configures the protocol, the master and every follower must agree on the identifiers
+	 */
+	struct Config
+	{
+		uint8_t MasterSrc  = 0;                // Source ID of the master
+		uint8_t MasterType = CanType::GENERIC; // Device type the sync frames are sent as
+		uint32_t Period    = 100;              // Time between syncs sent by the master in milliseconds
+		uint32_t Timeout   = 350;              // Time without a sync after which a follower is no longer synchronized in milliseconds
+		uint32_t MaxDrift  = 500;              // Largest accepted rate error between clocks in parts per million, larger values restart the estimate
+		uint32_t Bitrate   = 0;                // Nominal bitrate, moves timestamps taken after the end of frame to the start of frame when not 0
+	};
+
+	/**
+	 * @brief A snapshot of the synchronization state, see GetStatus
+	 */
+	struct Status
+	{
+		bool Synchronized; // Whether a sync was received within the timeout, always true on the master
+		int32_t Offset;    // Master time minus local time at the last sync in microseconds
+		int32_t Drift;     // Estimated rate error of the master clock relative to the local clock in parts per billion
+		uint32_t Syncs;    // Syncs sent by the master or completed by the follower
+		uint32_t Restarts; // Times the drift estimate was discarded because it exceeded MaxDrift
+	};
+
+  private:
+	CanBus* _bus;
+	Config _config;
+	CanBus::Frame _syncFrame;     // SYNC frame sent by the master, also the identifier followers filter on
+	CanBus::Frame _followUpFrame; // FOLLOW_UP frame sent by the master
+	bool _master;                 // Whether this node sends the syncs
+	uint8_t _sequence;            // Sequence number of the last SYNC sent or received
+	uint32_t _lastSync;           // Tick of the last SYNC sent or FOLLOW_UP completed
+	volatile bool _syncValid;     // Master: the SYNC timestamp waits for FOLLOW_UP. Follower: the SYNC timestamp waits for its FOLLOW_UP
+	volatile uint32_t _syncTime;  // Timestamp of the last SYNC, in master time on the master and in local time on a follower
+	uint32_t _anchorShared;       // Master time of the last completed sync in microseconds
+	uint32_t _anchorLocal;        // Local time of the last completed sync in microseconds
+	int32_t _drift;               // Estimated rate error in parts per billion
+	bool _anchored;               // Whether a sync was completed since starting or restarting
+	bool _driftKnown;             // Whether the drift was measured since the last restart
+	bool _synchronized;           // Whether the last completed sync is within the timeout
+	uint32_t _syncs;
+	uint32_t _restarts;
+
+	std::function<void(const CanBus*, const CanBus::Frame&)> _chainedTxTimestamp; // TxTimestampEvent handler that was set before StartMaster
+
+	uint32_t StartOfFrame(const CanBus::Frame& frame) const;
+	void OnTxTimestamp(const CanBus::Frame& frame);
+	void OnFrame(const CanBus::Frame& frame);
+	void Anchor(uint32_t shared, uint32_t local);
+
+  public:
+	/**
+	 * @brief Create a node that is neither master nor follower until started
+	 *
+	 * @param bus The bus the sync frames are exchanged on
+	 * @param config The protocol configuration, shared by every node
+	 */
+	CanTimeSync(CanBus& bus, const Config& config);
+
+	/**
+	 * @brief Make this node the master, its frame timestamps become the shared timebase
+	 * @remark Takes over TxTimestampEvent of the bus, a handler set before is still called for other frames. The node must outlive the bus.
+	 *
+	 * @return bool Whether the bus supports timestamped transmission
+	 */
+	bool StartMaster();
+
+	/**
+	 * @brief Make this node a follower and register the filter that receives the sync frames
+	 * @remark Must be called before the bus is initialized. The node must outlive the bus.
+	 *
+	 * @param fifo The number of the FIFO buffer to receive from
+	 * @return bool Whether the filter was added correctly
+	 */
+	bool StartFollower(uint32_t fifo);
+
+	/**
+	 * @brief Send the due sync frames on the master and expire the synchronization on a follower, call from the main loop
+	 */
+	void Update();
+
+	/**
+	 * @brief Check whether shared times can be computed
+	 */
+	bool IsSynchronized() const
+	{
+		return this->_master || this->_synchronized;
+	}
+
+	/**
+	 * @brief Convert a frame timestamp or a time from CanBus::GetTimestamp to the shared timebase
+	 * @remark Only meaningful while synchronized, the result wraps like the timestamps
+	 *
+	 * @param local The local time in microseconds
+	 * @return uint32_t The master time in microseconds
+	 */
+	uint32_t ToShared(uint32_t local) const;
+
+	/**
+	 * @brief Get the current time in the shared timebase in microseconds
+	 */
+	uint32_t Now() const
+	{
+		return this->ToShared(this->_bus->GetTimestamp());
+	}
+
+	/**
+	 * @brief Get a snapshot of the synchronization state
+	 */
+	Status GetStatus() const;
+};
+
+} // namespace PSR
@@ -0,0 +1,254 @@
+/**
+ * @file can_rta.cpp
+ * @author Purdue Solar Racing
+ * @brief Worst-case response time analysis implementation file
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_rta.hpp"
+
+#if PSR_CAN_MODE == 4
+#include "can_sim.hpp"
+
+#include <deque>
+#include <memory>
+#include <random>
+#endif
+
+namespace PSR
+{
+
+namespace CanRta
+{
+
+static constexpr uint64_t SECOND = 1000000000; // Times are in nanoseconds
+
+uint32_t WorstCaseBits(uint32_t length, bool isExtended)
+{
+	// Bits exposed to stuffing from the start of frame to the CRC, one stuff bit can follow every four of them after the first
+	uint32_t exposed = (isExtended ? 54 : 34) + 8 * (length > 8 ? 8 : length);
+
+	// CRC delimiter, acknowledge slot and delimiter, end of frame and interframe space
+	return exposed + (exposed - 1) / 4 + 13;
+}
+
+uint32_t ArbitrationValue(const Message& message)
+{
+	// The base identifier is compared first, then a standard frame wins over an extended one
+	if (message.IsExtended)
+		return (((message.Id >> 18) & CanBus::STD_ID_MASK) << 19) | (1U << 18) | (message.Id & 0x3FFFF);
+
+	return (message.Id & CanBus::STD_ID_MASK) << 19;
+}
+
+/**
+ * @brief Get the time a number of bits take on the bus, rounded up
+ */
+static uint64_t BitsToTime(uint64_t bits, uint32_t bitrate)
+{
+	return (bits * SECOND + bitrate - 1) / bitrate;
+}
+
+/**
+ * @brief Divide and round up
+ */
+static uint64_t DivideUp(uint64_t value, uint64_t divisor)
+{
+	return (value + divisor - 1) / divisor;
+}
+
+double Utilization(const std::vector<Message>& messages, uint32_t bitrate)
+{
+	double utilization = 0;
+	for (const Message& message : messages)
+		utilization += (double)BitsToTime(WorstCaseBits(message.Length, message.IsExtended), bitrate) / (double)message.Period;
+
+	return utilization;
+}
+
+std::vector<Result> Analyze(const std::vector<Message>& messages, uint32_t bitrate)
+{
+	uint64_t bitTime = BitsToTime(1, bitrate);
+
+	std::vector<uint64_t> transmission(messages.size());
+	std::vector<uint32_t> priority(messages.size());
+	for (size_t i = 0; i < messages.size(); i++)
+	{
+		transmission[i] = BitsToTime(WorstCaseBits(messages[i].Length, messages[i].IsExtended), bitrate);
+		priority[i]     = ArbitrationValue(messages[i]);
+	}
+
+	std::vector<Result> results(messages.size());
+	for (size_t m = 0; m < messages.size(); m++)
+	{
+		const Message& message = messages[m];
+		Result& result         = results[m];
+
+		result.Transmission = transmission[m];
+		result.Blocking     = 0;
+		result.Response     = 0;
+		result.Instances    = 0;
+		result.Bounded      = false;
+		result.Schedulable  = false;
+
+		// A frame of lower priority that started just before the release cannot be preempted
+		double utilization = 0;
+		for (size_t k = 0; k < messages.size(); k++)
+		{
+			if (priority[k] > priority[m] && transmission[k] > result.Blocking)
+				result.Blocking = transmission[k];
+			if (priority[k] <= priority[m])
+				utilization += (double)transmission[k] / (double)messages[k].Period;
+		}
+
+		// Messages of this and higher priority never leave the bus idle, the busy period does not end
+		if (utilization >= 1)
+			continue;
+
+		// Length of the level-m busy period, every instance released in it may have the longest response time
+		uint64_t busy = transmission[m];
+		while (true)
+		{
+			uint64_t next = result.Blocking;
+			for (size_t k = 0; k < messages.size(); k++)
+			{
+				if (priority[k] <= priority[m])
+					next += DivideUp(busy + messages[k].Jitter, messages[k].Period) * transmission[k];
+			}
+
+			if (next == busy)
+				break;
+			busy = next;
+		}
+
+		result.Instances = (uint32_t)DivideUp(busy + message.Jitter, message.Period);
+		result.Bounded   = true;
+		for (uint32_t q = 0; q < result.Instances && result.Bounded; q++)
+		{
+			// Queueing delay of instance q, higher priority frames released up to one bit time after it starts still win arbitration
+			uint64_t wait = result.Blocking + q * transmission[m];
+			while (true)
+			{
+				uint64_t next = result.Blocking + q * transmission[m];
+				for (size_t k = 0; k < messages.size(); k++)
+				{
+					if (priority[k] < priority[m])
+						next += DivideUp(wait + messages[k].Jitter + bitTime, messages[k].Period) * transmission[k];
+				}
+
+				int64_t response = (int64_t)(message.Jitter + next + transmission[m]) - (int64_t)(q * message.Period);
+				if (response > (int64_t)result.Response)
+					result.Response = (uint64_t)response;
+
+				// The iteration only grows, so it can stop once the deadline is missed
+				if (response > (int64_t)message.Deadline)
+				{
+					result.Bounded = false;
+					break;
+				}
+
+				if (next == wait)
+					break;
+				wait = next;
+			}
+		}
+
+		result.Schedulable = result.Bounded && result.Response <= message.Deadline;
+	}
+
+	return results;
+}
+
+#if PSR_CAN_MODE == 4
+std::vector<uint64_t> Simulate(const std::vector<Message>& messages, uint32_t bitrate, uint64_t duration, uint32_t seed)
+{
+	/**
+	 * @brief The controller and the released instances of one message
+	 */
+	struct Source
+	{
+		std::unique_ptr<CanSimController> Controller;
+		CanBus::Frame Frame;
+		std::deque<uint64_t> Released; // Periodic release times of the instances waiting to be sent, oldest first
+		uint64_t Instance;             // Index of the next instance
+		uint64_t Arrival;              // Time the next instance is queued, after its jitter
+	};
+
+	std::mt19937 random(seed);
+	CanSimBus bus(bitrate);
+	uint64_t begin = CanSimBus::Now();
+	uint64_t end   = begin + duration;
+
+	std::vector<Source> sources(messages.size());
+	std::vector<uint64_t> worst(messages.size(), 0);
+	for (size_t i = 0; i < messages.size(); i++)
+	{
+		Source& source    = sources[i];
+		source.Controller = std::unique_ptr<CanSimController>(new CanSimController(messages[i].Name.c_str()));
+		source.Instance   = 0;
+		source.Arrival    = begin + (messages[i].Jitter == 0 ? 0 : random() % (messages[i].Jitter + 1));
+		bus.Attach(*source.Controller);
+
+		source.Frame            = CanBus::Frame();
+		source.Frame.Id         = messages[i].Id;
+		source.Frame.IsExtended = messages[i].IsExtended;
+		source.Frame.Length     = messages[i].Length > 8 ? 8 : messages[i].Length;
+		source.Frame.Data.Value = 0; // Runs of zeros are stuffed most often
+	}
+
+	bus.Sent = [&](const CanSimController& sender, const CanBus::Frame&, uint64_t, uint64_t, uint64_t finished) {
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			if (sources[i].Controller.get() != &sender)
+				continue;
+
+			uint64_t response = finished - sources[i].Released.front();
+			if (response > worst[i])
+				worst[i] = response;
+
+			sources[i].Released.pop_front();
+			break;
+		}
+	};
+
+	while (CanSimBus::Now() < end)
+	{
+		uint64_t now  = CanSimBus::Now();
+		uint64_t next = end;
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			Source& source = sources[i];
+			while (source.Arrival <= now)
+			{
+				source.Released.push_back(begin + source.Instance * messages[i].Period);
+				source.Instance++;
+
+				// Arrivals stay in order even when the jitter is longer than the period
+				uint64_t release = begin + source.Instance * messages[i].Period;
+				uint64_t arrival = release + (messages[i].Jitter == 0 ? 0 : random() % (messages[i].Jitter + 1));
+				source.Arrival   = arrival > source.Arrival ? arrival : source.Arrival + 1;
+			}
+
+			// One mailbox at a time keeps the instances of a message in order
+			if (!source.Released.empty() && source.Controller->FreeMailboxes() == CanSimController::TX_MAILBOXES)
+				source.Controller->Queue(source.Frame);
+
+			if (source.Arrival < next)
+				next = source.Arrival;
+		}
+
+		if (!bus.Step())
+			CanSimBus::Advance(next - now);
+	}
+
+	return worst;
+}
+#endif
+
+} // namespace CanRta
+
+} // namespace PSR
@@ -0,0 +1,100 @@
+/**
+ * @file can_rta.hpp
+ * @author Purdue Solar Racing
+ * @brief Worst-case response time analysis of a periodic CAN message set
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Implements the schedulability test for controller area network of Davis, Burns, Bril and Lukkien (Real-Time Systems 35, 2007), which
+ * checks every instance of a message in the level-m busy period. Each node is assumed to queue frames by priority without inversion.
+ */
+
+#pragma once
+
+#include "can_lib.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace PSR
+{
+
+namespace CanRta
+{
+
+/**
+ * @brief A periodic or sporadic message, times are in nanoseconds
+ */
+struct Message
+{
+	std::string Name;  // Name shown in the results
+	uint32_t Id;       // Identifier, a lower value has a higher priority
+	bool IsExtended;   // Whether the identifier is an extended identifier
+	uint32_t Length;   // Payload length in bytes
+	uint64_t Period;   // Minimum time between releases
+	uint64_t Deadline; // Longest allowed time from release to the end of transmission
+	uint64_t Jitter;   // Largest delay from the periodic release to queueing the frame
+};
+
+/**
+ * @brief The analysis of one message, times are in nanoseconds
+ */
+struct Result
+{
+	uint64_t Transmission; // Longest transmission time with worst-case stuffing, including the interframe space
+	uint64_t Blocking;     // Longest transmission of a lower priority frame that already started
+	uint64_t Response;     // Worst-case response time, only valid when Bounded
+	uint32_t Instances;    // Instances checked in the busy period
+	bool Bounded;          // Whether the response time converged before exceeding the deadline
+	bool Schedulable;      // Whether the response time is at most the deadline
+};
+
+/**
+ * @brief Get the number of bits of a frame with the most stuff bits its length allows, including the interframe space
+ */
+uint32_t WorstCaseBits(uint32_t length, bool isExtended);
+
+/**
+ * @brief Get the arbitration value of a message, the lowest value wins
+ */
+uint32_t ArbitrationValue(const Message& message);
+
+/**
+ * @brief Get the fraction of the bus time the message set uses at its worst-case transmission times
+ *
+ * @param messages The message set
+ * @param bitrate The nominal bitrate in bits per second
+ */
+double Utilization(const std::vector<Message>& messages, uint32_t bitrate);
+
+/**
+ * @brief Compute the worst-case response time of every message
+ *
+ * @param messages The message set, identifiers must be unique
+ * @param bitrate The nominal bitrate in bits per second
+ * @return std::vector<Result> The results in the order of the message set
+ */
+std::vector<Result> Analyze(const std::vector<Message>& messages, uint32_t bitrate);
+
+#if PSR_CAN_MODE == 4
+/**
+ * @brief Send the message set on the simulated bus and measure the longest response time of every message
+ * @remark Every message is sent by its own controller with an all zero payload, which is close to the worst case for stuffing. All
+ * messages are released together at the start and then periodically, the release of each instance is delayed by a random part of its
+ * jitter.
+ *
+ * @param messages The message set
+ * @param bitrate The nominal bitrate in bits per second
+ * @param duration The simulated time in nanoseconds
+ * @param seed Seed of the release jitter
+ * @return std::vector<uint64_t> The longest measured response time of every message in nanoseconds, 0 when it was never sent
+ */
+std::vector<uint64_t> Simulate(const std::vector<Message>& messages, uint32_t bitrate, uint64_t duration, uint32_t seed);
+#endif
+
+} // namespace CanRta
+
+} // namespace PSR
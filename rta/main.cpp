@@ -0,0 +1,253 @@
+/**
+ * @file main.cpp
+ * @author Purdue Solar Racing
+ * @brief Response time analysis of a message set read from a CSV file
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Usage: can_rta [--bitrate <bits/s>] [--format text|csv] [--simulate <seconds>] [--seed <n>] <messages.csv>
+ *
+ * The first row of the file names the columns, in any order:
+ *   name                          Name shown in the results
+ *   priority,type,message,src,dst CanId fields of an extended identifier, fields that are left out are 0
+ *   id,ext                        A raw identifier instead of the CanId fields, ext is 1 for an extended identifier (default 1)
+ *   dlc                           Payload length in bytes
+ *   period_ms                     Minimum time between releases
+ *   deadline_ms                   Longest allowed response time (default period_ms)
+ *   jitter_ms                     Largest delay from the periodic release to queueing the frame (default 0)
+ * Empty lines and lines starting with `#` are ignored. Exits with 2 when a message can miss its deadline.
+ */
+
+#include "can_rta.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+using namespace PSR;
+
+static constexpr double MILLISECOND = 1000000; // Nanoseconds per millisecond
+static constexpr double MICROSECOND = 1000;    // Nanoseconds per microsecond
+
+/**
+ * @brief Split a CSV line into trimmed fields
+ */
+static std::vector<std::string> SplitLine(const std::string& line)
+{
+	std::vector<std::string> fields;
+	std::stringstream stream(line);
+	std::string field;
+	while (std::getline(stream, field, ','))
+	{
+		size_t first = field.find_first_not_of(" \t\r");
+		size_t last  = field.find_last_not_of(" \t\r");
+		fields.push_back(first == std::string::npos ? "" : field.substr(first, last - first + 1));
+	}
+
+	return fields;
+}
+
+/**
+ * @brief Read the message set, reporting the first malformed line on stderr
+ */
+static bool ReadMessages(const char* path, std::vector<CanRta::Message>& messages)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		fprintf(stderr, "Cannot open %s\n", path);
+		return false;
+	}
+
+	std::map<std::string, size_t> columns;
+	std::string line;
+	for (uint32_t row = 1; std::getline(file, line); row++)
+	{
+		std::vector<std::string> fields = SplitLine(line);
+		if (fields.empty() || fields[0].empty() || fields[0][0] == '#')
+			continue;
+
+		if (columns.empty())
+		{
+			for (size_t i = 0; i < fields.size(); i++)
+				columns[fields[i]] = i;
+
+			if (columns.count("dlc") == 0 || columns.count("period_ms") == 0)
+			{
+				fprintf(stderr, "%s: the header must name the dlc and period_ms columns\n", path);
+				return false;
+			}
+			continue;
+		}
+
+		auto text = [&](const char* column) -> std::string {
+			auto it = columns.find(column);
+			return it == columns.end() || it->second >= fields.size() ? "" : fields[it->second];
+		};
+		auto number = [&](const char* column, double value) -> double {
+			std::string field = text(column);
+			return field.empty() ? value : strtod(field.c_str(), nullptr);
+		};
+		auto integer = [&](const char* column, uint32_t value) -> uint32_t {
+			std::string field = text(column);
+			return field.empty() ? value : (uint32_t)strtoul(field.c_str(), nullptr, 0);
+		};
+
+		CanRta::Message message;
+		message.Name       = text("name");
+		message.IsExtended = integer("ext", 1) != 0;
+		message.Length     = integer("dlc", 0);
+		message.Period     = (uint64_t)(number("period_ms", 0) * MILLISECOND);
+		message.Deadline   = (uint64_t)(number("deadline_ms", number("period_ms", 0)) * MILLISECOND);
+		message.Jitter     = (uint64_t)(number("jitter_ms", 0) * MILLISECOND);
+
+		if (!text("id").empty())
+			message.Id = integer("id", 0);
+		else
+			message.Id = CanBus::CanId::FromParts(integer("dst", 0), integer("src", 0), integer("message", 0), integer("type", 0), integer("priority", 0));
+
+		if (message.Name.empty())
+			message.Name = "line " + std::to_string(row);
+
+		if (message.Period == 0 || message.Length > 8)
+		{
+			fprintf(stderr, "%s:%u: the period must be positive and dlc at most 8\n", path, row);
+			return false;
+		}
+
+		for (const CanRta::Message& other : messages)
+		{
+			if (CanRta::ArbitrationValue(other) == CanRta::ArbitrationValue(message))
+			{
+				fprintf(stderr, "%s:%u: %s has the same identifier as %s\n", path, row, message.Name.c_str(), other.Name.c_str());
+				return false;
+			}
+		}
+
+		messages.push_back(message);
+	}
+
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	uint32_t bitrate = 500000;
+	bool csv         = false;
+	double simulate  = 0;
+	uint32_t seed    = 1;
+	const char* path = nullptr;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--bitrate") == 0 && i + 1 < argc)
+		{
+			bitrate = (uint32_t)strtoul(argv[++i], nullptr, 0);
+		}
+		else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+		{
+			i++;
+			if (strcmp(argv[i], "csv") == 0)
+				csv = true;
+			else if (strcmp(argv[i], "text") == 0)
+				csv = false;
+			else
+			{
+				fprintf(stderr, "Unknown format %s\n", argv[i]);
+				return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--simulate") == 0 && i + 1 < argc)
+		{
+			simulate = strtod(argv[++i], nullptr);
+		}
+		else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+		{
+			seed = (uint32_t)strtoul(argv[++i], nullptr, 0);
+		}
+		else if (argv[i][0] != '-' && path == nullptr)
+		{
+			path = argv[i];
+		}
+		else
+		{
+			path = nullptr;
+			break;
+		}
+	}
+
+	if (path == nullptr || bitrate == 0)
+	{
+		fprintf(stderr, "Usage: %s [--bitrate <bits/s>] [--format text|csv] [--simulate <seconds>] [--seed <n>] <messages.csv>\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<CanRta::Message> messages;
+	if (!ReadMessages(path, messages))
+		return 1;
+
+	// Results are listed from the highest priority down
+	std::sort(messages.begin(), messages.end(),
+	          [](const CanRta::Message& a, const CanRta::Message& b) { return CanRta::ArbitrationValue(a) < CanRta::ArbitrationValue(b); });
+
+	std::vector<CanRta::Result> results = CanRta::Analyze(messages, bitrate);
+	std::vector<uint64_t> measured;
+	if (simulate > 0)
+		measured = CanRta::Simulate(messages, bitrate, (uint64_t)(simulate * 1000 * MILLISECOND), seed);
+
+	if (csv)
+		printf("name,id,extended,transmission_us,blocking_us,response_us,deadline_us,instances,schedulable%s\n", simulate > 0 ? ",measured_us" : "");
+	else
+		printf("Bitrate %u bit/s, utilization %.1f %%\n\n%-24s %-10s %8s %8s %10s %10s %6s%s\n", bitrate, CanRta::Utilization(messages, bitrate) * 100, "Name", "Id", "C(us)",
+		       "B(us)", "R(us)", "D(us)", "Status", simulate > 0 ? "   Sim(us)" : "");
+
+	uint32_t misses   = 0;
+	uint32_t exceeded = 0;
+	for (size_t i = 0; i < messages.size(); i++)
+	{
+		const CanRta::Message& message = messages[i];
+		const CanRta::Result& result   = results[i];
+
+		// An unbounded response is only known to exceed the deadline
+		char response[32];
+		if (result.Bounded)
+			snprintf(response, sizeof(response), "%.1f", result.Response / MICROSECOND);
+		else
+			snprintf(response, sizeof(response), ">%.1f", message.Deadline / MICROSECOND);
+		misses += result.Schedulable ? 0 : 1;
+
+		if (csv)
+			printf("%s,0x%08X,%d,%.1f,%.1f,%s,%.1f,%u,%d", message.Name.c_str(), message.Id, message.IsExtended ? 1 : 0, result.Transmission / MICROSECOND,
+			       result.Blocking / MICROSECOND, response, message.Deadline / MICROSECOND, result.Instances, result.Schedulable ? 1 : 0);
+		else
+			printf("%-24s 0x%08X %8.1f %8.1f %10s %10.1f %6s", message.Name.c_str(), message.Id, result.Transmission / MICROSECOND, result.Blocking / MICROSECOND,
+			       response, message.Deadline / MICROSECOND, result.Schedulable ? "OK" : "MISS");
+
+		if (simulate > 0)
+		{
+			// The analysis is an upper bound, a longer measured response means the model does not match the bus
+			bool over = result.Bounded && measured[i] > result.Response;
+			exceeded += over ? 1 : 0;
+			if (measured[i] == 0)
+				printf(csv ? "," : " %9s", "never");
+			else
+				printf(csv ? ",%.1f" : " %9.1f%s", measured[i] / MICROSECOND, over ? " EXCEEDS BOUND" : "");
+		}
+		printf("\n");
+	}
+
+	if (!csv)
+	{
+		printf("\n%u of %zu messages can miss their deadline\n", misses, messages.size());
+		if (exceeded != 0)
+			printf("%u measured response times exceed the analysis\n", exceeded);
+	}
+
+	return misses == 0 ? 0 : 2;
+}
@@ -0,0 +1,359 @@
+/**
+ * @file can_coro.cpp
+ * @author Purdue Solar Racing
+ * @brief C++20 coroutine executor implementation file
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+// Projects built without C++20 still compile every source file, so this file is empty for them
+#if defined(__cpp_impl_coroutine)
+
+#include "can_coro.hpp"
+
+namespace PSR
+{
+
+CanCoroutinePool::Block CanCoroutinePool::_blocks[CanCoroutinePool::BLOCKS];
+CanCoroutinePool::Block* CanCoroutinePool::_free = nullptr;
+size_t CanCoroutinePool::_available              = 0;
+bool CanCoroutinePool::_initialized              = false;
+
+void* CanCoroutinePool::Allocate(size_t size) noexcept
+{
+	if (size > BLOCK_SIZE)
+		return nullptr;
+
+	CanOs::CriticalSection section;
+
+	if (!_initialized)
+	{
+		for (size_t i = 0; i < BLOCKS; i++)
+			_blocks[i].Next = (i + 1 < BLOCKS) ? &_blocks[i + 1] : nullptr;
+
+		_free        = &_blocks[0];
+		_available   = BLOCKS;
+		_initialized = true;
+	}
+
+	Block* block = _free;
+	if (block == nullptr)
+		return nullptr;
+
+	_free = block->Next;
+	_available--;
+	return block->Storage;
+}
+
+void CanCoroutinePool::Free(void* block) noexcept
+{
+	if (block == nullptr)
+		return;
+
+	CanOs::CriticalSection section;
+
+	Block* freed = static_cast<Block*>(block);
+	freed->Next  = _free;
+	_free        = freed;
+	_available++;
+}
+
+size_t CanCoroutinePool::Available() noexcept
+{
+	return _initialized ? _available : BLOCKS;
+}
+
+CanExecutor::CanExecutor()
+	: _buses(), _busCount(0), _rxQueue(), _rxHead(0), _rxTail(0), _rxDropped(0), _ready(), _readyHead(0), _readyCount(0),
+	  _frameWaiters(nullptr), _sendWaiters(nullptr), _blockedSends(nullptr), _timers(nullptr)
+{
+}
+
+CanExecutor::BusState* CanExecutor::FindBus(const CanBus* bus)
+{
+	for (uint32_t i = 0; i < this->_busCount; i++)
+	{
+		if (this->_buses[i].Bus == bus)
+			return &this->_buses[i];
+	}
+
+	return nullptr;
+}
+
+bool CanExecutor::Attach(CanBus& bus, const CanBus::Filter& filter, uint32_t fifo)
+{
+	BusState* state = this->FindBus(&bus);
+	if (state == nullptr)
+	{
+		if (this->_busCount >= MAX_BUSES)
+			return false;
+
+		state            = &this->_buses[this->_busCount++];
+		state->Bus       = &bus;
+		state->Completed = 0;
+		state->Submitted = 0;
+		state->Blocked   = 0;
+
+		std::function<void(const CanBus*)> previous = bus.TxCompleteEvent;
+		bus.TxCompleteEvent                         = [state, previous](const CanBus* canbus)
+		{
+			state->Completed = state->Completed + 1;
+			if (previous)
+				previous(canbus);
+		};
+	}
+
+	return bus.AddRxCallback([this](CanBus* canbus, const CanBus::Frame& frame) { this->Feed(canbus, frame); }, filter, fifo);
+}
+
+void CanExecutor::Feed(CanBus* bus, const CanBus::Frame& frame)
+{
+	CanOs::CriticalSection section;
+
+	uint32_t next = (this->_rxHead + 1) % RX_QUEUE_SIZE;
+	if (next == this->_rxTail)
+	{
+		this->_rxDropped = this->_rxDropped + 1;
+		return;
+	}
+
+	this->_rxQueue[this->_rxHead].Bus   = bus;
+	this->_rxQueue[this->_rxHead].Frame = frame;
+	this->_rxHead                       = next;
+}
+
+void CanExecutor::Schedule(std::coroutine_handle<> handle)
+{
+	// Every live coroutine owns a pool block and waits in at most one place, so the queue cannot overflow
+	if (this->_readyCount >= READY_SIZE)
+		return;
+
+	this->_ready[(this->_readyHead + this->_readyCount) % READY_SIZE] = handle;
+	this->_readyCount++;
+}
+
+void CanExecutor::Push(Waiter*& list, Waiter* waiter)
+{
+	waiter->Next = list;
+	list         = waiter;
+}
+
+void CanExecutor::Expire(Waiter*& list, uint32_t now)
+{
+	Waiter** link = &list;
+	while (*link != nullptr)
+	{
+		Waiter* waiter = *link;
+		if (waiter->HasDeadline && (int32_t)(now - waiter->Deadline) >= 0)
+		{
+			*link = waiter->Next;
+			this->Schedule(waiter->Handle);
+		}
+		else
+		{
+			link = &waiter->Next;
+		}
+	}
+}
+
+void CanExecutor::RetryBlockedSends(uint32_t now)
+{
+	// A bus whose controller is still full keeps its later sends waiting too, so frames are queued in the order Send was called
+	uint32_t full = 0;
+
+	Waiter** link = &this->_blockedSends;
+	while (*link != nullptr)
+	{
+		Waiter* waiter       = *link;
+		SendAwaiter* awaiter = static_cast<SendAwaiter*>(waiter->Owner);
+		BusState* state      = awaiter->_state;
+		uint32_t bus         = 1U << (state - this->_buses);
+
+		bool expired = (int32_t)(now - waiter->Deadline) >= 0;
+		if (!expired && ((full & bus) != 0 || !state->Bus->TryTransmit(awaiter->_frame)))
+		{
+			full |= bus;
+			link = &waiter->Next;
+			continue;
+		}
+
+		*link             = waiter->Next;
+		awaiter->_blocked = false;
+		state->Blocked--;
+
+		// A send that timed out before it was queued resumes with false, a queued one waits for its completion
+		if (expired)
+		{
+			this->Schedule(waiter->Handle);
+		}
+		else
+		{
+			awaiter->TakeTicket();
+			Push(this->_sendWaiters, waiter);
+		}
+	}
+}
+
+bool CanExecutor::Spawn(CanTask&& task)
+{
+	if (!task.IsValid())
+		return false;
+
+	this->Schedule(task._handle);
+	task._handle = nullptr;
+	return true;
+}
+
+void CanExecutor::Poll()
+{
+	// Hand each received frame to every coroutine waiting for it
+	while (true)
+	{
+		Received received;
+		{
+			CanOs::CriticalSection section;
+
+			if (this->_rxTail == this->_rxHead)
+				break;
+
+			received      = this->_rxQueue[this->_rxTail];
+			this->_rxTail = (this->_rxTail + 1) % RX_QUEUE_SIZE;
+		}
+
+		Waiter** link = &this->_frameWaiters;
+		while (*link != nullptr)
+		{
+			Waiter* waiter        = *link;
+			FrameAwaiter* awaiter = static_cast<FrameAwaiter*>(waiter->Owner);
+			if (awaiter->_bus == received.Bus && awaiter->_filter.Matches(received.Frame.Id, received.Frame.IsExtended))
+			{
+				awaiter->_frame    = received.Frame;
+				awaiter->_received = true;
+
+				*link = waiter->Next;
+				this->Schedule(waiter->Handle);
+			}
+			else
+			{
+				link = &waiter->Next;
+			}
+		}
+	}
+
+	uint32_t now = CanBus::GetTick();
+	this->RetryBlockedSends(now);
+
+	// Transmissions complete when the bus has sent as many frames as were queued before and including this one
+	Waiter** link = &this->_sendWaiters;
+	while (*link != nullptr)
+	{
+		Waiter* waiter       = *link;
+		SendAwaiter* awaiter = static_cast<SendAwaiter*>(waiter->Owner);
+		if ((int32_t)(awaiter->_state->Completed - awaiter->_ticket) >= 0 || (int32_t)(now - waiter->Deadline) >= 0)
+		{
+			*link = waiter->Next;
+			this->Schedule(waiter->Handle);
+		}
+		else
+		{
+			link = &waiter->Next;
+		}
+	}
+
+	this->Expire(this->_frameWaiters, now);
+	this->Expire(this->_timers, now);
+
+	// Coroutines resumed here may spawn or wake others, which also run before returning
+	while (this->_readyCount > 0)
+	{
+		std::coroutine_handle<> handle = this->_ready[this->_readyHead];
+		this->_readyHead               = (this->_readyHead + 1) % READY_SIZE;
+		this->_readyCount--;
+
+		handle.resume();
+	}
+}
+
+CanExecutor::FrameAwaiter::FrameAwaiter(CanExecutor* executor, const CanBus* bus, const CanBus::Filter& filter, uint32_t timeout)
+	: _waiter(), _executor(executor), _bus(bus), _filter(filter), _frame(), _received(false)
+{
+	this->_waiter.Deadline    = CanBus::GetTick() + timeout;
+	this->_waiter.HasDeadline = timeout != NO_TIMEOUT;
+}
+
+void CanExecutor::FrameAwaiter::await_suspend(std::coroutine_handle<> handle) noexcept
+{
+	this->_waiter.Owner  = this;
+	this->_waiter.Handle = handle;
+	Push(this->_executor->_frameWaiters, &this->_waiter);
+}
+
+CanExecutor::SendAwaiter::SendAwaiter(CanExecutor* executor, CanBus& bus, const CanBus::Frame& frame, uint32_t timeout)
+	: _waiter(), _executor(executor), _state(executor->FindBus(&bus)), _frame(frame), _ticket(0), _queued(false), _blocked(false)
+{
+	this->_waiter.Deadline    = CanBus::GetTick() + timeout;
+	this->_waiter.HasDeadline = true;
+
+	if (this->_state == nullptr)
+		return;
+
+	// Frames of earlier sends that are still waiting for a buffer go first
+	if (this->_state->Blocked != 0 || !bus.TryTransmit(frame))
+	{
+		this->_blocked = true;
+		return;
+	}
+
+	this->TakeTicket();
+}
+
+void CanExecutor::SendAwaiter::TakeTicket()
+{
+	// Frames sent outside the executor advance the completion count, the ticket is never allowed to fall behind it
+	uint32_t completed = this->_state->Completed;
+	if ((int32_t)(completed - this->_state->Submitted) > 0)
+		this->_state->Submitted = completed;
+
+	this->_ticket = ++this->_state->Submitted;
+	this->_queued = true;
+}
+
+void CanExecutor::SendAwaiter::await_suspend(std::coroutine_handle<> handle) noexcept
+{
+	this->_waiter.Owner  = this;
+	this->_waiter.Handle = handle;
+	if (!this->_blocked)
+	{
+		Push(this->_executor->_sendWaiters, &this->_waiter);
+		return;
+	}
+
+	// Blocked sends are appended so Poll retries them oldest first
+	Waiter** link = &this->_executor->_blockedSends;
+	while (*link != nullptr)
+		link = &(*link)->Next;
+
+	this->_waiter.Next = nullptr;
+	*link              = &this->_waiter;
+	this->_state->Blocked++;
+}
+
+CanExecutor::TimeoutAwaiter::TimeoutAwaiter(CanExecutor* executor, uint32_t timeout) : _waiter(), _executor(executor)
+{
+	this->_waiter.Deadline    = CanBus::GetTick() + timeout;
+	this->_waiter.HasDeadline = true;
+}
+
+void CanExecutor::TimeoutAwaiter::await_suspend(std::coroutine_handle<> handle) noexcept
+{
+	this->_waiter.Owner  = this;
+	this->_waiter.Handle = handle;
+	Push(this->_executor->_timers, &this->_waiter);
+}
+
+} // namespace PSR
+
+#endif // defined(__cpp_impl_coroutine)
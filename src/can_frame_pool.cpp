@@ -0,0 +1,86 @@
+/**
+ * @file can_frame_pool.cpp
+ * @author Purdue Solar Racing
+ * @brief Packed frame pool implementation file
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_frame_pool.hpp"
+
+namespace PSR
+{
+
+CanBus::PackedFrame CanFramePool::_frames[CanFramePool::BLOCKS];
+uint16_t CanFramePool::_references[CanFramePool::BLOCKS];
+uint16_t CanFramePool::_next[CanFramePool::BLOCKS];
+uint16_t CanFramePool::_free    = CanFramePool::NONE;
+size_t CanFramePool::_available = 0;
+bool CanFramePool::_initialized = false;
+
+CanFramePool::Handle CanFramePool::Allocate(const CanBus::PackedFrame& frame)
+{
+	uint16_t index;
+	{
+		CanOs::CriticalSection section;
+
+		if (!_initialized)
+		{
+			for (size_t i = 0; i < BLOCKS; i++)
+				_next[i] = (i + 1 < BLOCKS) ? (uint16_t)(i + 1) : NONE;
+
+			_free        = 0;
+			_available   = BLOCKS;
+			_initialized = true;
+		}
+
+		index = _free;
+		if (index == NONE)
+			return Handle();
+
+		_free              = _next[index];
+		_references[index] = 1;
+		_available--;
+	}
+
+	// No other handle refers to the block yet, so it is filled outside the critical section
+	_frames[index] = frame;
+	return Handle(index);
+}
+
+void CanFramePool::Retain(uint16_t index)
+{
+	CanOs::CriticalSection section;
+	_references[index]++;
+}
+
+void CanFramePool::Release(uint16_t index)
+{
+	CanOs::CriticalSection section;
+
+	if (--_references[index] != 0)
+		return;
+
+	_next[index] = _free;
+	_free        = index;
+	_available++;
+}
+
+uint32_t CanFramePool::Handle::References() const
+{
+	if (this->_index == NONE)
+		return 0;
+
+	CanOs::CriticalSection section;
+	return _references[this->_index];
+}
+
+size_t CanFramePool::Available()
+{
+	return _initialized ? _available : BLOCKS;
+}
+
+} // namespace PSR
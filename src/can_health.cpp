@@ -0,0 +1,174 @@
+/**
+ * @file can_health.cpp
+ * @author Purdue Solar Racing
+ * @brief Bus load estimation, error state tracking and bus-off recovery shared by every backend
+ * @version 2.1
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_lib.hpp"
+
+namespace PSR
+{
+
+/**
+ * @brief Count the stuff bits of a field and carry the run of equal bits into the next field
+ *
+ * @param bits The field, sent most significant bit first
+ * @param width The number of bits in the field
+ * @param previous The value of the last bit sent
+ * @param run The number of equal bits ending with the last bit sent
+ * @return uint32_t The number of stuff bits inserted into the field
+ */
+static uint32_t CountStuffBits(uint64_t bits, uint32_t width, uint32_t& previous, uint32_t& run)
+{
+	uint32_t stuffed = 0;
+	for (uint32_t i = width; i > 0; i--)
+	{
+		uint32_t bit = (uint32_t)(bits >> (i - 1)) & 1;
+		if (bit == previous)
+		{
+			run++;
+		}
+		else
+		{
+			previous = bit;
+			run      = 1;
+		}
+
+		// The complement is inserted after five equal bits and starts the next run
+		if (run == 5)
+		{
+			stuffed++;
+			previous ^= 1;
+			run = 1;
+		}
+	}
+
+	return stuffed;
+}
+
+uint32_t CanBus::EstimateFrameBits(const Frame& frame)
+{
+	uint32_t dlc    = frame.Length & 0xF;
+	uint32_t length = dlc > 8 ? 8 : dlc;
+	uint32_t rtr    = frame.IsRTR ? 1 : 0;
+
+	// Start of frame, arbitration and control fields
+	uint64_t header;
+	uint32_t headerBits;
+	if (frame.IsExtended)
+	{
+		uint32_t id = frame.Id & CanBus::EXT_ID_MASK;
+		header      = (uint64_t)(id >> 18) << 27 | 1ULL << 26 | 1ULL << 25 | (uint64_t)(id & 0x3FFFF) << 7 | rtr << 6 | dlc;
+		headerBits  = 39;
+	}
+	else
+	{
+		header     = (frame.Id & CanBus::STD_ID_MASK) << 7 | rtr << 6 | dlc;
+		headerBits = 19;
+	}
+
+	uint32_t previous = 0;
+	uint32_t run      = 0;
+	uint32_t stuffed  = CountStuffBits(header, headerBits, previous, run);
+
+	uint32_t dataBits = frame.IsRTR ? 0 : length * 8;
+	for (uint32_t i = 0; i < dataBits / 8; i++)
+		stuffed += CountStuffBits(frame.Data.Bytes[i], 8, previous, run);
+
+	// CRC with an estimated stuff bit, CRC delimiter, acknowledge slot and delimiter, end of frame and interframe space
+	return headerBits + dataBits + stuffed + 15 + 1 + 1 + 2 + 7 + 3;
+}
+
+void CanBus::SetHealthConfig(const HealthConfig& config)
+{
+	CanOs::CriticalSection section;
+
+	this->_health.Config        = config;
+	this->_health.RecoveryDelay = config.RecoveryDelay;
+	this->_health.Bits          = 0;
+	this->_health.WindowStart   = GetTick();
+	this->_health.Load          = 0;
+}
+
+void CanBus::NoteBusOff()
+{
+	if (this->_health.State == ErrorState::BusOff)
+		return;
+
+	uint32_t now              = GetTick();
+	this->_health.State       = ErrorState::BusOff;
+	this->_health.BusOffCount = this->_health.BusOffCount + 1;
+	this->_health.BusOffTime  = now;
+	this->_health.RecoveryAt  = now + this->_health.RecoveryDelay;
+}
+
+void CanBus::UpdateHealth()
+{
+	const HealthConfig& config = this->_health.Config;
+	uint32_t now               = GetTick();
+
+	uint8_t txErrors;
+	uint8_t rxErrors;
+	ErrorState state = this->ReadErrorState(txErrors, rxErrors);
+
+	this->_health.TxErrors = txErrors;
+	this->_health.RxErrors = rxErrors;
+	if (state == ErrorState::BusOff)
+		this->NoteBusOff();
+	else
+		this->_health.State = state;
+
+	if (this->_health.State == ErrorState::BusOff)
+	{
+		// A controller that is still bus-off when the wait ends is restarted again, each attempt doubles the wait
+		if (config.AutoRecover && (int32_t)(now - this->_health.RecoveryAt) >= 0)
+		{
+			this->RecoverBusOff();
+
+			uint32_t delay              = this->_health.RecoveryDelay * 2;
+			this->_health.RecoveryDelay = delay > config.MaxRecoveryDelay ? config.MaxRecoveryDelay : delay;
+			this->_health.RecoveryAt    = now + this->_health.RecoveryDelay;
+		}
+	}
+	else if (this->_health.BusOffCount != 0 && now - this->_health.BusOffTime >= config.StableTime)
+	{
+		this->_health.RecoveryDelay = config.RecoveryDelay;
+	}
+
+	uint32_t elapsed = now - this->_health.WindowStart;
+	if (elapsed < config.LoadWindow || elapsed == 0)
+		return;
+
+	if (config.Bitrate != 0)
+	{
+		uint32_t bits;
+		{
+			CanOs::CriticalSection section;
+			bits               = this->_health.Bits;
+			this->_health.Bits = 0;
+		}
+
+		uint64_t capacity  = (uint64_t)config.Bitrate * elapsed;
+		uint64_t load      = (uint64_t)bits * 1000 * 1000 / capacity;
+		this->_health.Load = (uint16_t)(load > 1000 ? 1000 : load);
+	}
+	this->_health.WindowStart = now;
+
+	// The thresholds to relax are lower than the ones to throttle, so the level does not flip between windows
+	bool congested = config.ThrottleLoad != 0 && this->_health.Load >= config.ThrottleLoad;
+	bool failing   = this->_health.State >= ErrorState::Passive || (config.ThrottleErrors != 0 && txErrors >= config.ThrottleErrors);
+	bool calm      = (config.ThrottleLoad == 0 || this->_health.Load < config.ThrottleLoad - config.ThrottleLoad / 8) &&
+	            (config.ThrottleErrors == 0 || txErrors < config.ThrottleErrors / 2) && this->_health.State <= ErrorState::Warning;
+
+	uint32_t level = this->_health.ThrottleLevel;
+	if ((congested || failing) && level < CanBus::MAX_THROTTLE_LEVEL)
+		this->_health.ThrottleLevel = level + 1;
+	else if (calm && level > 0)
+		this->_health.ThrottleLevel = level - 1;
+}
+
+} // namespace PSR
@@ -21,10 +21,19 @@ namespace PSR
 
 std::vector<std::tuple<CanBus*, CanBus::Interface*>> CanBus::RegisteredInterfaces = std::vector<std::tuple<CanBus*, CanBus::Interface*>>();
 
-CanBus::CanBus(CanBus::Interface* interface) : _interface(interface), _fifo0Callbacks(), _fifo1Callbacks()
+CanBus::CanBus(CanBus::Interface* interface)
+	: _interface(interface), _fifo0Callbacks(), _fifo1Callbacks(), _rtrResponders(), _rtrMissed(0), _health(), _txDeadlines(), _txDeadlineMask(0),
+	  _txSupersedeMask(0), _txExpireMask(0)
 {
-	interface->RxFifo0MsgPendingCallback = RxCallbackFifo0;
-	interface->RxFifo1MsgPendingCallback = RxCallbackFifo1;
+	interface->RxFifo0MsgPendingCallback  = RxCallbackFifo0;
+	interface->RxFifo1MsgPendingCallback  = RxCallbackFifo1;
+	interface->TxMailbox0CompleteCallback = TxCompleteCallback;
+	interface->TxMailbox1CompleteCallback = TxCompleteCallback;
+	interface->TxMailbox2CompleteCallback = TxCompleteCallback;
+	interface->TxMailbox0AbortCallback    = TxAbortCallback0;
+	interface->TxMailbox1AbortCallback    = TxAbortCallback1;
+	interface->TxMailbox2AbortCallback    = TxAbortCallback2;
+	interface->ErrorCallback              = ErrorCallback;
 }
 
 bool CanBus::Init()
@@ -41,7 +50,7 @@ bool CanBus::Init()
 
 	if (!found)
 	{
-		RegisteredInterfaces.push_back(std::make_tuple(this, interface));
+		RegisteredInterfaces.push_back(std::make_tuple(this, this->_interface));
 	}
 
 	if (!this->_fifo0Callbacks.empty())
@@ -55,12 +64,27 @@ bool CanBus::Init()
 			return false;
 	}
 
-	this->_interface->RxFifo0MsgPendingCallback = CanBus::RxCallbackFifo0;
-	this->_interface->RxFifo1MsgPendingCallback = CanBus::RxCallbackFifo1;
+	this->_interface->RxFifo0MsgPendingCallback  = CanBus::RxCallbackFifo0;
+	this->_interface->RxFifo1MsgPendingCallback  = CanBus::RxCallbackFifo1;
+	this->_interface->TxMailbox0CompleteCallback = CanBus::TxCompleteCallback;
+	this->_interface->TxMailbox1CompleteCallback = CanBus::TxCompleteCallback;
+	this->_interface->TxMailbox2CompleteCallback = CanBus::TxCompleteCallback;
+	this->_interface->TxMailbox0AbortCallback    = CanBus::TxAbortCallback0;
+	this->_interface->TxMailbox1AbortCallback    = CanBus::TxAbortCallback1;
+	this->_interface->TxMailbox2AbortCallback    = CanBus::TxAbortCallback2;
+	this->_interface->ErrorCallback              = CanBus::ErrorCallback;
+
+	// Automatic bus-off management would rejoin the bus without the recovery delay of UpdateHealth
+	this->_interface->Init.AutoRetransmission = this->_health.Config.AutoRetransmission ? ENABLE : DISABLE;
+	if (this->_health.Config.AutoRecover)
+		this->_interface->Init.AutoBusOff = DISABLE;
 
-	this->_interface->Init.AutoRetransmission = ENABLE;
 	if (HAL_CAN_Init(this->_interface) != HAL_OK)
 		return false;
+	if (HAL_CAN_ActivateNotification(this->_interface, CAN_IT_TX_MAILBOX_EMPTY) != HAL_OK)
+		return false;
+	if (HAL_CAN_ActivateNotification(this->_interface, CAN_IT_ERROR_WARNING | CAN_IT_ERROR_PASSIVE | CAN_IT_BUSOFF | CAN_IT_ERROR) != HAL_OK)
+		return false;
 	if (HAL_CAN_Start(this->_interface) != HAL_OK)
 		return false;
 
@@ -68,10 +92,22 @@ bool CanBus::Init()
 }
 
 bool CanBus::Transmit(const Frame& frame) const
+{
+	return this->AddToMailbox(frame, TxPolicy::None, 0);
+}
+
+bool CanBus::AddToMailbox(const Frame& frame, TxPolicy policy, uint32_t deadline) const
 {
 	this->TxStartEvent(this);
 	CAN_TxHeaderTypeDef txHeader;
 
+	if (this->Throttle(frame))
+	{
+		this->TxErrorEvent(this);
+		this->TxEndEvent(this);
+		return false;
+	}
+
 	while (HAL_CAN_GetTxMailboxesFreeLevel(this->_interface) == 0) {}
 
 	txHeader.ExtId = frame.IsExtended ? frame.Id & CanBus::EXT_ID_MASK : 0;
@@ -80,24 +116,192 @@ bool CanBus::Transmit(const Frame& frame) const
 	txHeader.DLC   = frame.Length;
 	txHeader.RTR   = frame.IsRTR ? CAN_RTR_REMOTE : CAN_RTR_DATA;
 
-	uint32_t mailbox;
-	bool status = HAL_CAN_AddTxMessage(this->_interface, &txHeader, (uint8_t*)frame.Data.Bytes, &mailbox) == HAL_OK;
-	if (!status)
+	bool status;
+	{
+		// Remote frames are answered from the receive interrupt, which would otherwise pick the same empty mailbox
+		CanOs::CriticalSection section;
+		uint32_t mailbox;
+		status = HAL_CAN_AddTxMessage(this->_interface, &txHeader, (uint8_t*)frame.Data.Bytes, &mailbox) == HAL_OK;
+
+		// The new frame replaces what the transmit policies knew about the previous frame of the mailbox, the frame it supersedes is
+		// only aborted once the new one is queued
+		if (status)
+		{
+			this->NoteTxCancelled(mailbox, 0);
+			this->ApplyTxPolicy(frame, mailbox, policy, deadline);
+		}
+	}
+
+	if (status)
+		this->CountFrame(frame);
+	else
+		this->TxErrorEvent(this);
+
+	this->TxEndEvent(this);
+	return status;
+}
+
+bool CanBus::TryTransmit(const Frame& frame) const
+{
+	this->TxStartEvent(this);
+
+	CAN_TxHeaderTypeDef txHeader;
+	txHeader.ExtId = frame.IsExtended ? frame.Id & CanBus::EXT_ID_MASK : 0;
+	txHeader.StdId = frame.IsExtended ? 0 : frame.Id & CanBus::STD_ID_MASK;
+	txHeader.IDE   = frame.IsExtended ? CAN_ID_EXT : CAN_ID_STD;
+	txHeader.DLC   = frame.Length;
+	txHeader.RTR   = frame.IsRTR ? CAN_RTR_REMOTE : CAN_RTR_DATA;
+
+	bool status;
+	{
+		// Also called from the receive interrupt to answer remote frames, the free mailbox must not change until it is requested
+		CanOs::CriticalSection section;
+		uint32_t mailbox;
+		status = HAL_CAN_GetTxMailboxesFreeLevel(this->_interface) != 0 && !this->Throttle(frame) &&
+		         HAL_CAN_AddTxMessage(this->_interface, &txHeader, (uint8_t*)frame.Data.Bytes, &mailbox) == HAL_OK;
+
+		// Forget the policy of the frame the mailbox held before
+		if (status)
+			this->NoteTxCancelled(mailbox, 0);
+	}
+
+	if (status)
+		this->CountFrame(frame);
+	else
 		this->TxErrorEvent(this);
 
 	this->TxEndEvent(this);
 	return status;
 }
 
+/**
+ * @brief Encode the identifier and type of a frame as they appear in the TIR register of a TX mailbox, without the transmit request
+ */
+static inline uint32_t EncodeMailboxId(const CanBus::Frame& frame)
+{
+	uint32_t tir = frame.IsExtended ? ((frame.Id & CanBus::EXT_ID_MASK) << CAN_TI0R_EXID_Pos) | CAN_TI0R_IDE : (frame.Id & CanBus::STD_ID_MASK) << CAN_TI0R_STID_Pos;
+	return tir | (frame.IsRTR ? CAN_TI0R_RTR : 0);
+}
+
+bool CanBus::Transmit(const Frame& frame, TxPolicy policy, uint32_t deadline) const
+{
+	// A frame that is already late is not queued only to be aborted
+	if (policy == TxPolicy::Deadline && (int32_t)(HAL_GetTick() - deadline) >= 0)
+	{
+		this->TxStartEvent(this);
+		this->_health.Expired = this->_health.Expired + 1;
+		this->TxErrorEvent(this);
+		this->TxEndEvent(this);
+		return false;
+	}
+
+	return this->AddToMailbox(frame, policy, deadline);
+}
+
+void CanBus::ApplyTxPolicy(const Frame& frame, uint32_t buffers, TxPolicy policy, uint32_t deadline) const
+{
+	CAN_TypeDef* can = this->_interface->Instance;
+
+	if (policy == TxPolicy::Supersede)
+	{
+		uint32_t tir = EncodeMailboxId(frame);
+
+		// Mailbox bits match CAN_TX_MAILBOX0 to CAN_TX_MAILBOX2
+		uint32_t pending    = ~((can->TSR & CAN_TSR_TME) >> CAN_TSR_TME_Pos) & ~this->_txSupersedeMask & ~buffers;
+		uint32_t superseded = 0;
+		for (uint32_t mailbox = 0; mailbox < CanBus::TX_BUFFERS; mailbox++)
+		{
+			if ((pending & (1U << mailbox)) != 0 && (can->sTxMailBox[mailbox].TIR & ~CAN_TI0R_TXRQ) == tir)
+				superseded |= 1U << mailbox;
+		}
+
+		// The old frame may already be on the bus, then the abort fails and both are sent
+		if (superseded != 0)
+		{
+			this->_txSupersedeMask = this->_txSupersedeMask | superseded;
+			HAL_CAN_AbortTxRequest(this->_interface, superseded);
+		}
+	}
+	else if (policy == TxPolicy::Deadline)
+	{
+		for (uint32_t mailbox = 0; mailbox < CanBus::TX_BUFFERS; mailbox++)
+		{
+			if ((buffers & (1U << mailbox)) != 0)
+				this->_txDeadlines[mailbox] = deadline;
+		}
+		this->_txDeadlineMask = this->_txDeadlineMask | buffers;
+	}
+}
+
+void CanBus::ExpireTxFrames() const
+{
+	CAN_TypeDef* can = this->_interface->Instance;
+	uint32_t now     = HAL_GetTick();
+
+	CanOs::CriticalSection section;
+
+	// Empty mailboxes have finished, whether their frame was sent or not
+	uint32_t tracked      = this->_txDeadlineMask & ~((can->TSR & CAN_TSR_TME) >> CAN_TSR_TME_Pos);
+	this->_txDeadlineMask = tracked;
+
+	uint32_t expired = 0;
+	for (uint32_t mailbox = 0; mailbox < CanBus::TX_BUFFERS; mailbox++)
+	{
+		if ((tracked & (1U << mailbox)) != 0 && (int32_t)(now - this->_txDeadlines[mailbox]) >= 0)
+			expired |= 1U << mailbox;
+	}
+
+	expired &= ~this->_txExpireMask;
+	if (expired == 0)
+		return;
+
+	this->_txExpireMask = this->_txExpireMask | expired;
+	HAL_CAN_AbortTxRequest(this->_interface, expired);
+}
+
+bool CanBus::TransmitTimestamped(const Frame& frame) const
+{
+	// The mailboxes can only capture a time in time triggered communication mode, which the library does not use
+	return false;
+}
+
+/**
+ * @brief Read the time in microseconds from the HAL tick and the SysTick counter
+ * @remark The controller only captures a time in time triggered communication mode, so frames are stamped in software. The tick counts
+ * HAL_GetTickFreq milliseconds per SysTick reload and the current count gives the fraction of the reload, both wrap together at 2^32 us.
+ */
+static uint32_t ReadMicroseconds()
+{
+	CanOs::CriticalSection section;
+	uint32_t tick  = HAL_GetTick();
+	uint32_t count = SysTick->VAL;
+
+	// The SysTick interrupt is masked here, a reload since it last ran has not been added to the tick yet
+	if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0)
+	{
+		tick += HAL_GetTickFreq();
+		count = SysTick->VAL;
+	}
+
+	uint32_t reload = SysTick->LOAD + 1;
+	return tick * 1000 + (uint32_t)((uint64_t)(reload - 1 - count) * HAL_GetTickFreq() * 1000 / reload);
+}
+
+uint32_t CanBus::GetTimestamp() const
+{
+	return ReadMicroseconds();
+}
+
 /**
  * @brief Try to receive a frame from the interface and update a reference to a frame
  *
  * @param hcan A pointer to the CAN interface
  * @param frame The frame to be updated with the received frame
  * @param fifo The number of the FIFO buffer to receive from
+ * @param timestamp The time the frame is stamped with, see GetTimestamp
  * @return bool Whether there was a frame available and it was successfully translated.
  */
-static bool TranslateNextFrame(CAN_HandleTypeDef* hcan, CanBus::Frame& frame, uint32_t fifo)
+static bool TranslateNextFrame(CAN_HandleTypeDef* hcan, CanBus::Frame& frame, uint32_t fifo, uint32_t timestamp)
 {
 	if (HAL_CAN_GetRxFifoFillLevel(hcan, fifo) == 0)
 	{
@@ -117,6 +321,7 @@ static bool TranslateNextFrame(CAN_HandleTypeDef* hcan, CanBus::Frame& frame, ui
 		frame.IsExtended      = isExtended;
 		frame.IsFilterMatched = true;
 		frame.FilterIndex     = rxHeader.FilterMatchIndex;
+		frame.Timestamp       = timestamp;
 
 		return true;
 	}
@@ -124,18 +329,70 @@ static bool TranslateNextFrame(CAN_HandleTypeDef* hcan, CanBus::Frame& frame, ui
 	return false;
 }
 
-bool CanBus::Receive(CanBus::Frame& frame)
+bool CanBus::Receive(CanBus::Frame& frame) const
 {
 	this->RxStartEvent(this);
 
-	bool status = TranslateNextFrame(this->_interface, frame, CAN_RX_FIFO0) || TranslateNextFrame(this->_interface, frame, CAN_RX_FIFO1);
-	if (!status)
+	// A polled frame is stamped when it is read, it may have waited in the FIFO since it was received
+	uint32_t timestamp = ReadMicroseconds();
+	bool status        = TranslateNextFrame(this->_interface, frame, CAN_RX_FIFO0, timestamp) || TranslateNextFrame(this->_interface, frame, CAN_RX_FIFO1, timestamp);
+	if (status)
+		this->CountFrame(frame);
+	else
 		this->RxErrorEvent(this);
 
 	this->RxEndEvent(this);
 	return status;
 }
 
+bool CanBus::ReceiveFor(CanBus::Frame& frame, uint32_t timeout) const
+{
+	this->RxStartEvent(this);
+
+	bool status        = false;
+	uint32_t tickStart = HAL_GetTick();
+	while (true)
+	{
+		uint32_t timestamp = ReadMicroseconds();
+		status             = TranslateNextFrame(this->_interface, frame, CAN_RX_FIFO0, timestamp) || TranslateNextFrame(this->_interface, frame, CAN_RX_FIFO1, timestamp);
+		uint32_t elapsed   = HAL_GetTick() - tickStart;
+		if (status || elapsed >= timeout)
+			break;
+
+		// The pending interrupt of a FIFO without callbacks is disabled by the interrupt that wakes this call, so it is enabled on every wait
+		HAL_CAN_ActivateNotification(this->_interface, CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_RX_FIFO1_MSG_PENDING);
+		this->_rxSignal.Wait(timeout - elapsed);
+	}
+
+	if (status)
+		this->CountFrame(frame);
+	else
+		this->RxErrorEvent(this);
+
+	this->RxEndEvent(this);
+	return status;
+}
+
+bool CanBus::TransmitFor(const Frame& frame, uint32_t timeout) const
+{
+	uint32_t tickStart = HAL_GetTick();
+	while (HAL_CAN_GetTxMailboxesFreeLevel(this->_interface) == 0)
+	{
+		uint32_t elapsed = HAL_GetTick() - tickStart;
+		if (elapsed >= timeout)
+		{
+			this->TxStartEvent(this);
+			this->TxErrorEvent(this);
+			this->TxEndEvent(this);
+			return false;
+		}
+
+		this->_txSignal.Wait(timeout - elapsed);
+	}
+
+	return this->Transmit(frame);
+}
+
 // Hack to enable comparison of function pointers
 template <typename T, typename... U> size_t getAddress(std::function<T(U...)> f)
 {
@@ -172,7 +429,10 @@ bool CanBus::AddRxCallback(Callback callback, const Filter& filter, uint32_t fif
 
 	CanBus::RxCallbackStore store;
 	store.Function     = callback;
+	store.Type         = filter.Type;
+	store.IsExtended   = filter.IsExtended;
 	store.FilterNumber = i;
+	store.Definition   = filter;
 
 	switch (fifo)
 	{
@@ -195,31 +455,118 @@ bool CanBus::AddRxCallback(Callback callback, const Filter& filter, uint32_t fif
 	return true;
 }
 
+bool CanBus::AddRxUrgentCallback(Callback callback, const Filter& filter)
+{
+	// FIFO 1 has its own interrupt vector, so urgent frames are not queued behind bulk traffic in FIFO 0
+	if (!this->AddRxCallback(callback, filter, CAN_RX_FIFO1))
+		return false;
+
+	this->_fifo1Callbacks.back().Urgent = true;
+	return true;
+}
+
+bool CanBus::AddRtrResponder(const Frame& response, uint32_t fifo, uint32_t& responder)
+{
+	if (fifo != CAN_RX_FIFO0 && fifo != CAN_RX_FIFO1)
+		return false;
+
+	CAN_TypeDef* can = this->_interface->Instance;
+	can->FMR         = CAN_FMR_FINIT;
+	uint32_t i       = 0;
+	while (i < CanBus::MAX_FILTERS)
+	{
+		if ((can->FA1R & (1 << i)) == 0)
+			break;
+		i++;
+	}
+
+	if (i == CanBus::MAX_FILTERS)
+	{
+		can->FMR = 0;
+		return false;
+	}
+
+	can->FS1R |= (1 << i);
+
+	can->FFA1R &= ~(1 << i);
+	can->FFA1R |= fifo == CAN_RX_FIFO1 ? (1 << i) : 0;
+
+	// Unlike FDCAN the filter compares the IDE and RTR bits, so only remote frames with exactly this identifier are accepted
+	uint32_t id   = response.IsExtended ? (response.Id & CanBus::EXT_ID_MASK) << 3 | CAN_ID_EXT : (response.Id & CanBus::STD_ID_MASK) << 21;
+	uint32_t mask = response.IsExtended ? CanBus::EXT_ID_MASK << 3 : CanBus::STD_ID_MASK << 21;
+
+	can->sFilterRegister[i].FR1 = id | CAN_RTR_REMOTE;
+	can->sFilterRegister[i].FR2 = mask | CAN_ID_EXT | CAN_RTR_REMOTE;
+
+	can->FA1R |= 1 << i;
+	can->FMR = 0;
+
+	RtrResponder entry;
+	entry.Response       = response;
+	entry.Response.IsRTR = false;
+	entry.Buffers[0]     = response.Data;
+	entry.Buffers[1]     = response.Data;
+	entry.Active         = 0;
+
+	responder = this->_rtrResponders.size();
+	this->_rtrResponders.push_back(entry);
+
+	// The filter has no callbacks, it is stored so its FIFO interrupt stays enabled
+	CanBus::RxCallbackStore store;
+	store.Type         = CanBus::FilterType::ID_MASK;
+	store.IsExtended   = response.IsExtended;
+	store.FilterNumber = i;
+
+	std::vector<CanBus::RxCallbackStore>& callbacks = fifo == CAN_RX_FIFO0 ? this->_fifo0Callbacks : this->_fifo1Callbacks;
+	callbacks.push_back(store);
+
+	HAL_CAN_ActivateNotification(this->_interface, fifo == CAN_RX_FIFO0 ? CAN_IT_RX_FIFO0_MSG_PENDING : CAN_IT_RX_FIFO1_MSG_PENDING);
+
+	return true;
+}
+
 void CanBus::RxCallback(CanBus::Interface* hcan, uint32_t fifo)
 {
+	// Stamped on entry, before the events and callbacks of other buses delay reading the frame
+	uint32_t timestamp = ReadMicroseconds();
+
 	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
 	{
 		if (std::get<1>(it) == hcan)
 		{
 			CanBus* canbus = std::get<0>(it);
+			canbus->_rxSignal.Notify();
+
+			// The pending interrupt stays raised while a FIFO is not empty, so FIFOs without callbacks mask it and leave the frames for ReceiveFor
+			std::vector<CanBus::RxCallbackStore>& callbacks = fifo == CAN_RX_FIFO0 ? canbus->_fifo0Callbacks : canbus->_fifo1Callbacks;
+			if (callbacks.empty())
+			{
+				HAL_CAN_DeactivateNotification(hcan, fifo == CAN_RX_FIFO0 ? CAN_IT_RX_FIFO0_MSG_PENDING : CAN_IT_RX_FIFO1_MSG_PENDING);
+				continue;
+			}
+
 			canbus->RxStartEvent(canbus);
 
 			CanBus::Frame frame;
-			if (TranslateNextFrame(hcan, frame, fifo))
+			if (TranslateNextFrame(hcan, frame, fifo, timestamp))
 			{
-				if (fifo == CAN_RX_FIFO0)
+				canbus->CountFrame(frame);
+
+				// Remote frames answered by a responder never reach the callbacks
+				bool answered = frame.IsRTR && canbus->RespondRemote(frame);
+				if (!answered && fifo == CAN_RX_FIFO0)
 				{
 					for (auto& callback : canbus->_fifo0Callbacks)
 					{
-						if (callback.FilterNumber == frame.FilterIndex)
+						if (callback.FilterNumber == frame.FilterIndex && callback.Function)
 							callback.Function(canbus, frame);
 					}
 				}
-				else if (fifo == CAN_RX_FIFO1)
+				else if (!answered && fifo == CAN_RX_FIFO1)
 				{
 					for (auto& callback : canbus->_fifo1Callbacks)
 					{
-						if (callback.FilterNumber == frame.FilterIndex)
+						if (callback.FilterNumber == frame.FilterIndex && callback.Function)
 							callback.Function(canbus, frame);
 					}
 				}
@@ -234,6 +581,34 @@ void CanBus::RxCallback(CanBus::Interface* hcan, uint32_t fifo)
 	}
 }
 
+CanBus::ErrorState CanBus::ReadErrorState(uint8_t& txErrors, uint8_t& rxErrors) const
+{
+	uint32_t esr = this->_interface->Instance->ESR;
+	txErrors     = (esr & CAN_ESR_TEC) >> CAN_ESR_TEC_Pos;
+	rxErrors     = (esr & CAN_ESR_REC) >> CAN_ESR_REC_Pos;
+
+	if ((esr & CAN_ESR_BOFF) != 0)
+		return ErrorState::BusOff;
+	if ((esr & CAN_ESR_EPVF) != 0)
+		return ErrorState::Passive;
+	if ((esr & CAN_ESR_EWGF) != 0)
+		return ErrorState::Warning;
+
+	return ErrorState::Active;
+}
+
+bool CanBus::RecoverBusOff()
+{
+	if ((this->_interface->Instance->ESR & CAN_ESR_BOFF) == 0)
+		return false;
+
+	this->_health.Recoveries = this->_health.Recoveries + 1;
+
+	// Without automatic bus-off management the controller only starts the recovery sequence when it leaves initialization mode
+	HAL_CAN_Stop(this->_interface);
+	return HAL_CAN_Start(this->_interface) == HAL_OK;
+}
+
 void CanBus::RxCallbackFifo0(CAN_HandleTypeDef* hcan)
 {
 	RxCallback(hcan, CAN_RX_FIFO0);
@@ -244,6 +619,73 @@ void CanBus::RxCallbackFifo1(CAN_HandleTypeDef* hcan)
 	RxCallback(hcan, CAN_RX_FIFO1);
 }
 
+void CanBus::TxCompleteCallback(CAN_HandleTypeDef* hcan)
+{
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+	{
+		if (std::get<1>(it) == hcan)
+		{
+			CanBus* canbus = std::get<0>(it);
+			canbus->_txSignal.Notify();
+			canbus->TxCompleteEvent(canbus);
+		}
+	}
+}
+
+void CanBus::TxAbortCallback0(CAN_HandleTypeDef* hcan)
+{
+	TxAbortCallback(hcan, CAN_TX_MAILBOX0);
+}
+
+void CanBus::TxAbortCallback1(CAN_HandleTypeDef* hcan)
+{
+	TxAbortCallback(hcan, CAN_TX_MAILBOX1);
+}
+
+void CanBus::TxAbortCallback2(CAN_HandleTypeDef* hcan)
+{
+	TxAbortCallback(hcan, CAN_TX_MAILBOX2);
+}
+
+void CanBus::TxAbortCallback(CAN_HandleTypeDef* hcan, uint32_t mailboxes)
+{
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+	{
+		if (std::get<1>(it) == hcan)
+		{
+			CanBus* canbus = std::get<0>(it);
+			canbus->NoteTxCancelled(mailboxes, mailboxes);
+			canbus->_txSignal.Notify();
+		}
+	}
+}
+
+void CanBus::ErrorCallback(CAN_HandleTypeDef* hcan)
+{
+	// An aborted mailbox whose frame lost arbitration or failed before is reported as a transmit error instead of an abort
+	uint32_t failed = 0;
+	failed |= (hcan->ErrorCode & (HAL_CAN_ERROR_TX_ALST0 | HAL_CAN_ERROR_TX_TERR0)) != 0 ? CAN_TX_MAILBOX0 : 0;
+	failed |= (hcan->ErrorCode & (HAL_CAN_ERROR_TX_ALST1 | HAL_CAN_ERROR_TX_TERR1)) != 0 ? CAN_TX_MAILBOX1 : 0;
+	failed |= (hcan->ErrorCode & (HAL_CAN_ERROR_TX_ALST2 | HAL_CAN_ERROR_TX_TERR2)) != 0 ? CAN_TX_MAILBOX2 : 0;
+
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+	{
+		if (std::get<1>(it) == hcan)
+		{
+			CanBus* canbus = std::get<0>(it);
+			canbus->NoteTxCancelled(failed, failed);
+
+			// Only bus-off is acted on here, the counters and the other states are read by UpdateHealth
+			uint8_t txErrors;
+			uint8_t rxErrors;
+			if (canbus->ReadErrorState(txErrors, rxErrors) == ErrorState::BusOff)
+				canbus->NoteBusOff();
+		}
+	}
+
+	HAL_CAN_ResetError(hcan);
+}
+
 } // namespace PSR
 
 #endif
@@ -12,11 +12,13 @@
 #error "A STM32 processor is not selected"
 #else
 
+#include "can_fdcan_ram.hpp"
 #include "can_lib.hpp"
 
 #include "errors.hpp"
 #include "interrupt_queue.hpp"
 
+#include <algorithm>
 #include <cmath>
 #ifdef PRINT_DEBUG
 #include <cstdio>
@@ -29,10 +31,252 @@ namespace PSR
 
 std::vector<std::tuple<CanBus*, CanBus::Interface*>> CanBus::RegisteredInterfaces = std::vector<std::tuple<CanBus*, CanBus::Interface*>>();
 
-CanBus::CanBus(CanBus::Interface* interface) : _interface(interface), _fifo0Callbacks(), _fifo1Callbacks()
+CanBus::CanBus(CanBus::Interface* interface)
+	: _interface(interface), _fifo0Callbacks(), _fifo1Callbacks(), _rtrResponders(), _rtrMissed(0), _health(), _txDeadlines(), _txDeadlineMask(0),
+	  _txSupersedeMask(0), _txExpireMask(0), _urgentClaimed(0), _urgentWorstLatency(0), _urgentLost(0), _fifoBalancing(false), _fifoHighWater(), _timestampWraps(0),
+	  _timestampScale(0)
 {
-	interface->RxFifo0Callback = CanBus::RxCallbackFifo0;
-	interface->RxFifo1Callback = CanBus::RxCallbackFifo1;
+	interface->RxFifo0Callback             = CanBus::RxCallbackFifo0;
+	interface->RxFifo1Callback             = CanBus::RxCallbackFifo1;
+	interface->TxBufferCompleteCallback    = CanBus::TxCompleteCallback;
+	interface->HighPriorityMessageCallback = CanBus::HighPriorityCallback;
+	interface->ErrorStatusCallback         = CanBus::ErrorStatusCallback;
+	interface->TxEventFifoCallback         = CanBus::TxEventCallback;
+	interface->TimestampWraparoundCallback = CanBus::TimestampWraparoundCallback;
+	interface->TxBufferAbortCallback       = CanBus::TxAbortCallback;
+}
+
+// Message RAM TX element fields, see the "Tx Buffer Element" section of the reference manual
+static constexpr uint32_t ELEMENT_TX_ESI       = 0x80000000U; // Error state indicator
+static constexpr uint32_t ELEMENT_TX_XTD       = 0x40000000U; // Extended identifier
+static constexpr uint32_t ELEMENT_TX_RTR       = 0x20000000U; // Remote transmission request
+static constexpr uint32_t ELEMENT_TX_STDID_POS = 18;
+static constexpr uint32_t ELEMENT_TX_DLC_POS   = 16;
+
+/**
+ * @brief Get the address of a TX buffer element, buffer indices count dedicated buffers first
+ */
+static inline volatile uint32_t* TxBufferElement(const FDCAN_HandleTypeDef* hfdcan, uint32_t buffer)
+{
+#if defined(FDCAN_TXBC_NDTB)
+	return reinterpret_cast<volatile uint32_t*>(hfdcan->msgRam.TxBufferSA + buffer * hfdcan->Init.TxElmtSize * 4);
+#else
+	return reinterpret_cast<volatile uint32_t*>(hfdcan->msgRam.TxFIFOQSA + buffer * 18 * 4);
+#endif
+}
+
+/**
+ * @brief Encode the identifier, type and length of a frame into the two header words of a TX buffer element
+ */
+static inline void EncodeTxHeader(const CanBus::Frame& frame, uint32_t header[2])
+{
+	uint32_t id = frame.Id & (frame.IsExtended ? CanBus::EXT_ID_MASK : CanBus::STD_ID_MASK);
+
+	header[0]  = frame.IsExtended ? (ELEMENT_TX_XTD | id) : (id << ELEMENT_TX_STDID_POS);
+	header[0] |= frame.IsRTR ? ELEMENT_TX_RTR : 0;
+	header[1]  = (frame.Length & 0xF) << ELEMENT_TX_DLC_POS;
+}
+
+/**
+ * @brief Decode the two header words of a TX buffer element back into a frame, the payload is not modified
+ */
+static inline void DecodeTxHeader(const uint32_t header[2], CanBus::Frame& frame)
+{
+	frame.IsExtended = (header[0] & ELEMENT_TX_XTD) != 0;
+	frame.IsRTR      = (header[0] & ELEMENT_TX_RTR) != 0;
+	frame.Id         = frame.IsExtended ? header[0] & CanBus::EXT_ID_MASK : (header[0] >> ELEMENT_TX_STDID_POS) & CanBus::STD_ID_MASK;
+	frame.Length     = (header[1] >> ELEMENT_TX_DLC_POS) & 0xF;
+}
+
+/**
+ * @brief Get the TX buffers of the TX FIFO/queue as a bit mask, dedicated buffers are numbered before them
+ */
+static inline uint32_t SharedTxBuffers(const FDCAN_HandleTypeDef* hfdcan)
+{
+#if defined(FDCAN_TXBC_NDTB)
+	uint32_t elements = hfdcan->Init.TxFifoQueueElmtsNbr;
+	return (elements >= 32 ? 0xFFFFFFFFU : (1U << elements) - 1) << hfdcan->Init.TxBuffersNbr;
+#else
+	return FDCAN_TX_BUFFER0 | FDCAN_TX_BUFFER1 | FDCAN_TX_BUFFER2;
+#endif
+}
+
+/**
+ * @brief Get every configured TX buffer as a bit mask, the dedicated buffers and the TX FIFO/queue elements
+ */
+static inline uint32_t ConfiguredTxBuffers(const FDCAN_HandleTypeDef* hfdcan)
+{
+#if defined(FDCAN_TXBC_NDTB)
+	uint32_t buffers = hfdcan->Init.TxBuffersNbr + hfdcan->Init.TxFifoQueueElmtsNbr;
+	return buffers >= 32 ? 0xFFFFFFFFU : (1U << buffers) - 1;
+#else
+	return SharedTxBuffers(hfdcan);
+#endif
+}
+
+/**
+ * @brief Write the pre-encoded headers of every slot that owns a dedicated TX buffer
+ */
+static void WriteDedicatedTxHeaders(FDCAN_HandleTypeDef* hfdcan, const std::vector<CanBus::TxSlot>& slots)
+{
+	for (const CanBus::TxSlot& slot : slots)
+	{
+		if (slot.Buffer == CanBus::TX_SLOT_SHARED)
+			continue;
+
+		volatile uint32_t* element = TxBufferElement(hfdcan, slot.Buffer);
+		element[0]                 = slot.Header[0];
+		element[1]                 = slot.Header[1];
+	}
+}
+
+/**
+ * @brief Initialize the controller and write the dedicated buffer headers again, initialization clears message RAM
+ * @remark Every initialization goes through here, a transmit slot whose header is lost would send an all zero frame
+ */
+static bool InitializeTxSlots(FDCAN_HandleTypeDef* hfdcan, const std::vector<CanBus::TxSlot>& slots)
+{
+	if (HAL_FDCAN_Init(hfdcan) != HAL_OK)
+		return false;
+
+	WriteDedicatedTxHeaders(hfdcan, slots);
+	return true;
+}
+
+/**
+ * @brief Check whether any callback uses the urgent receive path
+ */
+static bool HasUrgentCallbacks(const std::vector<CanBus::RxCallbackStore>& callbacks)
+{
+	for (const CanBus::RxCallbackStore& callback : callbacks)
+	{
+		if (callback.Urgent)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Start the timestamp counter so it counts nominal bit times and compute its length in microseconds, must be called before starting
+ *
+ * @param hfdcan The interface to configure
+ * @param scale Microseconds per counter tick in 16.16 fixed point, 0 when the kernel clock is unknown
+ */
+static bool ConfigureTimestamps(FDCAN_HandleTypeDef* hfdcan, uint32_t& scale)
+{
+	if (HAL_FDCAN_ConfigTimestampCounter(hfdcan, FDCAN_TIMESTAMP_PRESC_1) != HAL_OK)
+		return false;
+	if (HAL_FDCAN_EnableTimestampCounter(hfdcan, FDCAN_TIMESTAMP_INTERNAL) != HAL_OK)
+		return false;
+
+#if defined(RCC_PERIPHCLK_FDCAN1)
+	uint32_t clock = HAL_RCCEx_GetPeriphCLKFreq(RCC_PERIPHCLK_FDCAN1);
+#else
+	uint32_t clock = HAL_RCCEx_GetPeriphCLKFreq(RCC_PERIPHCLK_FDCAN);
+#endif
+	uint64_t quanta = (uint64_t)hfdcan->Init.NominalPrescaler * (1 + hfdcan->Init.NominalTimeSeg1 + hfdcan->Init.NominalTimeSeg2);
+	scale           = clock == 0 ? 0 : (uint32_t)((quanta * 1000000 << 16) / clock);
+
+	// The wraparound interrupt extends the 16 bit counter, transmit events carry the timestamps of TransmitTimestamped
+	return HAL_FDCAN_ActivateNotification(hfdcan, FDCAN_IT_TIMESTAMP_WRAPAROUND | FDCAN_IT_TX_EVT_FIFO_NEW_DATA, 0) == HAL_OK;
+}
+
+/**
+ * @brief Route the high priority message interrupt to interrupt line 1, must be called before starting
+ */
+static bool ConfigureUrgentPath(FDCAN_HandleTypeDef* hfdcan)
+{
+#if defined(FDCAN_IT_GROUP_SMSG)
+	// Lines are assigned per interrupt group here, transmit complete shares the group and moves to line 1 as well
+	uint32_t lineSelection = FDCAN_IT_GROUP_SMSG;
+#else
+	uint32_t lineSelection = FDCAN_IT_RX_HIGH_PRIORITY_MSG;
+#endif
+	if (HAL_FDCAN_ConfigInterruptLines(hfdcan, lineSelection, FDCAN_INTERRUPT_LINE1) != HAL_OK)
+		return false;
+
+	return HAL_FDCAN_ActivateNotification(hfdcan, FDCAN_IT_RX_HIGH_PRIORITY_MSG, 0) == HAL_OK;
+}
+
+/**
+ * @brief Select the FIFO of a filter, only urgent filters raise the high priority message interrupt
+ */
+static uint32_t FilterConfig(const CanBus::RxCallbackStore& store, uint32_t fifo)
+{
+	if (store.Urgent)
+		return fifo == CanBus::RX_FIFO0 ? FDCAN_FILTER_TO_RXFIFO0_HP : FDCAN_FILTER_TO_RXFIFO1_HP;
+
+	return fifo == CanBus::RX_FIFO0 ? FDCAN_FILTER_TO_RXFIFO0 : FDCAN_FILTER_TO_RXFIFO1;
+}
+
+/**
+ * @brief Write the filter element of a stored callback to message RAM
+ */
+static bool ConfigureFilter(FDCAN_HandleTypeDef* hfdcan, const CanBus::RxCallbackStore& store, uint32_t fifo)
+{
+	const CanBus::Filter& filter = store.Definition;
+	FDCAN_FilterTypeDef fdcanFilter;
+
+	switch (filter.Type)
+	{
+	case CanBus::FilterType::RANGE:
+		fdcanFilter.FilterType = FDCAN_FILTER_RANGE;
+		fdcanFilter.FilterID1  = filter.Id;
+		fdcanFilter.FilterID2  = filter.Id2;
+		break;
+	case CanBus::FilterType::DUAL:
+		fdcanFilter.FilterType = FDCAN_FILTER_DUAL;
+		fdcanFilter.FilterID1  = filter.Id;
+		fdcanFilter.FilterID2  = filter.Id2;
+		break;
+	case CanBus::FilterType::ID_MASK:
+		fdcanFilter.FilterType = FDCAN_FILTER_MASK;
+		fdcanFilter.FilterID1  = filter.Id;
+		fdcanFilter.FilterID2  = filter.Mask;
+		break;
+	default:
+		return false;
+	}
+
+	fdcanFilter.IdType       = filter.IsExtended ? FDCAN_EXTENDED_ID : FDCAN_STANDARD_ID;
+	fdcanFilter.FilterIndex  = store.FilterNumber;
+	fdcanFilter.FilterConfig = FilterConfig(store, fifo);
+
+	return HAL_FDCAN_ConfigFilter(hfdcan, &fdcanFilter) == HAL_OK;
+}
+
+/**
+ * @brief Write the filter elements of every stored callback, initialization clears message RAM so they are written again after it
+ */
+static bool ConfigureFilters(FDCAN_HandleTypeDef* hfdcan, const std::vector<CanBus::RxCallbackStore>& fifo0, const std::vector<CanBus::RxCallbackStore>& fifo1)
+{
+	for (const CanBus::RxCallbackStore& store : fifo0)
+	{
+		if (!ConfigureFilter(hfdcan, store, CanBus::RX_FIFO0))
+			return false;
+	}
+	for (const CanBus::RxCallbackStore& store : fifo1)
+	{
+		if (!ConfigureFilter(hfdcan, store, CanBus::RX_FIFO1))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * @brief Count the filters of one identifier type
+ */
+static uint32_t CountFilters(const std::vector<CanBus::RxCallbackStore>& fifo0, const std::vector<CanBus::RxCallbackStore>& fifo1, bool isExtended)
+{
+	uint32_t count = 0;
+	for (const CanBus::RxCallbackStore& store : fifo0)
+		count += store.IsExtended == isExtended ? 1 : 0;
+	for (const CanBus::RxCallbackStore& store : fifo1)
+		count += store.IsExtended == isExtended ? 1 : 0;
+
+	return count;
 }
 
 bool CanBus::Init()
@@ -71,25 +315,85 @@ bool CanBus::Init()
 		}
 	}
 
-	this->_interface->RxFifo0Callback = CanBus::RxCallbackFifo0;
-	this->_interface->RxFifo1Callback = CanBus::RxCallbackFifo1;
+	this->_interface->RxFifo0Callback             = CanBus::RxCallbackFifo0;
+	this->_interface->RxFifo1Callback             = CanBus::RxCallbackFifo1;
+	this->_interface->TxBufferCompleteCallback    = CanBus::TxCompleteCallback;
+	this->_interface->HighPriorityMessageCallback = CanBus::HighPriorityCallback;
+	this->_interface->ErrorStatusCallback         = CanBus::ErrorStatusCallback;
+	this->_interface->TxEventFifoCallback         = CanBus::TxEventCallback;
+	this->_interface->TimestampWraparoundCallback = CanBus::TimestampWraparoundCallback;
+	this->_interface->TxBufferAbortCallback       = CanBus::TxAbortCallback;
 
-	this->_interface->Init.AutoRetransmission = ENABLE;
+	this->_interface->Init.AutoRetransmission = this->_health.Config.AutoRetransmission ? ENABLE : DISABLE;
 	this->_interface->Init.TransmitPause      = DISABLE;
 
-	this->_interface->Init.StdFiltersNbr = 0;
-	this->_interface->Init.ExtFiltersNbr = 0;
+	this->_interface->Init.StdFiltersNbr = CountFilters(this->_fifo0Callbacks, this->_fifo1Callbacks, false);
+	this->_interface->Init.ExtFiltersNbr = CountFilters(this->_fifo0Callbacks, this->_fifo1Callbacks, true);
+
+#if defined(FDCAN_TXBC_NDTB)
+	uint32_t dedicatedBuffers = 0;
+	for (const TxSlot& slot : this->_txSlots)
+	{
+		if (slot.Buffer != CanBus::TX_SLOT_SHARED)
+			dedicatedBuffers++;
+	}
+	this->_interface->Init.TxBuffersNbr = dedicatedBuffers;
+#endif
+#if defined(FDCAN_TXEFC_EFS)
+	// TransmitTimestamped needs TX event elements on controllers with configurable message RAM
+	if (this->_interface->Init.TxEventsNbr == 0)
+		this->_interface->Init.TxEventsNbr = 3;
+#endif
 
-	if (HAL_FDCAN_Init(this->_interface) != HAL_OK)
+	if (!InitializeTxSlots(this->_interface, this->_txSlots))
 	{
 		ErrorMessage::SetMessage("CanBus: Failed to initialize\n");
 		return false;
 	}
-	if (HAL_FDCAN_ConfigGlobalFilter(this->_interface, FDCAN_REJECT, FDCAN_REJECT, FDCAN_REJECT_REMOTE, FDCAN_REJECT_REMOTE) != HAL_OK)
+
+	// Initialization clears message RAM, so the filters are written afterwards
+	if (!ConfigureFilters(this->_interface, this->_fifo0Callbacks, this->_fifo1Callbacks))
+	{
+		ErrorMessage::SetMessage("CanBus: Failed to configure filters\n");
+		return false;
+	}
+
+	// TransmitFor, the coroutine send tickets and the router wait for completions of every buffer, including the dedicated slot buffers
+	if (HAL_FDCAN_ActivateNotification(this->_interface, FDCAN_IT_TX_COMPLETE, ConfiguredTxBuffers(this->_interface)) != HAL_OK)
+	{
+		ErrorMessage::SetMessage("CanBus: Failed to activate TX complete notification\n");
+		return false;
+	}
+	if (HAL_FDCAN_ActivateNotification(this->_interface, FDCAN_IT_TX_ABORT_COMPLETE, SharedTxBuffers(this->_interface)) != HAL_OK)
+	{
+		ErrorMessage::SetMessage("CanBus: Failed to activate TX abort notification\n");
+		return false;
+	}
+	if (HAL_FDCAN_ActivateNotification(this->_interface, FDCAN_IT_BUS_OFF | FDCAN_IT_ERROR_PASSIVE | FDCAN_IT_ERROR_WARNING, 0) != HAL_OK)
+	{
+		ErrorMessage::SetMessage("CanBus: Failed to activate error status notification\n");
+		return false;
+	}
+	// Remote frames are only let through to the filters when a responder is waiting for them
+	uint32_t remote = this->_rtrResponders.empty() ? FDCAN_REJECT_REMOTE : FDCAN_FILTER_REMOTE;
+	if (HAL_FDCAN_ConfigGlobalFilter(this->_interface, FDCAN_REJECT, FDCAN_REJECT, remote, remote) != HAL_OK)
 	{
 		ErrorMessage::SetMessage("CanBus: Failed to configure global filter\n");
 		return false;
 	}
+	this->_timestampWraps = 0;
+	if (!ConfigureTimestamps(this->_interface, this->_timestampScale))
+	{
+		ErrorMessage::SetMessage("CanBus: Failed to configure timestamps\n");
+		return false;
+	}
+#ifndef PSR_CAN_HAL_RX
+	if (HasUrgentCallbacks(this->_fifo1Callbacks) && !ConfigureUrgentPath(this->_interface))
+	{
+		ErrorMessage::SetMessage("CanBus: Failed to configure urgent receive path\n");
+		return false;
+	}
+#endif
 	if (HAL_FDCAN_Start(this->_interface) != HAL_OK)
 	{
 		ErrorMessage::SetMessage(("CanBus: Failed to start\n"));
@@ -122,6 +426,93 @@ static void PrintFrameInfo(const PSR::CanBus::Frame& frame, const char* prefix)
 }
 
 bool CanBus::Transmit(const Frame& frame) const
+{
+	return this->AddToTxFifo(frame, false, TxPolicy::None, 0);
+}
+
+bool CanBus::TransmitTimestamped(const Frame& frame) const
+{
+	return this->AddToTxFifo(frame, true, TxPolicy::None, 0);
+}
+
+bool CanBus::Transmit(const Frame& frame, TxPolicy policy, uint32_t deadline) const
+{
+	// A frame that is already late is not queued only to be cancelled
+	if (policy == TxPolicy::Deadline && (int32_t)(HAL_GetTick() - deadline) >= 0)
+	{
+		this->TxStartEvent(this);
+		this->_health.Expired = this->_health.Expired + 1;
+		this->TxErrorEvent(this);
+		this->TxEndEvent(this);
+		return false;
+	}
+
+	return this->AddToTxFifo(frame, false, policy, deadline);
+}
+
+void CanBus::ApplyTxPolicy(const Frame& frame, uint32_t buffers, TxPolicy policy, uint32_t deadline) const
+{
+	FDCAN_GlobalTypeDef* fdcan = this->_interface->Instance;
+
+	if (policy == TxPolicy::Supersede)
+	{
+		uint32_t header[2];
+		EncodeTxHeader(frame, header);
+
+		// Dedicated buffers belong to their slots, only the TX FIFO/queue is searched
+		uint32_t pending    = fdcan->TXBRP & SharedTxBuffers(this->_interface) & ~this->_txSupersedeMask & ~buffers;
+		uint32_t superseded = 0;
+		for (uint32_t buffer = 0; buffer < CanBus::TX_BUFFERS; buffer++)
+		{
+			if ((pending & (1U << buffer)) != 0 && (TxBufferElement(this->_interface, buffer)[0] & ~ELEMENT_TX_ESI) == header[0])
+				superseded |= 1U << buffer;
+		}
+
+		// The old frame may already be on the bus, then the cancellation fails and both are sent
+		if (superseded != 0)
+		{
+			this->_txSupersedeMask = this->_txSupersedeMask | superseded;
+			fdcan->TXBCR           = superseded;
+		}
+	}
+	else if (policy == TxPolicy::Deadline)
+	{
+		for (uint32_t buffer = 0; buffer < CanBus::TX_BUFFERS; buffer++)
+		{
+			if ((buffers & (1U << buffer)) != 0)
+				this->_txDeadlines[buffer] = deadline;
+		}
+		this->_txDeadlineMask = this->_txDeadlineMask | buffers;
+	}
+}
+
+void CanBus::ExpireTxFrames() const
+{
+	FDCAN_GlobalTypeDef* fdcan = this->_interface->Instance;
+	uint32_t now               = HAL_GetTick();
+
+	CanOs::CriticalSection section;
+
+	// Buffers no longer pending were sent or cancelled, their completion interrupt may not have run yet
+	uint32_t tracked      = this->_txDeadlineMask & fdcan->TXBRP;
+	this->_txDeadlineMask = tracked;
+
+	uint32_t expired = 0;
+	for (uint32_t buffer = 0; buffer < CanBus::TX_BUFFERS; buffer++)
+	{
+		if ((tracked & (1U << buffer)) != 0 && (int32_t)(now - this->_txDeadlines[buffer]) >= 0)
+			expired |= 1U << buffer;
+	}
+
+	expired &= ~this->_txExpireMask;
+	if (expired == 0)
+		return;
+
+	this->_txExpireMask = this->_txExpireMask | expired;
+	fdcan->TXBCR        = expired;
+}
+
+bool CanBus::AddToTxFifo(const Frame& frame, bool timestamped, TxPolicy policy, uint32_t deadline) const
 {
 	constexpr uint32_t timeout = 20;
 
@@ -132,6 +523,13 @@ bool CanBus::Transmit(const Frame& frame) const
 	PrintFrameInfo(frame, "TX");
 #endif
 
+	if (this->Throttle(frame))
+	{
+		this->TxErrorEvent(this);
+		this->TxEndEvent(this);
+		return false;
+	}
+
 	uint32_t tickStart = HAL_GetTick();
 	while (HAL_FDCAN_GetTxFifoFreeLevel(this->_interface) == 0)
 	{
@@ -150,61 +548,322 @@ bool CanBus::Transmit(const Frame& frame) const
 	txHeader.ErrorStateIndicator = FDCAN_ESI_PASSIVE;
 	txHeader.BitRateSwitch       = FDCAN_BRS_OFF;
 	txHeader.FDFormat            = FDCAN_CLASSIC_CAN;
-	txHeader.TxEventFifoControl  = FDCAN_NO_TX_EVENTS;
+	txHeader.TxEventFifoControl  = timestamped ? FDCAN_STORE_TX_EVENTS : FDCAN_NO_TX_EVENTS;
 	txHeader.MessageMarker       = 0;
 
-	bool status = HAL_FDCAN_AddMessageToTxFifoQ(this->_interface, &txHeader, (uint8_t*)frame.Data.Bytes) == HAL_OK;
-	if (!status)
+	bool status;
+	{
+		// Remote frames are answered from the receive interrupt, which would otherwise take the same put index
+		CanOs::CriticalSection section;
+		status = HAL_FDCAN_AddMessageToTxFifoQ(this->_interface, &txHeader, (uint8_t*)frame.Data.Bytes) == HAL_OK;
+
+		// The frame it replaces is only cancelled once the new one is queued
+		if (status)
+			this->ApplyTxPolicy(frame, this->_interface->LatestTxFifoQRequest, policy, deadline);
+	}
+
+	if (status)
+		this->CountFrame(frame);
+	else
 		this->TxErrorEvent(this);
 
 	this->TxEndEvent(this);
 	return status;
 }
 
-/**
- * @brief Try to receive a frame from the interface and update a reference to a frame
- *
- * @param hcan A pointer to the CAN interface
- * @param frame The frame to be updated with the received frame
- * @param fifo The number of the FIFO buffer to receive from
- * @return bool Whether there was a frame available and it was successfully translated.
- */
-static bool TranslateNextFrame(FDCAN_HandleTypeDef* hfdcan, CanBus::Frame& frame, uint32_t fifo)
+bool CanBus::TryTransmit(const Frame& frame) const
 {
-	if (HAL_FDCAN_GetRxFifoFillLevel(hfdcan, fifo) == 0)
-	{
-		return false;
-	}
+	this->TxStartEvent(this);
 
-	FDCAN_RxHeaderTypeDef rxHeader;
-	HAL_StatusTypeDef status = HAL_FDCAN_GetRxMessage(hfdcan, fifo, &rxHeader, frame.Data.Bytes);
+#ifdef PRINT_DEBUG
+	PrintFrameInfo(frame, "TX");
+#endif
 
-	// Only modify frame if the message is received properly
-	if (status == HAL_OK)
+	uint32_t header[2];
+	EncodeTxHeader(frame, header);
+
+	bool queued;
 	{
-		bool isExtended       = rxHeader.IdType == FDCAN_EXTENDED_ID;
-		frame.Id              = rxHeader.Identifier & (isExtended ? CanBus::EXT_ID_MASK : CanBus::STD_ID_MASK);
-		frame.Length          = rxHeader.DataLength;
-		frame.IsRTR           = rxHeader.RxFrameType == FDCAN_REMOTE_FRAME;
-		frame.IsExtended      = isExtended;
-		frame.IsFilterMatched = rxHeader.IsFilterMatchingFrame == 0;
-		frame.FilterIndex     = rxHeader.FilterIndex;
+		// Also called from the receive interrupt to answer remote frames, the put index must not change until the request is set
+		CanOs::CriticalSection section;
+		FDCAN_GlobalTypeDef* fdcan = this->_interface->Instance;
+		uint32_t queueStatus       = fdcan->TXFQS;
+		queued                     = (queueStatus & FDCAN_TXFQS_TFQF) == 0 && !this->Throttle(frame);
+		if (queued)
+		{
+			// The element is written directly, HAL_FDCAN_AddMessageToTxFifoQ would re-encode the same header through FDCAN_TxHeaderTypeDef
+			uint32_t buffer            = (queueStatus & FDCAN_TXFQS_TFQPI) >> FDCAN_TXFQS_TFQPI_Pos;
+			volatile uint32_t* element = TxBufferElement(this->_interface, buffer);
+			element[0]                 = header[0];
+			element[1]                 = header[1];
+			element[2]                 = frame.Data.Words[0];
+			element[3]                 = frame.Data.Words[1];
 
-		return true;
+			fdcan->TXBAR                          = 1U << buffer;
+			this->_interface->LatestTxFifoQRequest = 1U << buffer;
+		}
 	}
 
-	return false;
+	if (!queued)
+	{
+		this->TxErrorEvent(this);
+		this->TxEndEvent(this);
+		return false;
+	}
+
+	this->CountFrame(frame);
+	this->TxEndEvent(this);
+	return true;
 }
 
-bool CanBus::Receive(CanBus::Frame& frame) const
+void CanBus::SetTxPriorityQueue(bool enable)
 {
-	this->RxStartEvent(this);
+	this->_interface->Init.TxFifoQueueMode = enable ? FDCAN_TX_QUEUE_OPERATION : FDCAN_TX_FIFO_OPERATION;
+}
 
-	bool status = TranslateNextFrame(this->_interface, frame, CanBus::RX_FIFO0) || TranslateNextFrame(this->_interface, frame, CanBus::RX_FIFO1);
-	if (!status)
-		this->RxErrorEvent(this);
+bool CanBus::AddTxSlot(const Frame& frame, uint32_t& slot)
+{
+	CanBus::TxSlot txSlot;
+	EncodeTxHeader(frame, txSlot.Header);
+	txSlot.Buffer = CanBus::TX_SLOT_SHARED;
+
+#if defined(FDCAN_TXBC_NDTB)
+	// Dedicated buffers are numbered before the TX FIFO/queue elements and share the 32 buffer limit with them
+	uint32_t dedicatedBuffers = 0;
+	for (const TxSlot& existing : this->_txSlots)
+	{
+		if (existing.Buffer != CanBus::TX_SLOT_SHARED)
+			dedicatedBuffers++;
+	}
+
+	if (dedicatedBuffers + this->_interface->Init.TxFifoQueueElmtsNbr < 32)
+		txSlot.Buffer = dedicatedBuffers;
+#endif
+
+	slot = this->_txSlots.size();
+	this->_txSlots.push_back(txSlot);
+
+	return true;
+}
+
+bool CanBus::TransmitSlot(uint32_t slot, const Payload& data) const
+{
+	if (slot >= this->_txSlots.size())
+		return false;
+
+	this->TxStartEvent(this);
+
+	const CanBus::TxSlot& txSlot = this->_txSlots[slot];
+	FDCAN_GlobalTypeDef* fdcan   = this->_interface->Instance;
+	uint32_t buffer              = txSlot.Buffer;
+
+	CanBus::Frame frame;
+	DecodeTxHeader(txSlot.Header, frame);
+	frame.Data = data;
+	if (this->Throttle(frame))
+	{
+		this->TxErrorEvent(this);
+		this->TxEndEvent(this);
+		return false;
+	}
+
+	bool queued;
+	{
+		// Shared slots take the put index of the TX FIFO/queue, which the receive interrupt also uses to answer remote frames
+		CanOs::CriticalSection section;
+		volatile uint32_t* element = nullptr;
+		if (buffer != CanBus::TX_SLOT_SHARED)
+		{
+			// The previous payload has not been sent yet, it cannot be rewritten while the controller may be reading it
+			if ((fdcan->TXBRP & (1U << buffer)) == 0)
+				element = TxBufferElement(this->_interface, buffer);
+		}
+		else
+		{
+			uint32_t queueStatus = fdcan->TXFQS;
+			if ((queueStatus & FDCAN_TXFQS_TFQF) == 0)
+			{
+				buffer     = (queueStatus & FDCAN_TXFQS_TFQPI) >> FDCAN_TXFQS_TFQPI_Pos;
+				element    = TxBufferElement(this->_interface, buffer);
+				element[0] = txSlot.Header[0];
+				element[1] = txSlot.Header[1];
+			}
+		}
+
+		queued = element != nullptr;
+		if (queued)
+		{
+			element[2] = data.Words[0];
+			element[3] = data.Words[1];
+
+			fdcan->TXBAR                          = 1U << buffer;
+			this->_interface->LatestTxFifoQRequest = 1U << buffer;
+		}
+	}
+
+	if (!queued)
+	{
+		this->TxErrorEvent(this);
+		this->TxEndEvent(this);
+		return false;
+	}
+
+	this->CountFrame(frame);
+	this->TxEndEvent(this);
+	return true;
+}
+
+using FdcanRam::DecodeRxHeader;
+using FdcanRam::DecodeRxPayload;
+using FdcanRam::ELEMENT_MASK_RXTS;
+
+/**
+ * @brief Get the size of a RX FIFO element in words
+ */
+static inline uint32_t RxFifoElementWords(const FDCAN_HandleTypeDef* hfdcan, uint32_t fifo)
+{
+#if defined(FDCAN_RXESC_F0DS)
+	// Configurable message RAM, the element size constants are the size in words
+	return fifo == CanBus::RX_FIFO0 ? hfdcan->Init.RxFifo0ElmtSize : hfdcan->Init.RxFifo1ElmtSize;
+#else
+	// Fixed message RAM layout, 2 header words and 64 bytes of data
+	return 18;
+#endif
+}
+
+/**
+ * @brief Get the number of elements in a RX FIFO
+ */
+static inline uint32_t RxFifoDepth(const FDCAN_HandleTypeDef* hfdcan, uint32_t fifo)
+{
+#if defined(FDCAN_RXESC_F0DS)
+	return fifo == CanBus::RX_FIFO0 ? hfdcan->Init.RxFifo0ElmtsNbr : hfdcan->Init.RxFifo1ElmtsNbr;
+#else
+	return 3;
+#endif
+}
+
+/**
+ * @brief Get the address of an element in a RX FIFO
+ */
+static inline const volatile uint32_t* RxFifoElement(const FDCAN_HandleTypeDef* hfdcan, uint32_t fifo, uint32_t index)
+{
+	uint32_t start = fifo == CanBus::RX_FIFO0 ? hfdcan->msgRam.RxFIFO0SA : hfdcan->msgRam.RxFIFO1SA;
+	return reinterpret_cast<const volatile uint32_t*>(start + index * RxFifoElementWords(hfdcan, fifo) * 4);
+}
+
+/**
+ * @brief Read the status register of a RX FIFO, FIFO 1 uses the same field layout as FIFO 0
+ */
+static inline uint32_t RxFifoStatus(const FDCAN_HandleTypeDef* hfdcan, uint32_t fifo)
+{
+	return fifo == CanBus::RX_FIFO0 ? hfdcan->Instance->RXF0S : hfdcan->Instance->RXF1S;
+}
+
+/**
+ * @brief Release all elements of a RX FIFO up to and including an index
+ */
+static inline void AcknowledgeRxFifo(FDCAN_HandleTypeDef* hfdcan, uint32_t fifo, uint32_t index)
+{
+	if (fifo == CanBus::RX_FIFO0)
+		hfdcan->Instance->RXF0A = index;
 	else
+		hfdcan->Instance->RXF1A = index;
+}
+
+/**
+ * @brief Try to receive a frame from the interface and update a reference to a frame
+ *
+ * @param hcan A pointer to the CAN interface
+ * @param frame The frame to be updated with the received frame
+ * @param fifo The number of the FIFO buffer to receive from
+ * @return bool Whether there was a frame available and it was successfully translated. Timestamp holds the raw counter value.
+ */
+static bool TranslateNextFrame(FDCAN_HandleTypeDef* hfdcan, CanBus::Frame& frame, uint32_t fifo)
+{
+#ifdef PSR_CAN_HAL_RX
+	if (HAL_FDCAN_GetRxFifoFillLevel(hfdcan, fifo) == 0)
+	{
+		return false;
+	}
+
+	FDCAN_RxHeaderTypeDef rxHeader;
+	HAL_StatusTypeDef status = HAL_FDCAN_GetRxMessage(hfdcan, fifo, &rxHeader, frame.Data.Bytes);
+
+	// Only modify frame if the message is received properly
+	if (status == HAL_OK)
+	{
+		bool isExtended       = rxHeader.IdType == FDCAN_EXTENDED_ID;
+		frame.Id              = rxHeader.Identifier & (isExtended ? CanBus::EXT_ID_MASK : CanBus::STD_ID_MASK);
+		frame.Length          = rxHeader.DataLength;
+		frame.IsRTR           = rxHeader.RxFrameType == FDCAN_REMOTE_FRAME;
+		frame.IsExtended      = isExtended;
+		frame.IsFilterMatched = rxHeader.IsFilterMatchingFrame == 0;
+		frame.FilterIndex     = rxHeader.FilterIndex;
+		frame.Timestamp       = rxHeader.RxTimestamp;
+
+		return true;
+	}
+
+	return false;
+#else
+	uint32_t index;
+	if (!FdcanRam::ReadRxFifo(RxFifoStatus(hfdcan, fifo), RxFifoElement(hfdcan, fifo, 0), RxFifoElementWords(hfdcan, fifo), frame, index))
 	{
+		return false;
+	}
+
+	AcknowledgeRxFifo(hfdcan, fifo, index);
+
+	return true;
+#endif
+}
+
+bool CanBus::Receive(CanBus::Frame& frame) const
+{
+	this->RxStartEvent(this);
+
+	bool status = TranslateNextFrame(this->_interface, frame, CanBus::RX_FIFO0) || TranslateNextFrame(this->_interface, frame, CanBus::RX_FIFO1);
+	if (!status)
+		this->RxErrorEvent(this);
+	else
+	{
+		frame.Timestamp = this->ConvertTimestamp(frame.Timestamp);
+		this->CountFrame(frame);
+#ifdef PRINT_DEBUG
+		PrintFrameInfo(frame, "RX");
+#endif
+	}
+
+	this->RxEndEvent(this);
+	return status;
+}
+
+bool CanBus::ReceiveFor(CanBus::Frame& frame, uint32_t timeout) const
+{
+	// FIFOs without callbacks only raise the new message interrupt to wake this call, the frames stay in the FIFO
+	HAL_FDCAN_ActivateNotification(this->_interface, FDCAN_IT_RX_FIFO0_NEW_MESSAGE | FDCAN_IT_RX_FIFO1_NEW_MESSAGE, 0);
+
+	this->RxStartEvent(this);
+
+	bool status        = false;
+	uint32_t tickStart = HAL_GetTick();
+	while (true)
+	{
+		status           = TranslateNextFrame(this->_interface, frame, CanBus::RX_FIFO0) || TranslateNextFrame(this->_interface, frame, CanBus::RX_FIFO1);
+		uint32_t elapsed = HAL_GetTick() - tickStart;
+		if (status || elapsed >= timeout)
+			break;
+
+		this->_rxSignal.Wait(timeout - elapsed);
+	}
+
+	if (!status)
+		this->RxErrorEvent(this);
+	else
+	{
+		frame.Timestamp = this->ConvertTimestamp(frame.Timestamp);
+		this->CountFrame(frame);
 #ifdef PRINT_DEBUG
 		PrintFrameInfo(frame, "RX");
 #endif
@@ -214,6 +873,27 @@ bool CanBus::Receive(CanBus::Frame& frame) const
 	return status;
 }
 
+bool CanBus::TransmitFor(const Frame& frame, uint32_t timeout) const
+{
+	uint32_t tickStart = HAL_GetTick();
+	while (HAL_FDCAN_GetTxFifoFreeLevel(this->_interface) == 0)
+	{
+		uint32_t elapsed = HAL_GetTick() - tickStart;
+		if (elapsed >= timeout)
+		{
+			ErrorMessage::SetMessage("CanBus: Timeout waiting for free TX FIFO\n");
+			this->TxStartEvent(this);
+			this->TxErrorEvent(this);
+			this->TxEndEvent(this);
+			return false;
+		}
+
+		this->_txSignal.Wait(timeout - elapsed);
+	}
+
+	return this->Transmit(frame);
+}
+
 // Hack to enable comparison of function pointers
 template <typename T, typename... U> size_t getAddress(std::function<T(U...)> f)
 {
@@ -224,82 +904,246 @@ template <typename T, typename... U> size_t getAddress(std::function<T(U...)> f)
 
 bool CanBus::AddRxCallback(Callback callback, const Filter& filter, uint32_t fifo)
 {
-	HAL_FDCAN_Stop(this->_interface);
-	HAL_FDCAN_Init(this->_interface);
+	CanBus::RxCallbackStore store;
+	store.Function = callback;
 
-	FDCAN_FilterTypeDef fdcanFilter;
+	return this->AddRxCallbackStore(store, filter, fifo);
+}
 
-	switch (filter.Type)
+bool CanBus::AddRxPeekCallback(PeekCallback callback, const Filter& filter, uint32_t fifo)
+{
+	CanBus::RxCallbackStore store;
+	store.Peek = callback;
+
+	return this->AddRxCallbackStore(store, filter, fifo);
+}
+
+bool CanBus::AddRxUrgentCallback(Callback callback, const Filter& filter)
+{
+	CanBus::RxCallbackStore store;
+	store.Function = callback;
+	store.Urgent   = true;
+
+	return this->AddRxCallbackStore(store, filter, CanBus::RX_FIFO1);
+}
+
+bool CanBus::AddRtrResponder(const Frame& response, uint32_t fifo, uint32_t& responder)
+{
+	Filter filter;
+	filter.Type       = CanBus::FilterType::ID_MASK;
+	filter.IsExtended = response.IsExtended;
+	filter.Id         = response.Id;
+	filter.Mask       = response.IsExtended ? CanBus::EXT_ID_MASK : CanBus::STD_ID_MASK;
+
+	RtrResponder entry;
+	entry.Response       = response;
+	entry.Response.IsRTR = false;
+	entry.Buffers[0]     = response.Data;
+	entry.Buffers[1]     = response.Data;
+	entry.Active         = 0;
+
+	responder = this->_rtrResponders.size();
+	this->_rtrResponders.push_back(entry);
+
+	// The filter has no callbacks, remote frames it accepts are answered before dispatch
+	RxCallbackStore store;
+	if (!this->AddRxCallbackStore(store, filter, fifo))
 	{
-	case CanBus::FilterType::RANGE:
-		fdcanFilter.FilterType = FDCAN_FILTER_RANGE;
-		fdcanFilter.FilterID1  = filter.Id;
-		fdcanFilter.FilterID2  = filter.Id2;
-		break;
-	case CanBus::FilterType::DUAL:
-		fdcanFilter.FilterType = FDCAN_FILTER_DUAL;
-		fdcanFilter.FilterID1  = filter.Id;
-		fdcanFilter.FilterID2  = filter.Id2;
-		break;
-	case CanBus::FilterType::ID_MASK:
-		fdcanFilter.FilterType = FDCAN_FILTER_MASK;
-		fdcanFilter.FilterID1  = filter.Id;
-		fdcanFilter.FilterID2  = filter.Mask;
-		break;
-	default:
+		this->_rtrResponders.pop_back();
+		return false;
+	}
+
+	return true;
+}
+
+bool CanBus::AddRxCallbackStore(RxCallbackStore& store, const Filter& filter, uint32_t fifo)
+{
+	if (fifo != CanBus::RX_FIFO0 && fifo != CanBus::RX_FIFO1)
+		return false;
+	if (filter.Type != CanBus::FilterType::RANGE && filter.Type != CanBus::FilterType::DUAL && filter.Type != CanBus::FilterType::ID_MASK)
 		return false;
+
+	uint32_t& filterCount = filter.IsExtended ? this->_interface->Init.ExtFiltersNbr : this->_interface->Init.StdFiltersNbr;
+	if (filterCount >= (filter.IsExtended ? 8U : 28U))
+		return false;
+
+	store.Definition   = filter;
+	store.Type         = filter.Type;
+	store.IsExtended   = filter.IsExtended;
+	store.FilterNumber = filterCount;
+
+	// Frames already received can still be dispatched by a pending interrupt, which must not see the list while it reallocates
+	std::vector<CanBus::RxCallbackStore>& callbacks = fifo == CanBus::RX_FIFO0 ? this->_fifo0Callbacks : this->_fifo1Callbacks;
+	HAL_FDCAN_Stop(this->_interface);
+	{
+		CanOs::CriticalSection section;
+		callbacks.push_back(store);
 	}
 
-	int currentFilterIndex = 0;
-	if (!filter.IsExtended)
+	filterCount++;
+	auto configure = [this]()
 	{
-		currentFilterIndex = this->_interface->Init.StdFiltersNbr;
+		if (!InitializeTxSlots(this->_interface, this->_txSlots))
+			return false;
+
+		// Initialization clears message RAM, which also held the filters added before
+		if (!ConfigureFilters(this->_interface, this->_fifo0Callbacks, this->_fifo1Callbacks))
+			return false;
 
-		if (currentFilterIndex >= 28)
+		if (!this->_fifo0Callbacks.empty())
+			HAL_FDCAN_ActivateNotification(this->_interface, FDCAN_IT_RX_FIFO0_NEW_MESSAGE, 0);
+		if (!this->_fifo1Callbacks.empty())
+			HAL_FDCAN_ActivateNotification(this->_interface, FDCAN_IT_RX_FIFO1_NEW_MESSAGE, 0);
+		if (!ConfigureTimestamps(this->_interface, this->_timestampScale))
 			return false;
+#ifndef PSR_CAN_HAL_RX
+		if (HasUrgentCallbacks(this->_fifo1Callbacks) && !ConfigureUrgentPath(this->_interface))
+			return false;
+#endif
+
+		return true;
+	};
+
+	if (!configure())
+	{
+		// The filter is taken back and the controller restarted with the filters it had before
+		{
+			CanOs::CriticalSection section;
+			callbacks.pop_back();
+		}
+		filterCount--;
+
+		configure();
+		HAL_FDCAN_Start(this->_interface);
+		return false;
+	}
+
+	return HAL_FDCAN_Start(this->_interface) == HAL_OK;
+}
 
-		this->_interface->Init.StdFiltersNbr++;
-		HAL_FDCAN_Init(this->_interface);
+static constexpr uint32_t FILTER_STD_SFEC_POS  = 27;
+static constexpr uint32_t FILTER_STD_SFEC_MASK = 0x38000000U; // Standard filter element configuration
+static constexpr uint32_t FILTER_EXT_EFEC_POS  = 29;
+static constexpr uint32_t FILTER_EXT_EFEC_MASK = 0xE0000000U; // Extended filter element configuration
 
-		fdcanFilter.IdType       = FDCAN_STANDARD_ID;
-		fdcanFilter.FilterIndex  = currentFilterIndex;
-		fdcanFilter.FilterConfig = fifo == CanBus::RX_FIFO0 ? FDCAN_FILTER_TO_RXFIFO0_HP : FDCAN_FILTER_TO_RXFIFO1_HP;
+/**
+ * @brief Point a filter element at another FIFO while the controller is running
+ * @remark Only the configuration field of the element changes, a frame being filtered at the same time is stored in either FIFO
+ */
+static void MoveFilter(FDCAN_HandleTypeDef* hfdcan, const CanBus::RxCallbackStore& store, uint32_t fifo)
+{
+	uint32_t config = FilterConfig(store, fifo);
+	if (store.IsExtended)
+	{
+		volatile uint32_t* element = reinterpret_cast<volatile uint32_t*>(hfdcan->msgRam.ExtendedFilterSA + store.FilterNumber * 8);
+		element[0]                 = (element[0] & ~FILTER_EXT_EFEC_MASK) | (config << FILTER_EXT_EFEC_POS);
 	}
 	else
 	{
-		currentFilterIndex = this->_interface->Init.ExtFiltersNbr;
+		volatile uint32_t* element = reinterpret_cast<volatile uint32_t*>(hfdcan->msgRam.StandardFilterSA + store.FilterNumber * 4);
+		element[0]                 = (element[0] & ~FILTER_STD_SFEC_MASK) | (config << FILTER_STD_SFEC_POS);
+	}
+}
 
-		if (currentFilterIndex >= 8)
-			return false;
+void CanBus::SetFifoBalancing(bool enable)
+{
+	if (enable)
+		CanOs::EnableCycleCount();
 
-		this->_interface->Init.ExtFiltersNbr++;
-		HAL_FDCAN_Init(this->_interface);
+	this->_fifoBalancing = enable;
+}
 
-		fdcanFilter.IdType       = FDCAN_EXTENDED_ID;
-		fdcanFilter.FilterIndex  = currentFilterIndex;
-		fdcanFilter.FilterConfig = fifo == CanBus::RX_FIFO0 ? FDCAN_FILTER_TO_RXFIFO0_HP : FDCAN_FILTER_TO_RXFIFO1_HP;
+bool CanBus::RebalanceFifos()
+{
+	if (!this->_fifoBalancing)
+		return false;
+
+	struct Candidate
+	{
+		uint32_t Load;  // Dispatch time plus arrivals since the last rebalance
+		uint32_t List;  // 0 or 1 for the FIFO the filter is in
+		size_t Index;   // Position in the callback list
+		bool Urgent;    // Urgent filters stay in FIFO 1
+		uint32_t Target;
+	};
+
+	size_t total = this->_fifo0Callbacks.size() + this->_fifo1Callbacks.size();
+	std::vector<Candidate> candidates;
+	candidates.reserve(total);
+
+	{
+		CanOs::CriticalSection section;
+		for (uint32_t list = 0; list < 2; list++)
+		{
+			std::vector<RxCallbackStore>& callbacks = list == 0 ? this->_fifo0Callbacks : this->_fifo1Callbacks;
+			for (size_t i = 0; i < callbacks.size(); i++)
+			{
+				RxCallbackStore& store = callbacks[i];
+				candidates.push_back({ store.Cycles + store.Arrivals, list, i, store.Urgent, list });
+
+				// Halving keeps a decaying history, so the assignment follows changes in traffic without reacting to a single burst
+				store.Arrivals /= 2;
+				store.Cycles /= 2;
+			}
+		}
 	}
 
-	if (HAL_FDCAN_ConfigFilter(this->_interface, &fdcanFilter) != HAL_OK)
+	// Longest processing time first: the heaviest filters are placed first, each on the FIFO with the least load so far
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) { return a.Load > b.Load; });
+
+	uint64_t current[2]  = { 0, 0 };
+	uint64_t balanced[2] = { 0, 0 };
+	for (Candidate& candidate : candidates)
+	{
+		current[candidate.List] += candidate.Load;
+		if (candidate.Urgent)
+			balanced[1] += candidate.Load;
+	}
+	for (Candidate& candidate : candidates)
+	{
+		if (candidate.Urgent)
+			continue;
+
+		candidate.Target = balanced[0] <= balanced[1] ? 0 : 1;
+		balanced[candidate.Target] += candidate.Load;
+	}
+
+	// Small gains are within the noise of the measurement and not worth the moves
+	uint64_t currentMax  = std::max(current[0], current[1]);
+	uint64_t balancedMax = std::max(balanced[0], balanced[1]);
+	if (balancedMax * 8 >= currentMax * 7)
 		return false;
 
-	CanBus::RxCallbackStore store;
-	store.Function     = callback;
-	store.Type         = filter.Type;
-	store.IsExtended   = filter.IsExtended;
-	store.FilterNumber = currentFilterIndex;
+	// The new lists keep the original order of the filters and are built before masking interrupts, so nothing is allocated inside it
+	std::vector<uint32_t> targets[2] = { std::vector<uint32_t>(this->_fifo0Callbacks.size()), std::vector<uint32_t>(this->_fifo1Callbacks.size()) };
+	for (const Candidate& candidate : candidates)
+		targets[candidate.List][candidate.Index] = candidate.Target;
 
-	switch (fifo)
+	std::vector<RxCallbackStore> lists[2];
+	lists[0].reserve(total);
+	lists[1].reserve(total);
+	for (uint32_t list = 0; list < 2; list++)
 	{
-	case CanBus::RX_FIFO0:
-		this->_fifo0Callbacks.push_back(store);
-		break;
-	case CanBus::RX_FIFO1:
-		this->_fifo1Callbacks.push_back(store);
-		break;
-	default:
-		return false;
-		break;
+		const std::vector<RxCallbackStore>& callbacks = list == 0 ? this->_fifo0Callbacks : this->_fifo1Callbacks;
+		for (size_t i = 0; i < callbacks.size(); i++)
+			lists[targets[list][i]].push_back(callbacks[i]);
+	}
+
+	{
+		// Frames already stored in the previous FIFO are found in the other list by the receive interrupt
+		CanOs::CriticalSection section;
+		for (uint32_t list = 0; list < 2; list++)
+		{
+			const std::vector<RxCallbackStore>& callbacks = list == 0 ? this->_fifo0Callbacks : this->_fifo1Callbacks;
+			for (size_t i = 0; i < callbacks.size(); i++)
+			{
+				if (targets[list][i] != list)
+					MoveFilter(this->_interface, callbacks[i], targets[list][i] == 0 ? CanBus::RX_FIFO0 : CanBus::RX_FIFO1);
+			}
+		}
+
+		this->_fifo0Callbacks.swap(lists[0]);
+		this->_fifo1Callbacks.swap(lists[1]);
 	}
 
 	if (!this->_fifo0Callbacks.empty())
@@ -307,7 +1151,85 @@ bool CanBus::AddRxCallback(Callback callback, const Filter& filter, uint32_t fif
 	if (!this->_fifo1Callbacks.empty())
 		HAL_FDCAN_ActivateNotification(this->_interface, FDCAN_IT_RX_FIFO1_NEW_MESSAGE, 0);
 
-	return HAL_FDCAN_Start(this->_interface) == HAL_OK;
+	return true;
+}
+
+/**
+ * @brief Check whether a received frame is accepted by the filter of an urgent callback
+ */
+static bool HasUrgentMatch(const std::vector<CanBus::RxCallbackStore>& callbacks, const CanBus::Frame& frame)
+{
+	if (frame.IsRTR)
+		return false;
+
+	for (const CanBus::RxCallbackStore& callback : callbacks)
+	{
+		if (callback.Urgent && callback.FilterNumber == frame.FilterIndex && callback.IsExtended == frame.IsExtended)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Run the callbacks that match a received frame
+ *
+ * @param canbus The bus the frame was received on
+ * @param callbacks The callbacks of the FIFO the frame was received in
+ * @param frame The received frame, the payload is filled in from the element when a deferred callback matches
+ * @param element The element in message RAM, or nullptr if the payload was already copied into the frame
+ * @param runUrgent Whether urgent callbacks are run, they are skipped when the high priority interrupt already ran them
+ * @return CanBus::RxCallbackStore* The callback of the filter that accepted the frame, nullptr if the filter is not in this list
+ */
+static CanBus::RxCallbackStore* DispatchFrame(CanBus* canbus, std::vector<CanBus::RxCallbackStore>& callbacks, CanBus::Frame& frame,
+                                              const volatile uint32_t* element, bool runUrgent)
+{
+	CanBus::RxCallbackStore* matched = nullptr;
+	bool payloadCopied               = element == nullptr;
+	for (auto& callback : callbacks)
+	{
+		if (callback.FilterNumber != frame.FilterIndex || callback.IsExtended != frame.IsExtended)
+			continue;
+
+		matched = &callback;
+
+		// Responder filters have no callbacks, data frames they accept are dropped
+		if (!callback.Function && !callback.Peek)
+			continue;
+
+		// Urgent callbacks run immediately, and only from the path that claimed the element
+		if (callback.Urgent)
+		{
+			if (!runUrgent || !callback.Function)
+				continue;
+
+			if (!payloadCopied)
+			{
+				DecodeRxPayload(element, frame);
+				payloadCopied = true;
+			}
+
+			callback.Function(canbus, frame);
+			continue;
+		}
+
+		if (callback.Peek)
+		{
+			callback.Peek(canbus, frame, element != nullptr ? element + 2 : frame.Data.Words);
+			continue;
+		}
+
+		if (!payloadCopied)
+		{
+			DecodeRxPayload(element, frame);
+			payloadCopied = true;
+		}
+
+		auto function = [canbus, frame, callback]() { callback.Function(canbus, frame); };
+		InterruptQueue::AddInterrupt(function);
+	}
+
+	return matched;
 }
 
 void CanBus::RxCallback(CanBus::Interface* hcan, uint32_t fifo)
@@ -320,39 +1242,107 @@ void CanBus::RxCallback(CanBus::Interface* hcan, uint32_t fifo)
 		if (std::get<1>(it) == hcan)
 		{
 			CanBus* canbus = std::get<0>(it);
+			canbus->_rxSignal.Notify();
+
+			// Frames of FIFOs without callbacks are left for ReceiveFor, unless balancing may have moved their filters to the other FIFO
+			std::vector<CanBus::RxCallbackStore>& callbacks = fifo == CanBus::RX_FIFO0 ? canbus->_fifo0Callbacks : canbus->_fifo1Callbacks;
+			std::vector<CanBus::RxCallbackStore>& others    = fifo == CanBus::RX_FIFO0 ? canbus->_fifo1Callbacks : canbus->_fifo0Callbacks;
+			if (callbacks.empty() && !(canbus->_fifoBalancing && !others.empty()))
+				continue;
+
 			if (canbus->RxStartEvent)
 				canbus->RxStartEvent(canbus);
 
+#ifdef PSR_CAN_HAL_RX
+			uint32_t count = HAL_FDCAN_GetRxFifoFillLevel(hcan, fifo);
+			volatile uint32_t& highWater = canbus->_fifoHighWater[fifo == CanBus::RX_FIFO0 ? 0 : 1];
+			if (count > highWater)
+				highWater = count;
+
 			CanBus::Frame frame;
-			if (TranslateNextFrame(hcan, frame, fifo))
+			bool received = TranslateNextFrame(hcan, frame, fifo);
+			if (received)
+			{
+				frame.Timestamp = canbus->ConvertTimestamp(frame.Timestamp);
+				canbus->CountFrame(frame);
+#ifdef PRINT_DEBUG
+				PrintFrameInfo(frame, "RX");
+#endif
+				// Remote frames are only accepted for responders and never reach the callbacks
+				if (frame.IsRTR)
+					canbus->RespondRemote(frame);
+				else if (DispatchFrame(canbus, callbacks, frame, nullptr, true) == nullptr)
+					DispatchFrame(canbus, others, frame, nullptr, false);
+			}
+#else
+			// Drain every pending element and release them with a single acknowledge
+			uint32_t status = RxFifoStatus(hcan, fifo);
+			uint32_t count  = (status & FDCAN_RXF0S_F0FL) >> FDCAN_RXF0S_F0FL_Pos;
+			uint32_t index  = (status & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos;
+			uint32_t depth  = RxFifoDepth(hcan, fifo);
+			bool received   = count != 0;
+
+			volatile uint32_t& highWater = canbus->_fifoHighWater[fifo == CanBus::RX_FIFO0 ? 0 : 1];
+			if (count > highWater)
+				highWater = count;
+
+			uint64_t processed = 0;
+			for (uint32_t i = 0; i < count; i++)
 			{
+				const volatile uint32_t* element = RxFifoElement(hcan, fifo, index);
+
+				// The payload is copied for the bus load estimate, DispatchFrame copies it again only for deferred callbacks
+				CanBus::Frame frame;
+				DecodeRxHeader(element, frame);
+				DecodeRxPayload(element, frame);
+				frame.Timestamp = canbus->ConvertTimestamp(frame.Timestamp);
+				canbus->CountFrame(frame);
 #ifdef PRINT_DEBUG
 				PrintFrameInfo(frame, "RX");
 #endif
-				if (fifo == CanBus::RX_FIFO0)
+				if (frame.IsRTR)
 				{
-					for (auto& callback : canbus->_fifo0Callbacks)
-					{
-						if (callback.FilterNumber == frame.FilterIndex && callback.IsExtended == frame.IsExtended)
-						{
-							auto function = [canbus, frame, callback]() { callback.Function(canbus, frame); };
-							InterruptQueue::AddInterrupt(function);
-						}
-					}
+					// Remote frames are only accepted for responders and never reach the callbacks
+					canbus->RespondRemote(frame);
 				}
-				else if (fifo == CanBus::RX_FIFO1)
+				else
 				{
-					for (auto& callback : canbus->_fifo1Callbacks)
+					// Urgent frames are normally claimed first by the high priority interrupt, this only catches the ones it missed
+					bool runUrgent = fifo == CanBus::RX_FIFO1 && HasUrgentMatch(callbacks, frame) && canbus->ClaimUrgent(index);
+					if (runUrgent)
+						canbus->RecordUrgentLatency(element);
+
+					uint32_t start = canbus->_fifoBalancing ? CanOs::CycleCount() : 0;
+
+					// Frames stored before RebalanceFifos moved their filter belong to the other list, urgent filters are never moved
+					CanBus::RxCallbackStore* store = DispatchFrame(canbus, callbacks, frame, element, runUrgent);
+					if (store == nullptr && canbus->_fifoBalancing)
+						store = DispatchFrame(canbus, others, frame, element, false);
+
+					if (store != nullptr && canbus->_fifoBalancing)
 					{
-						if (callback.FilterNumber == frame.FilterIndex && callback.IsExtended == frame.IsExtended)
-						{
-							auto function = [canbus, frame, callback]() { callback.Function(canbus, frame); };
-							InterruptQueue::AddInterrupt(function);
-						}
+						store->Arrivals++;
+						store->Cycles += CanOs::CycleCount() - start;
 					}
 				}
+
+				processed |= 1ULL << index;
+
+				if (i + 1 < count)
+					index = index + 1 == depth ? 0 : index + 1;
+			}
+
+			if (received)
+			{
+				// Claims are released together with the elements, so a claim never refers to a reused element
+				CanOs::CriticalSection section;
+				AcknowledgeRxFifo(hcan, fifo, index);
+				if (fifo == CanBus::RX_FIFO1)
+					canbus->_urgentClaimed = canbus->_urgentClaimed & ~processed;
 			}
-			else
+#endif
+
+			if (!received)
 			{
 #ifdef PRINT_DEBUG
 				printf("CAN RX Error.\n");
@@ -367,6 +1357,163 @@ void CanBus::RxCallback(CanBus::Interface* hcan, uint32_t fifo)
 	}
 }
 
+bool CanBus::ClaimUrgent(uint32_t index)
+{
+	// The high priority interrupt and the FIFO 1 interrupt may both see an element, only the first to claim it runs the urgent callbacks
+	CanOs::CriticalSection section;
+
+	uint64_t bit = 1ULL << index;
+	if ((this->_urgentClaimed & bit) != 0)
+		return false;
+
+	this->_urgentClaimed = this->_urgentClaimed | bit;
+	return true;
+}
+
+void CanBus::RecordUrgentLatency(const volatile uint32_t* element)
+{
+	uint32_t latency = (this->_interface->Instance->TSCV - element[1]) & ELEMENT_MASK_RXTS;
+	if (latency > this->_urgentWorstLatency)
+		this->_urgentWorstLatency = latency;
+}
+
+void CanBus::HighPriorityCallback(FDCAN_HandleTypeDef* hfdcan)
+{
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+	{
+		if (std::get<1>(it) != hfdcan)
+			continue;
+
+		CanBus* canbus = std::get<0>(it);
+
+		// A message storage indicator of 1 reports a high priority frame that was discarded by a full FIFO
+		uint32_t storage = (hfdcan->Instance->HPMS & FDCAN_HPMS_MSI) >> FDCAN_HPMS_MSI_Pos;
+		if (storage == 1)
+			canbus->_urgentLost = canbus->_urgentLost + 1;
+
+		// The status register only holds the latest frame, so every element in FIFO 1 is checked in case several arrived together
+		uint32_t status = RxFifoStatus(hfdcan, CanBus::RX_FIFO1);
+		uint32_t count  = (status & FDCAN_RXF0S_F0FL) >> FDCAN_RXF0S_F0FL_Pos;
+		uint32_t index  = (status & FDCAN_RXF0S_F0GI) >> FDCAN_RXF0S_F0GI_Pos;
+		uint32_t depth  = RxFifoDepth(hfdcan, CanBus::RX_FIFO1);
+
+		for (uint32_t i = 0; i < count; i++, index = index + 1 == depth ? 0 : index + 1)
+		{
+			const volatile uint32_t* element = RxFifoElement(hfdcan, CanBus::RX_FIFO1, index);
+
+			CanBus::Frame frame;
+			DecodeRxHeader(element, frame);
+			if (!HasUrgentMatch(canbus->_fifo1Callbacks, frame) || !canbus->ClaimUrgent(index))
+				continue;
+
+			canbus->RecordUrgentLatency(element);
+			DecodeRxPayload(element, frame);
+			frame.Timestamp = canbus->ConvertTimestamp(frame.Timestamp);
+
+			// The element is released by the FIFO 1 interrupt, which skips the urgent callbacks run here
+			for (auto& callback : canbus->_fifo1Callbacks)
+			{
+				if (callback.Urgent && callback.Function && callback.FilterNumber == frame.FilterIndex && callback.IsExtended == frame.IsExtended)
+					callback.Function(canbus, frame);
+			}
+		}
+	}
+}
+
+void CanBus::UrgentIrqHandler(FDCAN_HandleTypeDef* hfdcan)
+{
+	// The flags are cleared before the callbacks so a frame arriving while they run raises the interrupt again
+	FDCAN_GlobalTypeDef* fdcan = hfdcan->Instance;
+	if ((fdcan->IR & fdcan->IE & FDCAN_IR_HPM) != 0)
+	{
+		fdcan->IR = FDCAN_IR_HPM;
+		HighPriorityCallback(hfdcan);
+	}
+
+#if defined(FDCAN_IT_GROUP_SMSG)
+	// The line is selected per group here, transmit complete and cancellation finished are routed with the high priority message flag
+	if ((fdcan->ILS & FDCAN_IT_GROUP_SMSG) == 0)
+		return;
+
+	if ((fdcan->IR & fdcan->IE & FDCAN_IR_TC) != 0)
+	{
+		uint32_t buffers = fdcan->TXBTO & fdcan->TXBTIE;
+		fdcan->IR        = FDCAN_IR_TC;
+		TxCompleteCallback(hfdcan, buffers);
+	}
+	if ((fdcan->IR & fdcan->IE & FDCAN_IR_TCF) != 0)
+	{
+		uint32_t buffers = fdcan->TXBCF & fdcan->TXBCIE;
+		fdcan->IR        = FDCAN_IR_TCF;
+		TxAbortCallback(hfdcan, buffers);
+	}
+#endif
+}
+
+uint64_t CanBus::ReadTimestampCounter() const
+{
+	FDCAN_GlobalTypeDef* fdcan = this->_interface->Instance;
+
+	CanOs::CriticalSection section;
+	while (true)
+	{
+		// A wrap that is flagged but not yet counted happened before the second read, unless the counter wrapped between the reads
+		uint32_t before  = fdcan->TSCV & FDCAN_TSCV_TSC;
+		bool pending     = (fdcan->IR & FDCAN_IR_TSW) != 0;
+		uint32_t counter = fdcan->TSCV & FDCAN_TSCV_TSC;
+		if (counter < before)
+			continue;
+
+		uint64_t wraps = this->_timestampWraps + (pending ? 1 : 0);
+		return wraps << 16 | counter;
+	}
+}
+
+uint32_t CanBus::ConvertTimestamp(uint32_t captured) const
+{
+	// The capture is placed relative to the running counter, so frames must be read within 65536 bit times of their start
+	uint64_t now     = this->ReadTimestampCounter();
+	uint64_t elapsed = ((uint32_t)now - captured) & FDCAN_TSCV_TSC;
+
+	// Only the low 32 bits of the product are kept, which wrap together with the microsecond result
+	return (uint32_t)(((now - elapsed) * this->_timestampScale) >> 16);
+}
+
+uint32_t CanBus::GetTimestamp() const
+{
+	return (uint32_t)((this->ReadTimestampCounter() * this->_timestampScale) >> 16);
+}
+
+CanBus::ErrorState CanBus::ReadErrorState(uint8_t& txErrors, uint8_t& rxErrors) const
+{
+	FDCAN_GlobalTypeDef* fdcan = this->_interface->Instance;
+	uint32_t ecr               = fdcan->ECR;
+	uint32_t psr               = fdcan->PSR;
+	txErrors                   = (ecr & FDCAN_ECR_TEC) >> FDCAN_ECR_TEC_Pos;
+	rxErrors                   = (ecr & FDCAN_ECR_REC) >> FDCAN_ECR_REC_Pos;
+
+	if ((psr & FDCAN_PSR_BO) != 0)
+		return ErrorState::BusOff;
+	if ((psr & FDCAN_PSR_EP) != 0)
+		return ErrorState::Passive;
+	if ((psr & FDCAN_PSR_EW) != 0)
+		return ErrorState::Warning;
+
+	return ErrorState::Active;
+}
+
+bool CanBus::RecoverBusOff()
+{
+	// Bus-off sets INIT, clearing it starts the recovery sequence with the configuration and message RAM left intact
+	FDCAN_GlobalTypeDef* fdcan = this->_interface->Instance;
+	if ((fdcan->PSR & FDCAN_PSR_BO) == 0)
+		return false;
+
+	this->_health.Recoveries = this->_health.Recoveries + 1;
+	fdcan->CCCR &= ~FDCAN_CCCR_INIT;
+	return true;
+}
+
 void CanBus::RxCallbackFifo0(FDCAN_HandleTypeDef* hfdcan, uint32_t rxFifo0ITs)
 {
 	RxCallback(hfdcan, CanBus::RX_FIFO0);
@@ -377,6 +1524,93 @@ void CanBus::RxCallbackFifo1(FDCAN_HandleTypeDef* hfdcan, uint32_t rxFifo1ITs)
 	RxCallback(hfdcan, CanBus::RX_FIFO1);
 }
 
+void CanBus::TxCompleteCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t bufferIndexes)
+{
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+	{
+		if (std::get<1>(it) == hfdcan)
+		{
+			CanBus* canbus         = std::get<0>(it);
+			canbus->_txDeadlineMask = canbus->_txDeadlineMask & ~bufferIndexes;
+			canbus->_txSignal.Notify();
+
+			// Several buffers can complete before the interrupt is serviced, the event is raised once per frame
+			for (; bufferIndexes != 0 && canbus->TxCompleteEvent; bufferIndexes &= bufferIndexes - 1)
+				canbus->TxCompleteEvent(canbus);
+		}
+	}
+}
+
+void CanBus::TxEventCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t txEventFifoITs)
+{
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+	{
+		if (std::get<1>(it) != hfdcan)
+			continue;
+
+		CanBus* canbus = std::get<0>(it);
+		while ((hfdcan->Instance->TXEFS & FDCAN_TXEFS_EFFL) != 0)
+		{
+			FDCAN_TxEventFifoTypeDef event;
+			if (HAL_FDCAN_GetTxEvent(hfdcan, &event) != HAL_OK)
+				break;
+
+			CanBus::Frame frame;
+			frame.IsExtended = event.IdType == FDCAN_EXTENDED_ID;
+			frame.Id         = event.Identifier & (frame.IsExtended ? CanBus::EXT_ID_MASK : CanBus::STD_ID_MASK);
+			frame.IsRTR      = event.TxFrameType == FDCAN_REMOTE_FRAME;
+			frame.Length     = event.DataLength;
+			frame.Timestamp  = canbus->ConvertTimestamp(event.TxTimestamp);
+
+			if (canbus->TxTimestampEvent)
+				canbus->TxTimestampEvent(canbus, frame);
+		}
+	}
+}
+
+void CanBus::TxAbortCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t bufferIndexes)
+{
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+	{
+		if (std::get<1>(it) == hfdcan)
+		{
+			// A cancellation also finishes when the frame was already being sent, the controller then reports it as transmitted
+			CanBus* canbus = std::get<0>(it);
+			canbus->NoteTxCancelled(bufferIndexes, bufferIndexes & ~hfdcan->Instance->TXBTO);
+			canbus->_txSignal.Notify();
+		}
+	}
+}
+
+void CanBus::TimestampWraparoundCallback(FDCAN_HandleTypeDef* hfdcan)
+{
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+	{
+		if (std::get<1>(it) == hfdcan)
+		{
+			CanBus* canbus          = std::get<0>(it);
+			canbus->_timestampWraps = canbus->_timestampWraps + 1;
+		}
+	}
+}
+
+void CanBus::ErrorStatusCallback(FDCAN_HandleTypeDef* hfdcan, uint32_t errorStatusITs)
+{
+	if ((errorStatusITs & FDCAN_IT_BUS_OFF) == 0)
+		return;
+
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+	{
+		if (std::get<1>(it) == hfdcan)
+		{
+			// Only bus-off is acted on here, the counters and the other states are read by UpdateHealth
+			CanBus* canbus = std::get<0>(it);
+			if ((hfdcan->Instance->PSR & FDCAN_PSR_BO) != 0)
+				canbus->NoteBusOff();
+		}
+	}
+}
+
 } // namespace PSR
 
 #endif
@@ -0,0 +1,803 @@
+/**
+ * @file can_lib_sim.cpp
+ * @author Purdue Solar Racing
+ * @brief Simulated bus implementation file
+ * @version 2.1
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_lib.hpp"
+
+#if PSR_CAN_MODE == 4
+
+#include "can_sim.hpp"
+
+#ifdef PRINT_DEBUG
+#include <cstdio>
+#endif
+
+namespace PSR
+{
+
+/* Simulated controller */
+
+CanSimController::CanSimController(const char* name, uint32_t rxDepth)
+	: RxFifoCallback(nullptr), TxCompleteCallback(nullptr), TxTimestampCallback(nullptr), TxAbortCallback(nullptr), Name(name), Bus(nullptr), RxDepth(rxDepth),
+	  Loopback(false), TxErrors(0), RxErrors(0), ClockOffset(0), ClockDrift(0), Mailboxes(), Fifos(), StdFilters(), ExtFilters()
+{
+	if (this->RxDepth == 0)
+		this->RxDepth = 1;
+	if (this->RxDepth > MAX_RX_DEPTH)
+		this->RxDepth = MAX_RX_DEPTH;
+}
+
+bool CanSimController::AddFilter(const CanBus::Filter& filter, uint32_t fifo, bool remote, uint32_t& index)
+{
+	std::vector<FilterElement>& filters = filter.IsExtended ? this->ExtFilters : this->StdFilters;
+	if (filters.size() >= (filter.IsExtended ? MAX_EXT_FILTERS : MAX_STD_FILTERS) || fifo > CanBus::RX_FIFO1)
+		return false;
+
+	index = filters.size();
+	filters.push_back({ filter, fifo, remote });
+	return true;
+}
+
+uint32_t CanSimController::FreeMailboxes() const
+{
+	uint32_t free = 0;
+	for (const Mailbox& mailbox : this->Mailboxes)
+		free += mailbox.Pending ? 0 : 1;
+
+	return free;
+}
+
+bool CanSimController::Queue(const CanBus::Frame& frame, bool timestamped, uint64_t deadline)
+{
+	for (Mailbox& mailbox : this->Mailboxes)
+	{
+		if (mailbox.Pending)
+			continue;
+
+		mailbox.Frame       = frame;
+		mailbox.Queued      = CanSimBus::Now();
+		mailbox.Deadline    = deadline;
+		mailbox.Pending     = true;
+		mailbox.Timestamped = timestamped;
+		return true;
+	}
+
+	return false;
+}
+
+bool CanSimController::Replace(const CanBus::Frame& frame)
+{
+	uint32_t mask = frame.IsExtended ? CanBus::EXT_ID_MASK : CanBus::STD_ID_MASK;
+	for (Mailbox& mailbox : this->Mailboxes)
+	{
+		const CanBus::Frame& pending = mailbox.Frame;
+		if (!mailbox.Pending || pending.IsExtended != frame.IsExtended || pending.IsRTR != frame.IsRTR || (pending.Id & mask) != (frame.Id & mask))
+			continue;
+
+		mailbox.Frame       = frame;
+		mailbox.Queued      = CanSimBus::Now();
+		mailbox.Deadline    = 0;
+		mailbox.Timestamped = false;
+		return true;
+	}
+
+	return false;
+}
+
+uint32_t CanSimController::ExpireMailboxes()
+{
+	uint32_t expired = 0;
+	for (Mailbox& mailbox : this->Mailboxes)
+	{
+		if (!mailbox.Pending || mailbox.Deadline == 0 || CanSimBus::Now() < mailbox.Deadline)
+			continue;
+
+		mailbox.Pending = false;
+		expired++;
+		if (this->TxAbortCallback != nullptr)
+			this->TxAbortCallback(this);
+	}
+
+	return expired;
+}
+
+bool CanSimController::Accept(const CanBus::Frame& frame)
+{
+	// Elements are checked in index order and the first match decides, like the FDCAN filter list
+	const std::vector<FilterElement>& filters = frame.IsExtended ? this->ExtFilters : this->StdFilters;
+	for (uint32_t index = 0; index < filters.size(); index++)
+	{
+		const FilterElement& element = filters[index];
+		if (element.Remote == frame.IsRTR && element.Definition.Matches(frame.Id, frame.IsExtended))
+			return this->Store(frame, element.Fifo, index);
+	}
+
+	return false;
+}
+
+bool CanSimController::Store(const CanBus::Frame& frame, uint32_t fifo, uint32_t filterIndex)
+{
+	if (fifo > CanBus::RX_FIFO1)
+		return false;
+
+	RxFifo& rx = this->Fifos[fifo];
+	if (rx.Count == this->RxDepth)
+	{
+		rx.Overruns++;
+		return false;
+	}
+
+	CanBus::Frame& element  = rx.Elements[(rx.Head + rx.Count) % this->RxDepth];
+	element                 = frame;
+	element.IsFilterMatched = true;
+	element.FilterIndex     = filterIndex;
+
+	rx.Count++;
+	if (rx.Count > rx.HighWater)
+		rx.HighWater = rx.Count;
+
+	if (this->RxFifoCallback != nullptr)
+		this->RxFifoCallback(this, fifo);
+
+	return true;
+}
+
+bool CanSimController::Pop(uint32_t fifo, CanBus::Frame& frame)
+{
+	if (fifo > CanBus::RX_FIFO1)
+		return false;
+
+	RxFifo& rx = this->Fifos[fifo];
+	if (rx.Count == 0)
+		return false;
+
+	frame   = rx.Elements[rx.Head];
+	rx.Head = (rx.Head + 1) % this->RxDepth;
+	rx.Count--;
+	return true;
+}
+
+/* Simulated bus */
+
+uint64_t CanSimBus::_now = 0;
+
+CanSimBus::CanSimBus(uint32_t bitrate)
+	: _bitrate(bitrate), _bitTime(1000000000ULL / (bitrate != 0 ? bitrate : 1)), _controllers(), _statistics(), _stepping(false), Sent()
+{
+	this->ResetStatistics();
+}
+
+void CanSimBus::Attach(CanSimController& controller)
+{
+	controller.Bus = this;
+	this->_controllers.push_back(&controller);
+}
+
+uint32_t CanSimBus::ArbitrationValue(const CanBus::Frame& frame)
+{
+	// The base identifier is compared first, then a standard frame wins over an extended one, then a data frame over a remote one
+	uint32_t value;
+	if (frame.IsExtended)
+		value = (((frame.Id >> 18) & CanBus::STD_ID_MASK) << 19) | (1U << 18) | (frame.Id & 0x3FFFF);
+	else
+		value = (frame.Id & CanBus::STD_ID_MASK) << 19;
+
+	return (value << 1) | (frame.IsRTR ? 1 : 0);
+}
+
+uint32_t CanSimBus::FrameBits(const CanBus::Frame& frame)
+{
+	// Bits from the start of frame to the end of the CRC, the part of the frame that is bit stuffed
+	uint8_t bits[160];
+	uint32_t count = 0;
+	auto append    = [&bits, &count](uint32_t value, uint32_t width)
+	{
+		for (uint32_t i = width; i > 0; i--)
+			bits[count++] = (value >> (i - 1)) & 1;
+	};
+
+	uint32_t length = frame.Length > 8 ? 8 : frame.Length;
+
+	append(0, 1); // Start of frame
+	if (frame.IsExtended)
+	{
+		append(frame.Id >> 18, 11);
+		append(1, 1); // Substitute remote request
+		append(1, 1); // Identifier extension
+		append(frame.Id & 0x3FFFF, 18);
+		append(frame.IsRTR ? 1 : 0, 1);
+		append(0, 2); // Reserved bits
+	}
+	else
+	{
+		append(frame.Id & CanBus::STD_ID_MASK, 11);
+		append(frame.IsRTR ? 1 : 0, 1);
+		append(0, 2); // Identifier extension and reserved bit
+	}
+	append(frame.Length, 4);
+
+	if (!frame.IsRTR)
+	{
+		for (uint32_t i = 0; i < length; i++)
+			append(frame.Data.Bytes[i], 8);
+	}
+
+	uint32_t crc = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint32_t next = bits[i] ^ ((crc >> 14) & 1);
+		crc           = (crc << 1) & 0x7FFF;
+		if (next)
+			crc ^= 0x4599;
+	}
+	append(crc, 15);
+
+	// A stuff bit follows every five equal bits and starts the next run itself
+	uint32_t stuffed = 0;
+	uint32_t run     = 1;
+	uint8_t previous = bits[0];
+	for (uint32_t i = 1; i < count; i++)
+	{
+		if (bits[i] == previous)
+		{
+			run++;
+		}
+		else
+		{
+			previous = bits[i];
+			run      = 1;
+		}
+
+		if (run == 5)
+		{
+			stuffed++;
+			previous = !previous;
+			run      = 1;
+		}
+	}
+
+	// CRC delimiter, acknowledge slot and delimiter, end of frame and interframe space
+	return count + stuffed + 1 + 2 + 7 + 3;
+}
+
+bool CanSimBus::Step()
+{
+	if (this->_stepping)
+		return false;
+
+	// Frames that can no longer start in time are dropped before arbitration
+	this->_stepping = true;
+	for (CanSimController* controller : this->_controllers)
+		controller->ExpireMailboxes();
+	this->_stepping = false;
+
+	// Every controller offers its pending mailboxes and the lowest arbitration value on the bus wins, ties go to the first attached
+	CanSimController* sender           = nullptr;
+	CanSimController::Mailbox* mailbox = nullptr;
+	uint32_t best                      = 0;
+	for (CanSimController* controller : this->_controllers)
+	{
+		if (controller->TxErrors > 255)
+			continue;
+
+		for (CanSimController::Mailbox& candidate : controller->Mailboxes)
+		{
+			if (!candidate.Pending)
+				continue;
+
+			uint32_t value = ArbitrationValue(candidate.Frame);
+			if (mailbox == nullptr || value < best)
+			{
+				sender  = controller;
+				mailbox = &candidate;
+				best    = value;
+			}
+		}
+	}
+
+	if (mailbox == nullptr)
+		return false;
+
+	this->_stepping = true;
+
+	CanBus::Frame frame = mailbox->Frame;
+	uint64_t queued     = mailbox->Queued;
+	bool timestamped    = mailbox->Timestamped;
+	mailbox->Pending    = false;
+
+	uint32_t bits = FrameBits(frame);
+	uint64_t start = _now;
+	_now += bits * this->_bitTime;
+
+	this->_statistics.Frames++;
+	this->_statistics.Bits += bits;
+	this->_statistics.BusyTime += bits * this->_bitTime;
+
+	// Every controller stamps the start of frame with its own clock
+	for (CanSimController* controller : this->_controllers)
+	{
+		frame.Timestamp = (uint32_t)(controller->LocalTime(start) / 1000);
+		if ((controller != sender || controller->Loopback) && controller->TxErrors <= 255)
+			controller->Accept(frame);
+	}
+
+	frame.Timestamp = (uint32_t)(sender->LocalTime(start) / 1000);
+	if (sender->TxCompleteCallback != nullptr)
+		sender->TxCompleteCallback(sender);
+	if (timestamped && sender->TxTimestampCallback != nullptr)
+		sender->TxTimestampCallback(sender, frame);
+
+	if (this->Sent)
+		this->Sent(*sender, frame, queued, start, _now);
+
+	this->_stepping = false;
+	return true;
+}
+
+void CanSimBus::RunUntil(uint64_t until)
+{
+	while (_now < until)
+	{
+		if (!this->Step())
+			_now = until;
+	}
+}
+
+double CanSimBus::GetLoad() const
+{
+	uint64_t elapsed = _now - this->_statistics.Since;
+	if (elapsed == 0)
+		return 0;
+
+	return (double)this->_statistics.BusyTime / (double)elapsed;
+}
+
+void CanSimBus::ResetStatistics()
+{
+	this->_statistics.Frames   = 0;
+	this->_statistics.Bits     = 0;
+	this->_statistics.BusyTime = 0;
+	this->_statistics.Since    = _now;
+}
+
+/* CanBus backend */
+
+std::vector<std::tuple<CanBus*, CanBus::Interface*>> CanBus::RegisteredInterfaces = std::vector<std::tuple<CanBus*, CanBus::Interface*>>();
+
+CanBus::CanBus(CanBus::Interface* interface)
+	: _interface(interface), _fifo0Callbacks(), _fifo1Callbacks(), _rtrResponders(), _rtrMissed(0), _health(), _urgentWorstLatency(0)
+{
+	interface->RxFifoCallback      = CanBus::RxCallback;
+	interface->TxCompleteCallback  = CanBus::TxCompleteCallback;
+	interface->TxTimestampCallback = CanBus::TxTimestampCallback;
+	interface->TxAbortCallback     = CanBus::TxAbortCallback;
+}
+
+uint32_t CanBus::GetTick()
+{
+	return (uint32_t)(CanSimBus::Now() / 1000000);
+}
+
+bool CanBus::Init()
+{
+	bool found = false;
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : RegisteredInterfaces)
+	{
+		if (std::get<0>(it) == this)
+		{
+			found = true;
+			break;
+		}
+	}
+
+	if (!found)
+	{
+		RegisteredInterfaces.push_back(std::make_tuple(this, this->_interface));
+	}
+
+	this->_interface->RxFifoCallback      = CanBus::RxCallback;
+	this->_interface->TxCompleteCallback  = CanBus::TxCompleteCallback;
+	this->_interface->TxTimestampCallback = CanBus::TxTimestampCallback;
+	this->_interface->TxAbortCallback     = CanBus::TxAbortCallback;
+
+	return this->_interface->Bus != nullptr;
+}
+
+bool CanBus::Transmit(const Frame& frame) const
+{
+	this->TxStartEvent(this);
+
+	// The simulation only advances when stepped, so waiting for a free mailbox runs the bus instead of spinning
+	while (this->_interface->FreeMailboxes() == 0)
+	{
+		if (this->_interface->Bus == nullptr || !this->_interface->Bus->Step())
+			break;
+	}
+
+	bool status = !this->Throttle(frame) && this->_interface->Queue(frame);
+	if (status)
+		this->CountFrame(frame);
+	else
+		this->TxErrorEvent(this);
+
+	this->TxEndEvent(this);
+	return status;
+}
+
+bool CanBus::TryTransmit(const Frame& frame) const
+{
+	this->TxStartEvent(this);
+
+	bool status = !this->Throttle(frame) && this->_interface->Queue(frame);
+	if (status)
+		this->CountFrame(frame);
+	else
+		this->TxErrorEvent(this);
+
+	this->TxEndEvent(this);
+	return status;
+}
+
+bool CanBus::TransmitTimestamped(const Frame& frame) const
+{
+	this->TxStartEvent(this);
+
+	while (this->_interface->FreeMailboxes() == 0)
+	{
+		if (this->_interface->Bus == nullptr || !this->_interface->Bus->Step())
+			break;
+	}
+
+	bool status = !this->Throttle(frame) && this->_interface->Queue(frame, true);
+	if (status)
+		this->CountFrame(frame);
+	else
+		this->TxErrorEvent(this);
+
+	this->TxEndEvent(this);
+	return status;
+}
+
+bool CanBus::Transmit(const Frame& frame, TxPolicy policy, uint32_t deadline) const
+{
+	this->TxStartEvent(this);
+
+	// Ticks are whole milliseconds of the simulated clock
+	uint64_t expiry = 0;
+	if (policy == TxPolicy::Deadline)
+	{
+		int32_t remaining = (int32_t)(deadline - GetTick());
+		if (remaining <= 0)
+		{
+			this->_health.Expired = this->_health.Expired + 1;
+			this->TxErrorEvent(this);
+			this->TxEndEvent(this);
+			return false;
+		}
+
+		expiry = CanSimBus::Now() - CanSimBus::Now() % 1000000 + (uint64_t)remaining * 1000000;
+	}
+
+	bool status = !this->Throttle(frame);
+	if (status && policy == TxPolicy::Supersede && this->_interface->Replace(frame))
+	{
+		this->_health.Superseded = this->_health.Superseded + 1;
+		this->TxEndEvent(this);
+		return true;
+	}
+
+	while (status && this->_interface->FreeMailboxes() == 0)
+	{
+		if (this->_interface->Bus == nullptr || !this->_interface->Bus->Step())
+			break;
+	}
+
+	status = status && this->_interface->Queue(frame, false, expiry);
+	if (status)
+		this->CountFrame(frame);
+	else
+		this->TxErrorEvent(this);
+
+	this->TxEndEvent(this);
+	return status;
+}
+
+void CanBus::ExpireTxFrames() const
+{
+	this->_interface->ExpireMailboxes();
+}
+
+uint32_t CanBus::GetTimestamp() const
+{
+	return (uint32_t)(this->_interface->LocalTime(CanSimBus::Now()) / 1000);
+}
+
+bool CanBus::TransmitFor(const Frame& frame, uint32_t timeout) const
+{
+	uint64_t deadline = CanSimBus::Now() + (uint64_t)timeout * 1000000;
+	while (this->_interface->FreeMailboxes() == 0 && CanSimBus::Now() < deadline)
+	{
+		if (this->_interface->Bus == nullptr || !this->_interface->Bus->Step())
+			break;
+	}
+
+	// The error is reported inside its own start and end events, like every other failed transmission
+	if (this->_interface->FreeMailboxes() == 0)
+	{
+		this->TxStartEvent(this);
+		this->TxErrorEvent(this);
+		this->TxEndEvent(this);
+		return false;
+	}
+
+	return this->Transmit(frame);
+}
+
+/**
+ * @brief Try to receive a frame from the controller and update a reference to a frame
+ *
+ * @param controller The simulated controller
+ * @param frame The frame to be updated with the received frame
+ * @param fifo The number of the FIFO buffer to receive from
+ * @return bool Whether there was a frame available
+ */
+static bool TranslateNextFrame(CanSimController* controller, CanBus::Frame& frame, uint32_t fifo)
+{
+	return controller->Pop(fifo, frame);
+}
+
+bool CanBus::Receive(CanBus::Frame& frame) const
+{
+	this->RxStartEvent(this);
+
+	bool status = TranslateNextFrame(this->_interface, frame, CanBus::RX_FIFO0) || TranslateNextFrame(this->_interface, frame, CanBus::RX_FIFO1);
+	if (status)
+		this->CountFrame(frame);
+	else
+		this->RxErrorEvent(this);
+
+	this->RxEndEvent(this);
+	return status;
+}
+
+bool CanBus::ReceiveFor(CanBus::Frame& frame, uint32_t timeout) const
+{
+	this->RxStartEvent(this);
+
+	bool status       = false;
+	uint64_t deadline = CanSimBus::Now() + (uint64_t)timeout * 1000000;
+	while (true)
+	{
+		status = TranslateNextFrame(this->_interface, frame, CanBus::RX_FIFO0) || TranslateNextFrame(this->_interface, frame, CanBus::RX_FIFO1);
+		if (status || CanSimBus::Now() >= deadline)
+			break;
+
+		// Nothing else runs in the simulation, so an idle bus stays idle until the timeout
+		if (this->_interface->Bus == nullptr || !this->_interface->Bus->Step())
+			CanSimBus::Advance(deadline - CanSimBus::Now());
+	}
+
+	if (status)
+		this->CountFrame(frame);
+	else
+		this->RxErrorEvent(this);
+
+	this->RxEndEvent(this);
+	return status;
+}
+
+bool CanBus::AddRxCallback(Callback callback, const Filter& filter, uint32_t fifo)
+{
+	if (fifo != CanBus::RX_FIFO0 && fifo != CanBus::RX_FIFO1)
+		return false;
+	if (filter.Type != CanBus::FilterType::RANGE && filter.Type != CanBus::FilterType::DUAL && filter.Type != CanBus::FilterType::ID_MASK)
+		return false;
+
+	uint32_t index;
+	if (!this->_interface->AddFilter(filter, fifo, false, index))
+		return false;
+
+	CanBus::RxCallbackStore store;
+	store.Function     = callback;
+	store.Type         = filter.Type;
+	store.IsExtended   = filter.IsExtended;
+	store.FilterNumber = index;
+	store.Definition   = filter;
+
+	if (fifo == CanBus::RX_FIFO0)
+		this->_fifo0Callbacks.push_back(store);
+	else
+		this->_fifo1Callbacks.push_back(store);
+
+	return true;
+}
+
+bool CanBus::AddRxUrgentCallback(Callback callback, const Filter& filter)
+{
+	if (!this->AddRxCallback(callback, filter, CanBus::RX_FIFO1))
+		return false;
+
+	this->_fifo1Callbacks.back().Urgent = true;
+	return true;
+}
+
+bool CanBus::AddRtrResponder(const Frame& response, uint32_t fifo, uint32_t& responder)
+{
+	if (fifo != CanBus::RX_FIFO0 && fifo != CanBus::RX_FIFO1)
+		return false;
+
+	Filter filter;
+	filter.Type       = CanBus::FilterType::ID_MASK;
+	filter.IsExtended = response.IsExtended;
+	filter.Id         = response.Id;
+	filter.Mask       = response.IsExtended ? CanBus::EXT_ID_MASK : CanBus::STD_ID_MASK;
+
+	uint32_t index;
+	if (!this->_interface->AddFilter(filter, fifo, true, index))
+		return false;
+
+	RtrResponder entry;
+	entry.Response       = response;
+	entry.Response.IsRTR = false;
+	entry.Buffers[0]     = response.Data;
+	entry.Buffers[1]     = response.Data;
+	entry.Active         = 0;
+
+	responder = this->_rtrResponders.size();
+	this->_rtrResponders.push_back(entry);
+
+	// The filter has no callbacks, it is stored so its FIFO is drained by the receive interrupt
+	CanBus::RxCallbackStore store;
+	store.Type         = filter.Type;
+	store.IsExtended   = filter.IsExtended;
+	store.FilterNumber = index;
+	store.Definition   = filter;
+
+	if (fifo == CanBus::RX_FIFO0)
+		this->_fifo0Callbacks.push_back(store);
+	else
+		this->_fifo1Callbacks.push_back(store);
+
+	return true;
+}
+
+CanBus::ErrorState CanBus::ReadErrorState(uint8_t& txErrors, uint8_t& rxErrors) const
+{
+	uint32_t tec = this->_interface->TxErrors;
+	uint32_t rec = this->_interface->RxErrors;
+	txErrors     = tec > 255 ? 255 : (uint8_t)tec;
+	rxErrors     = rec > 255 ? 255 : (uint8_t)rec;
+
+	if (tec > 255)
+		return ErrorState::BusOff;
+	if (tec >= 128 || rec >= 128)
+		return ErrorState::Passive;
+	if (tec >= 96 || rec >= 96)
+		return ErrorState::Warning;
+
+	return ErrorState::Active;
+}
+
+bool CanBus::RecoverBusOff()
+{
+	// Recovery is instant, the 128 recessive sequences are not simulated
+	if (this->_interface->TxErrors <= 255)
+		return false;
+
+	this->_health.Recoveries   = this->_health.Recoveries + 1;
+	this->_interface->TxErrors = 0;
+	this->_interface->RxErrors = 0;
+	return true;
+}
+
+void CanBus::RxCallback(CanBus::Interface* hcan, uint32_t fifo)
+{
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+	{
+		if (std::get<1>(it) == hcan)
+		{
+			CanBus* canbus = std::get<0>(it);
+			canbus->_rxSignal.Notify();
+
+			// Frames of FIFOs without callbacks are left for Receive
+			std::vector<CanBus::RxCallbackStore>& callbacks = fifo == CanBus::RX_FIFO0 ? canbus->_fifo0Callbacks : canbus->_fifo1Callbacks;
+			if (callbacks.empty())
+				continue;
+
+			canbus->RxStartEvent(canbus);
+
+			CanBus::Frame frame;
+			while (TranslateNextFrame(hcan, frame, fifo))
+			{
+				canbus->CountFrame(frame);
+#ifdef PRINT_DEBUG
+				printf("%s RX: 0x%08X (%u)\n", hcan->Name, (unsigned)frame.Id, (unsigned)frame.Length);
+#endif
+				// Remote frames are only accepted for responders and never reach the callbacks
+				if (frame.IsRTR)
+				{
+					canbus->RespondRemote(frame);
+					continue;
+				}
+
+				// Urgent callbacks run before the other callbacks of the same frame
+				for (bool urgent : { true, false })
+				{
+					for (auto& callback : callbacks)
+					{
+						if (callback.Urgent == urgent && callback.FilterNumber == frame.FilterIndex && callback.IsExtended == frame.IsExtended &&
+						    callback.Function)
+						{
+							if (urgent)
+								canbus->RecordUrgentLatency(frame);
+							callback.Function(canbus, frame);
+						}
+					}
+				}
+			}
+
+			canbus->RxEndEvent(canbus);
+		}
+	}
+}
+
+void CanBus::RecordUrgentLatency(const Frame& frame)
+{
+	if (this->_interface->Bus == nullptr)
+		return;
+
+	// The frame is stamped with the start of frame in microseconds of the controller clock
+	int64_t elapsed  = this->_interface->LocalTime(CanSimBus::Now()) / 1000 - (int64_t)frame.Timestamp;
+	uint32_t latency = (uint32_t)(elapsed * this->_interface->Bus->GetBitrate() / 1000000);
+	if (latency > this->_urgentWorstLatency)
+		this->_urgentWorstLatency = latency;
+}
+
+void CanBus::TxCompleteCallback(CanBus::Interface* hcan)
+{
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+	{
+		if (std::get<1>(it) == hcan)
+		{
+			CanBus* canbus = std::get<0>(it);
+			canbus->_txSignal.Notify();
+			canbus->TxCompleteEvent(canbus);
+		}
+	}
+}
+
+void CanBus::TxAbortCallback(CanBus::Interface* hcan)
+{
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+	{
+		if (std::get<1>(it) == hcan)
+		{
+			CanBus* canbus          = std::get<0>(it);
+			canbus->_health.Expired = canbus->_health.Expired + 1;
+			canbus->_txSignal.Notify();
+		}
+	}
+}
+
+void CanBus::TxTimestampCallback(CanBus::Interface* hcan, const Frame& frame)
+{
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+	{
+		if (std::get<1>(it) == hcan)
+		{
+			CanBus* canbus = std::get<0>(it);
+			if (canbus->TxTimestampEvent)
+				canbus->TxTimestampEvent(canbus, frame);
+		}
+	}
+}
+
+} // namespace PSR
+
+#endif
@@ -0,0 +1,840 @@
+/**
+ * @file can_lib_socketcan.cpp
+ * @author Purdue Solar Racing
+ * @brief Linux SocketCAN implementation file
+ * @version 2.1
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_lib.hpp"
+
+#if PSR_CAN_MODE == 3
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <thread>
+
+#include <linux/can.h>
+#include <linux/can/error.h>
+#include <linux/can/raw.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef PRINT_DEBUG
+#include <cstdio>
+#endif
+
+namespace PSR
+{
+
+std::vector<std::tuple<CanBus*, CanBus::Interface*>> CanBus::RegisteredInterfaces = std::vector<std::tuple<CanBus*, CanBus::Interface*>>();
+
+static constexpr size_t RX_BATCH = 32;         // Frames read per recvmmsg call
+static constexpr size_t TX_BATCH = 32;         // Frames written per sendmmsg call
+static constexpr int RX_BUFFER   = 1024 * 1024; // Socket receive buffer, sized to ride out scheduling gaps on a saturated bus
+static constexpr size_t TX_STAMPS = 64;          // Most timestamped frames waiting for their echo, older ones are forgotten
+
+static std::mutex DispatchLock; // Guards RegisteredInterfaces and the epoll instance
+static int DispatchEpoll = -1;  // The epoll instance watched by the dispatch thread
+
+CanBus::CanBus(CanBus::Interface* interface)
+	: _interface(interface), _fifo0Callbacks(), _fifo1Callbacks(), _rtrResponders(), _rtrMissed(0), _health(), _stdFilters(), _extFilters(), _rxHead(0), _rxCount(0),
+	  _timestampedIds(), _txIds()
+{
+	interface->Socket = -1;
+}
+
+uint32_t CanBus::GetTick()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint32_t)(now.tv_sec * 1000 + now.tv_nsec / 1000000);
+}
+
+/**
+ * @brief Append the kernel filters that accept the same frames as a filter
+ *
+ * @param filter The filter to translate
+ * @param kernelFilters The kernel filters to append to
+ */
+static void AppendKernelFilters(const CanBus::Filter& filter, std::vector<struct can_filter>& kernelFilters)
+{
+	canid_t flags  = filter.IsExtended ? CAN_EFF_FLAG : 0;
+	canid_t idMask = filter.IsExtended ? CAN_EFF_MASK : CAN_SFF_MASK;
+
+	// Remote frames are rejected and standard and extended IDs are kept apart, like the FDCAN global filter
+	canid_t typeMask = CAN_EFF_FLAG | CAN_RTR_FLAG;
+
+	switch (filter.Type)
+	{
+	case CanBus::FilterType::ID_MASK:
+		kernelFilters.push_back({ (filter.Id & idMask) | flags, (filter.Mask & idMask) | typeMask });
+		break;
+	case CanBus::FilterType::DUAL:
+		kernelFilters.push_back({ (filter.Id & idMask) | flags, idMask | typeMask });
+		kernelFilters.push_back({ (filter.Id2 & idMask) | flags, idMask | typeMask });
+		break;
+	case CanBus::FilterType::RANGE:
+	{
+		// Split the range into aligned power of two blocks, each of which is a single ID/mask pair
+		uint64_t low  = filter.Id & idMask;
+		uint64_t high = filter.Id2 & idMask;
+		while (low <= high)
+		{
+			uint64_t size = 1;
+			while ((low & (size * 2 - 1)) == 0 && low + size * 2 - 1 <= high)
+				size *= 2;
+
+			kernelFilters.push_back({ (canid_t)low | flags, (canid_t)(~(size - 1) & idMask) | typeMask });
+			low += size;
+		}
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+bool CanBus::ApplyKernelFilters() const
+{
+	std::vector<struct can_filter> kernelFilters;
+	for (const Filter& filter : this->_stdFilters)
+		AppendKernelFilters(filter, kernelFilters);
+	for (const Filter& filter : this->_extFilters)
+		AppendKernelFilters(filter, kernelFilters);
+
+	// Echoes of own frames pass the same filters as received frames, so every identifier sent gets an exact filter. Frames of other nodes
+	// with these identifiers are dropped again by the dispatch when they match no filter.
+	if (!kernelFilters.empty())
+	{
+		for (uint32_t id : this->_txIds)
+			kernelFilters.push_back({ id, (id & CAN_EFF_FLAG) != 0 ? CAN_EFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG : CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG });
+	}
+
+	// Without filters every data frame is received so Receive can poll the bus, the dispatch drops the frames that match no filter once
+	// there are too many identifiers for the kernel
+	if (kernelFilters.empty() || kernelFilters.size() + this->_rtrResponders.size() > CAN_RAW_FILTER_MAX)
+	{
+		kernelFilters.clear();
+		kernelFilters.push_back({ 0, CAN_RTR_FLAG });
+	}
+
+	// Responders accept only remote frames with exactly their identifier
+	for (const RtrResponder& responder : this->_rtrResponders)
+	{
+		const Frame& response = responder.Response;
+		canid_t flags         = response.IsExtended ? CAN_EFF_FLAG : 0;
+		canid_t idMask        = response.IsExtended ? CAN_EFF_MASK : CAN_SFF_MASK;
+		kernelFilters.push_back({ (response.Id & idMask) | flags | CAN_RTR_FLAG, idMask | CAN_EFF_FLAG | CAN_RTR_FLAG });
+	}
+
+	return setsockopt(this->_interface->Socket, SOL_CAN_RAW, CAN_RAW_FILTER, kernelFilters.data(), kernelFilters.size() * sizeof(struct can_filter)) == 0;
+}
+
+bool CanBus::Init()
+{
+	if (this->_interface->Socket < 0)
+	{
+		int sock = socket(PF_CAN, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, CAN_RAW);
+		if (sock < 0)
+			return false;
+
+		struct sockaddr_can address;
+		memset(&address, 0, sizeof(address));
+		address.can_family  = AF_CAN;
+		address.can_ifindex = (int)if_nametoindex(this->_interface->Name);
+
+		int timestamping      = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+		int rxBuffer          = RX_BUFFER;
+		int receiveOwn        = 1;
+		can_err_mask_t errors = CAN_ERR_BUSOFF | CAN_ERR_CRTL | CAN_ERR_RESTARTED;
+
+		if (address.can_ifindex == 0 || bind(sock, (struct sockaddr*)&address, sizeof(address)) != 0)
+		{
+			close(sock);
+			return false;
+		}
+
+		// Timestamping and the larger buffer are best effort, not every interface supports them
+		setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPING, &timestamping, sizeof(timestamping));
+		setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rxBuffer, sizeof(rxBuffer));
+
+		// Error frames carry the controller state for UpdateHealth, drivers that do not send them leave the state error active
+		setsockopt(sock, SOL_CAN_RAW, CAN_RAW_ERR_FILTER, &errors, sizeof(errors));
+
+		// Own frames come back flagged with MSG_CONFIRM once they are on the bus, which is used as the TX complete notification
+		if (setsockopt(sock, SOL_CAN_RAW, CAN_RAW_RECV_OWN_MSGS, &receiveOwn, sizeof(receiveOwn)) != 0)
+		{
+			close(sock);
+			return false;
+		}
+
+		this->_interface->Socket = sock;
+	}
+
+	{
+		std::lock_guard<std::recursive_mutex> lock(this->_rxLock);
+		if (!this->ApplyKernelFilters())
+			return false;
+	}
+
+	std::lock_guard<std::mutex> lock(DispatchLock);
+
+	bool found = false;
+	for (std::tuple<CanBus*, CanBus::Interface*>& it : RegisteredInterfaces)
+	{
+		if (std::get<0>(it) == this)
+		{
+			found = true;
+			break;
+		}
+	}
+
+	if (found)
+		return true;
+
+	if (DispatchEpoll < 0)
+	{
+		DispatchEpoll = epoll_create1(EPOLL_CLOEXEC);
+		if (DispatchEpoll < 0)
+			return false;
+
+		std::thread(CanBus::DispatchLoop).detach();
+	}
+
+	struct epoll_event event;
+	event.events   = EPOLLIN;
+	event.data.ptr = this->_interface;
+	if (epoll_ctl(DispatchEpoll, EPOLL_CTL_ADD, this->_interface->Socket, &event) != 0)
+		return false;
+
+	RegisteredInterfaces.push_back(std::make_tuple(this, this->_interface));
+
+#ifdef PRINT_DEBUG
+	printf("\tInitialized CanBus on %s.\n", this->_interface->Name);
+#endif
+
+	return true;
+}
+
+/**
+ * @brief Let the echoes of an identifier through the kernel filters before the first frame with it is sent
+ *
+ * @param id The SocketCAN identifier including the flags
+ * @return bool Whether the echoes of the identifier are received
+ */
+bool CanBus::TrackTxId(uint32_t id) const
+{
+	std::lock_guard<std::recursive_mutex> lock(this->_rxLock);
+
+	std::vector<uint32_t>::iterator position = std::lower_bound(this->_txIds.begin(), this->_txIds.end(), id);
+	if (position != this->_txIds.end() && *position == id)
+		return true;
+
+	this->_txIds.insert(position, id);
+	return this->_interface->Socket < 0 || this->ApplyKernelFilters();
+}
+
+/**
+ * @brief Translate a frame into a SocketCAN frame
+ */
+static void TranslateFrame(const CanBus::Frame& frame, struct can_frame& out)
+{
+	memset(&out, 0, sizeof(out));
+	out.can_id = frame.IsExtended ? ((frame.Id & CAN_EFF_MASK) | CAN_EFF_FLAG) : (frame.Id & CAN_SFF_MASK);
+	out.can_id |= frame.IsRTR ? CAN_RTR_FLAG : 0;
+	out.can_dlc = frame.Length > 8 ? 8 : frame.Length;
+	memcpy(out.data, frame.Data.Bytes, sizeof(out.data));
+}
+
+/**
+ * @brief Send a frame, waiting while the interface queue is full
+ *
+ * @param sock The raw CAN socket
+ * @param out The frame to send
+ * @param timeout The maximum time to wait in milliseconds
+ * @return bool Whether the frame was queued by the kernel
+ */
+static bool SendFrame(int sock, const struct can_frame& out, uint32_t timeout)
+{
+	uint32_t tickStart = CanBus::GetTick();
+	while (true)
+	{
+		if (send(sock, &out, sizeof(out), MSG_DONTWAIT) == (ssize_t)sizeof(out))
+			return true;
+
+		uint32_t elapsed = CanBus::GetTick() - tickStart;
+		if ((errno != ENOBUFS && errno != EAGAIN) || elapsed > timeout)
+			return false;
+
+		struct pollfd pending;
+		pending.fd     = sock;
+		pending.events = POLLOUT;
+		poll(&pending, 1, (int)(timeout - elapsed));
+	}
+}
+
+bool CanBus::Transmit(const Frame& frame) const
+{
+	constexpr uint32_t timeout = 20;
+
+	return this->TransmitFor(frame, timeout);
+}
+
+bool CanBus::TransmitFor(const Frame& frame, uint32_t timeout) const
+{
+	this->TxStartEvent(this);
+
+	if (this->Throttle(frame))
+	{
+		this->TxErrorEvent(this);
+		this->TxEndEvent(this);
+		return false;
+	}
+
+	struct can_frame out;
+	TranslateFrame(frame, out);
+	this->TrackTxId(out.can_id);
+
+	bool status = SendFrame(this->_interface->Socket, out, timeout);
+	if (!status)
+		this->TxErrorEvent(this);
+
+	this->TxEndEvent(this);
+	return status;
+}
+
+bool CanBus::TransmitTimestamped(const Frame& frame) const
+{
+	struct can_frame out;
+	TranslateFrame(frame, out);
+
+	// The echo is matched by identifier, so the identifier is recorded before the frame can reach the bus. Frames the driver drops never
+	// echo, so only the newest ones are kept
+	{
+		std::lock_guard<std::recursive_mutex> lock(this->_rxLock);
+		if (this->_timestampedIds.size() >= TX_STAMPS)
+			this->_timestampedIds.erase(this->_timestampedIds.begin());
+		this->_timestampedIds.push_back(out.can_id);
+	}
+
+	constexpr uint32_t timeout = 20;
+	if (this->TransmitFor(frame, timeout))
+		return true;
+
+	std::lock_guard<std::recursive_mutex> lock(this->_rxLock);
+	for (size_t i = this->_timestampedIds.size(); i > 0; i--)
+	{
+		if (this->_timestampedIds[i - 1] == out.can_id)
+		{
+			this->_timestampedIds.erase(this->_timestampedIds.begin() + (i - 1));
+			break;
+		}
+	}
+
+	return false;
+}
+
+bool CanBus::Transmit(const Frame& frame, TxPolicy policy, uint32_t deadline) const
+{
+	// Frames handed to the kernel cannot be replaced or cancelled, Supersede sends the frame normally
+	if (policy != TxPolicy::Deadline)
+		return this->Transmit(frame);
+
+	int32_t remaining = (int32_t)(deadline - GetTick());
+	if (remaining <= 0)
+	{
+		this->TxStartEvent(this);
+		this->_health.Expired = this->_health.Expired + 1;
+		this->TxErrorEvent(this);
+		this->TxEndEvent(this);
+		return false;
+	}
+
+	// The wait for room in the socket buffer ends at the deadline, the kernel queue after it is not bounded
+	constexpr uint32_t timeout = 20;
+	if (this->TransmitFor(frame, (uint32_t)remaining < timeout ? (uint32_t)remaining : timeout))
+		return true;
+
+	if ((int32_t)(deadline - GetTick()) <= 0)
+		this->_health.Expired = this->_health.Expired + 1;
+
+	return false;
+}
+
+void CanBus::ExpireTxFrames() const
+{
+	// No frame waits in the library, Transmit hands every frame to the kernel
+}
+
+/**
+ * @brief Read CLOCK_REALTIME in microseconds, the clock of the kernel software timestamps
+ */
+static uint32_t ReadMicroseconds()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (uint32_t)(now.tv_sec * 1000000 + now.tv_nsec / 1000);
+}
+
+uint32_t CanBus::GetTimestamp() const
+{
+	return ReadMicroseconds();
+}
+
+bool CanBus::TryTransmit(const Frame& frame) const
+{
+	this->TxStartEvent(this);
+
+	if (this->Throttle(frame))
+	{
+		this->TxErrorEvent(this);
+		this->TxEndEvent(this);
+		return false;
+	}
+
+	struct can_frame out;
+	TranslateFrame(frame, out);
+	this->TrackTxId(out.can_id);
+
+	bool status = send(this->_interface->Socket, &out, sizeof(out), MSG_DONTWAIT) == (ssize_t)sizeof(out);
+	if (!status)
+		this->TxErrorEvent(this);
+
+	this->TxEndEvent(this);
+	return status;
+}
+
+size_t CanBus::TransmitBatch(const Frame* frames, size_t count) const
+{
+	struct can_frame out[TX_BATCH];
+	struct iovec vectors[TX_BATCH];
+	struct mmsghdr messages[TX_BATCH];
+
+	this->TxStartEvent(this);
+
+	// Like a full queue, a throttled frame ends the batch so the frames after it keep their order
+	size_t sent    = 0;
+	bool throttled = false;
+	while (sent < count && !throttled)
+	{
+		size_t batch = count - sent < TX_BATCH ? count - sent : TX_BATCH;
+		for (size_t i = 0; i < batch; i++)
+		{
+			if (this->Throttle(frames[sent + i]))
+			{
+				batch     = i;
+				throttled = true;
+				break;
+			}
+
+			TranslateFrame(frames[sent + i], out[i]);
+			this->TrackTxId(out[i].can_id);
+			vectors[i].iov_base = &out[i];
+			vectors[i].iov_len  = sizeof(out[i]);
+
+			memset(&messages[i], 0, sizeof(messages[i]));
+			messages[i].msg_hdr.msg_iov    = &vectors[i];
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		if (batch == 0)
+			break;
+
+		int result = sendmmsg(this->_interface->Socket, messages, (unsigned int)batch, MSG_DONTWAIT);
+		if (result <= 0)
+			break;
+
+		sent += (size_t)result;
+		if ((size_t)result < batch)
+			break;
+	}
+
+	if (sent < count)
+		this->TxErrorEvent(this);
+
+	this->TxEndEvent(this);
+	return sent;
+}
+
+/**
+ * @brief Translate a received SocketCAN frame and its timestamp into a frame
+ *
+ * @param in The received frame
+ * @param header The message header carrying the timestamp control message
+ * @param frame The frame to be updated
+ */
+static void TranslateReceivedFrame(const struct can_frame& in, struct msghdr& header, CanBus::Frame& frame)
+{
+	bool isExtended  = (in.can_id & CAN_EFF_FLAG) != 0;
+	frame.Id         = in.can_id & (isExtended ? CAN_EFF_MASK : CAN_SFF_MASK);
+	frame.IsRTR      = (in.can_id & CAN_RTR_FLAG) != 0;
+	frame.IsExtended = isExtended;
+	frame.Length     = in.can_dlc > 8 ? 8 : in.can_dlc;
+	memcpy(frame.Data.Bytes, in.data, sizeof(in.data));
+
+	// Without a kernel timestamp the frame is stamped when it is read
+	frame.Timestamp = ReadMicroseconds();
+	for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&header); cmsg != nullptr; cmsg = CMSG_NXTHDR(&header, cmsg))
+	{
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SO_TIMESTAMPING)
+			continue;
+
+		// Software timestamps are taken from CLOCK_REALTIME, the same clock as GetTimestamp, hardware clocks would need their own conversion
+		struct scm_timestamping stamps;
+		memcpy(&stamps, CMSG_DATA(cmsg), sizeof(stamps));
+		const struct timespec& stamp = stamps.ts[0];
+
+		frame.Timestamp = (uint32_t)(stamp.tv_sec * 1000000 + stamp.tv_nsec / 1000);
+	}
+}
+
+bool CanBus::Receive(CanBus::Frame& frame) const
+{
+	return this->ReceiveFor(frame, 0);
+}
+
+bool CanBus::ReceiveFor(CanBus::Frame& frame, uint32_t timeout) const
+{
+	this->RxStartEvent(this);
+
+	bool status        = false;
+	uint32_t tickStart = GetTick();
+	while (true)
+	{
+		{
+			std::lock_guard<std::recursive_mutex> lock(this->_rxLock);
+			if (this->_rxCount != 0)
+			{
+				frame         = this->_rxQueue[this->_rxHead];
+				this->_rxHead = (this->_rxHead + 1) % CanBus::RX_QUEUE_SIZE;
+				this->_rxCount--;
+				status = true;
+			}
+		}
+
+		uint32_t elapsed = GetTick() - tickStart;
+		if (status || elapsed >= timeout)
+			break;
+
+		this->_rxSignal.Wait(timeout - elapsed);
+	}
+
+	if (!status)
+		this->RxErrorEvent(this);
+
+	this->RxEndEvent(this);
+	return status;
+}
+
+void CanBus::QueueFrame(const Frame& frame)
+{
+	// Like a hardware FIFO in blocking mode, new frames are dropped while the queue is full
+	if (this->_rxCount == CanBus::RX_QUEUE_SIZE)
+		return;
+
+	this->_rxQueue[(this->_rxHead + this->_rxCount) % CanBus::RX_QUEUE_SIZE] = frame;
+	this->_rxCount++;
+	this->_rxSignal.Notify();
+}
+
+bool CanBus::AddRxCallback(Callback callback, const Filter& filter, uint32_t fifo)
+{
+	if (fifo != CanBus::RX_FIFO0 && fifo != CanBus::RX_FIFO1)
+		return false;
+
+	std::lock_guard<std::recursive_mutex> lock(this->_rxLock);
+
+	std::vector<Filter>& filters = filter.IsExtended ? this->_extFilters : this->_stdFilters;
+	if (filters.size() >= CAN_RAW_FILTER_MAX)
+		return false;
+
+	CanBus::RxCallbackStore store;
+	store.Function     = callback;
+	store.Type         = filter.Type;
+	store.IsExtended   = filter.IsExtended;
+	store.FilterNumber = filters.size();
+	store.Definition   = filter;
+
+	filters.push_back(filter);
+
+	if (fifo == CanBus::RX_FIFO0)
+		this->_fifo0Callbacks.push_back(store);
+	else
+		this->_fifo1Callbacks.push_back(store);
+
+	// Filters added before Init are applied when the socket is opened
+	if (this->_interface == nullptr || this->_interface->Socket < 0)
+		return true;
+
+	if (this->ApplyKernelFilters())
+		return true;
+
+	// The kernel keeps the filters it had, the callback must not be left without one
+	filters.pop_back();
+	if (fifo == CanBus::RX_FIFO0)
+		this->_fifo0Callbacks.pop_back();
+	else
+		this->_fifo1Callbacks.pop_back();
+
+	return false;
+}
+
+bool CanBus::AddRtrResponder(const Frame& response, uint32_t fifo, uint32_t& responder)
+{
+	if (fifo != CanBus::RX_FIFO0 && fifo != CanBus::RX_FIFO1)
+		return false;
+
+	std::lock_guard<std::recursive_mutex> lock(this->_rxLock);
+
+	RtrResponder entry;
+	entry.Response       = response;
+	entry.Response.IsRTR = false;
+	entry.Buffers[0]     = response.Data;
+	entry.Buffers[1]     = response.Data;
+	entry.Active         = 0;
+
+	responder = this->_rtrResponders.size();
+	this->_rtrResponders.push_back(entry);
+
+	// Responders added before Init are applied when the socket is opened
+	if (this->_interface == nullptr || this->_interface->Socket < 0)
+		return true;
+
+	return this->ApplyKernelFilters();
+}
+
+bool CanBus::AddRxUrgentCallback(Callback callback, const Filter& filter)
+{
+	std::lock_guard<std::recursive_mutex> lock(this->_rxLock);
+
+	if (!this->AddRxCallback(callback, filter, CanBus::RX_FIFO1))
+		return false;
+
+	this->_fifo1Callbacks.back().Urgent = true;
+	return true;
+}
+
+void CanBus::RxCallback(CanBus::Interface* hcan, uint32_t)
+{
+	CanBus* canbus = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(DispatchLock);
+		for (std::tuple<CanBus*, CanBus::Interface*>& it : CanBus::RegisteredInterfaces)
+		{
+			if (std::get<1>(it) == hcan)
+			{
+				canbus = std::get<0>(it);
+				break;
+			}
+		}
+	}
+
+	if (canbus == nullptr)
+		return;
+
+	if (canbus->RxStartEvent)
+		canbus->RxStartEvent(canbus);
+
+	struct can_frame in[RX_BATCH];
+	struct iovec vectors[RX_BATCH];
+	struct mmsghdr messages[RX_BATCH];
+	char control[RX_BATCH][CMSG_SPACE(sizeof(struct scm_timestamping))];
+
+	for (size_t i = 0; i < RX_BATCH; i++)
+	{
+		vectors[i].iov_base = &in[i];
+		vectors[i].iov_len  = sizeof(in[i]);
+
+		memset(&messages[i], 0, sizeof(messages[i]));
+		messages[i].msg_hdr.msg_iov        = &vectors[i];
+		messages[i].msg_hdr.msg_iovlen     = 1;
+		messages[i].msg_hdr.msg_control    = control[i];
+		messages[i].msg_hdr.msg_controllen = sizeof(control[i]);
+	}
+
+	int count = recvmmsg(hcan->Socket, messages, RX_BATCH, MSG_DONTWAIT, nullptr);
+	if (count <= 0)
+	{
+#ifdef PRINT_DEBUG
+		printf("CAN RX Error.\n");
+#endif
+		if (canbus->RxErrorEvent)
+			canbus->RxErrorEvent(canbus);
+	}
+
+	std::lock_guard<std::recursive_mutex> lock(canbus->_rxLock);
+
+	CanBus::Frame frames[RX_BATCH];
+	bool consumed[RX_BATCH];
+	size_t received = 0;
+	for (int i = 0; i < count; i++)
+	{
+		// Error frames update the error state and never reach the callbacks
+		if ((in[i].can_id & CAN_ERR_FLAG) != 0)
+		{
+			canbus->HandleErrorFrame(in[i].can_id, in[i].data);
+			continue;
+		}
+
+		if ((messages[i].msg_hdr.msg_flags & MSG_CONFIRM) != 0)
+		{
+			// Own frames are counted once they are on the bus, so frames dropped by the driver do not add to the load
+			CanBus::Frame sent;
+			TranslateReceivedFrame(in[i], messages[i].msg_hdr, sent);
+			canbus->CountFrame(sent);
+
+			canbus->_txSignal.Notify();
+			if (canbus->TxCompleteEvent)
+				canbus->TxCompleteEvent(canbus);
+
+			// Echoes are received in the order the frames were sent, so the first pending frame with the identifier is this one
+			std::vector<uint32_t>& pending = canbus->_timestampedIds;
+			for (size_t index = 0; index < pending.size(); index++)
+			{
+				if (pending[index] != in[i].can_id)
+					continue;
+
+				pending.erase(pending.begin() + index);
+				if (canbus->TxTimestampEvent)
+					canbus->TxTimestampEvent(canbus, sent);
+				break;
+			}
+			continue;
+		}
+
+		CanBus::Frame& frame = frames[received];
+		consumed[received]   = false;
+		received++;
+
+		TranslateReceivedFrame(in[i], messages[i].msg_hdr, frame);
+		canbus->CountFrame(frame);
+
+		// Remote frames are only accepted for responders and never reach the callbacks
+		if (frame.IsRTR)
+		{
+			canbus->RespondRemote(frame);
+			consumed[received - 1] = true;
+			continue;
+		}
+
+		// The kernel does not report which filter accepted a frame, so the first match is found the same way the controller would
+		const std::vector<Filter>& filters = frame.IsExtended ? canbus->_extFilters : canbus->_stdFilters;
+		for (size_t index = 0; index < filters.size(); index++)
+		{
+			if (filters[index].Matches(frame.Id, frame.IsExtended))
+			{
+				frame.IsFilterMatched = true;
+				frame.FilterIndex     = index;
+				break;
+			}
+		}
+
+		// Frames let through only for the echo filters are dropped, like the controller rejects frames no filter accepts
+		if (!frame.IsFilterMatched && (!canbus->_stdFilters.empty() || !canbus->_extFilters.empty()))
+			received--;
+	}
+
+	// Urgent callbacks see every frame of the batch before any other callback runs
+	for (bool urgent : { true, false })
+	{
+		for (size_t i = 0; i < received; i++)
+		{
+			const CanBus::Frame& frame = frames[i];
+			if (!frame.IsFilterMatched)
+				continue;
+
+			for (std::vector<RxCallbackStore>* callbacks : { &canbus->_fifo0Callbacks, &canbus->_fifo1Callbacks })
+			{
+				for (auto& callback : *callbacks)
+				{
+					if (callback.Urgent == urgent && callback.FilterNumber == frame.FilterIndex && callback.IsExtended == frame.IsExtended &&
+					    callback.Function)
+					{
+						callback.Function(canbus, frame);
+						consumed[i] = true;
+					}
+				}
+			}
+		}
+	}
+
+	for (size_t i = 0; i < received; i++)
+	{
+		if (!consumed[i])
+			canbus->QueueFrame(frames[i]);
+	}
+
+	if (canbus->RxEndEvent)
+		canbus->RxEndEvent(canbus);
+}
+
+void CanBus::HandleErrorFrame(uint32_t id, const uint8_t data[8])
+{
+	if ((id & CAN_ERR_CNT) != 0)
+	{
+		this->_health.TxErrors = data[6];
+		this->_health.RxErrors = data[7];
+	}
+
+	if ((id & CAN_ERR_BUSOFF) != 0)
+	{
+		this->NoteBusOff();
+	}
+	else if ((id & CAN_ERR_RESTARTED) != 0)
+	{
+		this->_health.State = ErrorState::Active;
+	}
+	else if ((id & CAN_ERR_CRTL) != 0 && this->_health.State != ErrorState::BusOff)
+	{
+		uint8_t status = data[1];
+		if ((status & (CAN_ERR_CRTL_TX_PASSIVE | CAN_ERR_CRTL_RX_PASSIVE)) != 0)
+			this->_health.State = ErrorState::Passive;
+		else if ((status & (CAN_ERR_CRTL_TX_WARNING | CAN_ERR_CRTL_RX_WARNING)) != 0)
+			this->_health.State = ErrorState::Warning;
+		else if ((status & CAN_ERR_CRTL_ACTIVE) != 0)
+			this->_health.State = ErrorState::Active;
+	}
+}
+
+CanBus::ErrorState CanBus::ReadErrorState(uint8_t& txErrors, uint8_t& rxErrors) const
+{
+	// The kernel only reports the state through error frames, so the values they left are returned
+	txErrors = this->_health.TxErrors;
+	rxErrors = this->_health.RxErrors;
+	return this->_health.State;
+}
+
+bool CanBus::RecoverBusOff()
+{
+	return false;
+}
+
+void CanBus::DispatchLoop()
+{
+	constexpr int maxEvents = 16;
+	struct epoll_event events[maxEvents];
+
+	while (true)
+	{
+		int count = epoll_wait(DispatchEpoll, events, maxEvents, -1);
+		if (count < 0 && errno != EINTR)
+			return;
+
+		for (int i = 0; i < count; i++)
+			RxCallback(static_cast<CanBus::Interface*>(events[i].data.ptr), CanBus::RX_FIFO0);
+	}
+}
+
+} // namespace PSR
+
+#endif
@@ -0,0 +1,275 @@
+/**
+ * @file can_router.cpp
+ * @author Purdue Solar Racing
+ * @brief CAN gateway implementation file
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_router.hpp"
+
+namespace PSR
+{
+
+CanRouter::RouteState::RouteState(const Route& route)
+	: Config(route), Tokens(0), LastTick(CanBus::GetTick()), Forwarded(0), RateLimited(0), Overflowed(0)
+{
+	if (this->Config.Rate != 0 && this->Config.Burst == 0)
+		this->Config.Burst = 1;
+
+	this->Tokens = this->Config.Burst * 1000;
+}
+
+CanRouter::CanRouter() : _routes(), _destinations(), _destinationCount(0)
+{
+	this->_routes.reserve(MAX_ROUTES);
+}
+
+static bool SameFilter(const CanBus::Filter& a, const CanBus::Filter& b)
+{
+	return a.Type == b.Type && a.IsExtended == b.IsExtended && a.Id == b.Id && a.Mask == b.Mask;
+}
+
+bool CanRouter::AddRoute(const Route& route, uint32_t fifo, uint32_t& index)
+{
+	if (this->_routes.size() >= MAX_ROUTES || route.Source == nullptr || route.Destination == nullptr)
+		return false;
+
+	Destination* destination = this->FindDestination(route.Destination);
+	if (destination == nullptr)
+	{
+		if (this->_destinationCount >= MAX_BUSES)
+			return false;
+
+		destination            = &this->_destinations[this->_destinationCount++];
+		destination->Bus       = route.Destination;
+		destination->Count     = 0;
+		destination->Sequence  = 0;
+		destination->HighWater = 0;
+
+		// Queued frames are sent as soon as the destination frees a transmit buffer
+		std::function<void(const CanBus*)> previous = route.Destination->TxCompleteEvent;
+		route.Destination->TxCompleteEvent          = [this, destination, previous](const CanBus* canbus)
+		{
+			{
+				CanOs::CriticalSection section;
+				this->Drain(*destination);
+			}
+
+			if (previous)
+				previous(canbus);
+		};
+
+#if PSR_CAN_MODE == 2
+		route.Destination->SetTxPriorityQueue(true);
+#endif
+	}
+
+	// Routes that share a source filter are all checked by Forward, the filter is only needed once
+	bool filterExists = false;
+	for (const RouteState& existing : this->_routes)
+		filterExists = filterExists || (existing.Config.Source == route.Source && SameFilter(existing.Config.Match, route.Match));
+
+	index = this->_routes.size();
+	this->_routes.emplace_back(route);
+
+	if (filterExists)
+		return true;
+
+#if PSR_CAN_MODE == 2
+	// The payload is taken from the RX element in the interrupt instead of being copied for a deferred callback
+	bool status = route.Source->AddRxPeekCallback(
+		[this](CanBus* canbus, const CanBus::Frame& frame, const volatile uint32_t* data)
+		{
+			CanBus::Frame forwarded = frame;
+			forwarded.Data.Words[0] = data[0];
+			forwarded.Data.Words[1] = data[1];
+			this->Forward(canbus, forwarded);
+		},
+		route.Match, fifo);
+#else
+	bool status = route.Source->AddRxCallback([this](CanBus* canbus, const CanBus::Frame& frame) { this->Forward(canbus, frame); }, route.Match, fifo);
+#endif
+
+	if (!status)
+		this->_routes.pop_back();
+
+	return status;
+}
+
+CanRouter::Destination* CanRouter::FindDestination(const CanBus* bus)
+{
+	for (uint32_t i = 0; i < this->_destinationCount; i++)
+	{
+		if (this->_destinations[i].Bus == bus)
+			return &this->_destinations[i];
+	}
+
+	return nullptr;
+}
+
+uint32_t CanRouter::Priority(const CanBus::Frame& frame)
+{
+	// Arbitration compares the base identifier first, then a standard frame wins over an extended one, then a data frame over a remote one
+	uint32_t priority;
+	if (frame.IsExtended)
+		priority = (((frame.Id >> 18) & CanBus::STD_ID_MASK) << 19) | (1U << 18) | (frame.Id & 0x3FFFF);
+	else
+		priority = (frame.Id & CanBus::STD_ID_MASK) << 19;
+
+	return (priority << 1) | (frame.IsRTR ? 1 : 0);
+}
+
+bool CanRouter::Before(const Pending& a, const Pending& b)
+{
+	if (a.Priority != b.Priority)
+		return a.Priority < b.Priority;
+
+	return (int32_t)(a.Sequence - b.Sequence) < 0;
+}
+
+bool CanRouter::TakeToken(RouteState& route)
+{
+	if (route.Config.Rate == 0)
+		return true;
+
+	uint32_t now     = CanBus::GetTick();
+	uint32_t elapsed = now - route.LastTick;
+	route.LastTick   = now;
+
+	// One frame costs 1000 tokens and each millisecond adds the rate in frames per second
+	uint32_t capacity = route.Config.Burst * 1000;
+	uint64_t tokens   = (uint64_t)route.Tokens + (uint64_t)elapsed * route.Config.Rate;
+	route.Tokens      = tokens > capacity ? capacity : (uint32_t)tokens;
+
+	if (route.Tokens < 1000)
+		return false;
+
+	route.Tokens -= 1000;
+	return true;
+}
+
+void CanRouter::Enqueue(Destination& destination, const CanBus::Frame& frame)
+{
+	uint32_t position = destination.Count++;
+	if (destination.Count > destination.HighWater)
+		destination.HighWater = destination.Count;
+
+	Pending pending;
+	pending.Priority = Priority(frame);
+	pending.Sequence = destination.Sequence++;
+	pending.Frame    = CanBus::PackedFrame::FromFrame(frame);
+
+	while (position > 0)
+	{
+		uint32_t parent = (position - 1) / 2;
+		if (!Before(pending, destination.Queue[parent]))
+			break;
+
+		destination.Queue[position] = destination.Queue[parent];
+		position                    = parent;
+	}
+
+	destination.Queue[position] = pending;
+}
+
+void CanRouter::Drain(Destination& destination)
+{
+	while (destination.Count > 0 && destination.Bus->TryTransmit(destination.Queue[0].Frame.ToFrame()))
+	{
+		destination.Count--;
+		if (destination.Count == 0)
+			break;
+
+		// Move the last frame to the root and sift it down
+		Pending last      = destination.Queue[destination.Count];
+		uint32_t position = 0;
+		while (true)
+		{
+			uint32_t child = 2 * position + 1;
+			if (child >= destination.Count)
+				break;
+
+			if (child + 1 < destination.Count && Before(destination.Queue[child + 1], destination.Queue[child]))
+				child++;
+
+			if (!Before(destination.Queue[child], last))
+				break;
+
+			destination.Queue[position] = destination.Queue[child];
+			position                    = child;
+		}
+
+		destination.Queue[position] = last;
+	}
+}
+
+void CanRouter::Forward(CanBus* source, const CanBus::Frame& frame)
+{
+	for (RouteState& route : this->_routes)
+	{
+		const Route& config = route.Config;
+		if (config.Source != source || !config.Match.Matches(frame.Id, frame.IsExtended))
+			continue;
+
+		// Both RX FIFOs and the destination TX interrupt can touch the same route and queue
+		CanOs::CriticalSection section;
+
+		if (!this->TakeToken(route))
+		{
+			route.RateLimited = route.RateLimited + 1;
+			continue;
+		}
+
+		CanBus::Frame forwarded = frame;
+		forwarded.Id            = (frame.Id & ~config.RewriteMask) | (config.RewriteValue & config.RewriteMask);
+
+		Destination* destination = this->FindDestination(config.Destination);
+
+		// Frames already waiting may have a higher priority, so the new frame only skips the queue when it is empty
+		if (destination->Count == 0 && destination->Bus->TryTransmit(forwarded))
+		{
+			route.Forwarded = route.Forwarded + 1;
+			continue;
+		}
+
+		if (destination->Count >= QUEUE_SIZE)
+		{
+			route.Overflowed = route.Overflowed + 1;
+			continue;
+		}
+
+		this->Enqueue(*destination, forwarded);
+		this->Drain(*destination);
+		route.Forwarded = route.Forwarded + 1;
+	}
+}
+
+CanRouter::Counters CanRouter::GetCounters(uint32_t index) const
+{
+	Counters counters = { 0, 0, 0 };
+	if (index >= this->_routes.size())
+		return counters;
+
+	const RouteState& route = this->_routes[index];
+	counters.Forwarded      = route.Forwarded;
+	counters.RateLimited    = route.RateLimited;
+	counters.Overflowed     = route.Overflowed;
+	return counters;
+}
+
+uint32_t CanRouter::GetQueueHighWater(const CanBus& bus) const
+{
+	for (uint32_t i = 0; i < this->_destinationCount; i++)
+	{
+		if (this->_destinations[i].Bus == &bus)
+			return this->_destinations[i].HighWater;
+	}
+
+	return 0;
+}
+
+} // namespace PSR
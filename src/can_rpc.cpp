@@ -0,0 +1,202 @@
+/**
+ * @file can_rpc.cpp
+ * @author Purdue Solar Racing
+ * @brief Asynchronous request/response implementation file
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_rpc.hpp"
+
+#include <utility>
+
+namespace PSR
+{
+
+CanRpc::CanRpc(CanBus& bus, uint8_t nodeId) : _bus(&bus), _nodeId(nodeId), _table(), _count(0)
+{
+	for (Pending& pending : this->_table)
+		pending.Key = EMPTY_KEY;
+}
+
+bool CanRpc::Attach(uint32_t fifo)
+{
+	CanBus::Filter filter;
+	filter.Type       = CanBus::FilterType::ID_MASK;
+	filter.IsExtended = true;
+	filter.Id         = CanBus::CanId::FromParts(this->_nodeId, 0, 0, 0, 0);
+	filter.Mask       = CanBus::CanId::DstMask();
+
+	return this->_bus->AddRxCallback([this](CanBus* bus, const CanBus::Frame& frame) { this->OnFrame(bus, frame); }, filter, fifo);
+}
+
+uint32_t CanRpc::Find(uint16_t key) const
+{
+	uint32_t index = Home(key);
+	while (this->_table[index].Key != EMPTY_KEY)
+	{
+		if (this->_table[index].Key == key)
+			return index;
+
+		index = (index + 1) & (TABLE_SIZE - 1);
+	}
+
+	return TABLE_SIZE;
+}
+
+void CanRpc::Remove(uint32_t index)
+{
+	this->_table[index].Key  = EMPTY_KEY;
+	this->_table[index].Done = nullptr;
+	this->_count--;
+
+	// Shift later entries of the probe sequence back so lookups never stop early at the removed slot
+	uint32_t hole = index;
+	uint32_t next = (index + 1) & (TABLE_SIZE - 1);
+	while (this->_table[next].Key != EMPTY_KEY)
+	{
+		uint32_t home = Home(this->_table[next].Key);
+		if (((next - home) & (TABLE_SIZE - 1)) >= ((next - hole) & (TABLE_SIZE - 1)))
+		{
+			this->_table[hole]      = this->_table[next];
+			this->_table[next].Key  = EMPTY_KEY;
+			this->_table[next].Done = nullptr;
+			hole                    = next;
+		}
+
+		next = (next + 1) & (TABLE_SIZE - 1);
+	}
+}
+
+/**
+ * @brief Queue a request for transmission without blocking, marking it unsent again if every transmit buffer is busy
+ * @remark The request is marked sent before it is queued, a reply can arrive before TryTransmit returns
+ */
+bool CanRpc::Send(uint16_t key, const CanBus::Frame& request)
+{
+	if (this->_bus->TryTransmit(request))
+		return true;
+
+	CanOs::CriticalSection section;
+
+	uint32_t index = this->Find(key);
+	if (index != TABLE_SIZE)
+		this->_table[index].Sent = false;
+
+	return false;
+}
+
+bool CanRpc::Request(const CanBus::Frame& request, uint32_t timeout, Completion done)
+{
+	if (!request.IsExtended)
+		return false;
+
+	CanBus::CanId id = CanBus::CanId::FromValue(request.Id);
+	uint16_t key     = MakeKey(id.Dst, id.Message);
+
+	{
+		// Replies may be dispatched from an interrupt, so the table is only changed with it masked
+		CanOs::CriticalSection section;
+
+		// A second request with the same key could not be told apart from the first
+		if (this->_count >= MAX_PENDING || this->Find(key) != TABLE_SIZE)
+			return false;
+
+		uint32_t index = Home(key);
+		while (this->_table[index].Key != EMPTY_KEY)
+			index = (index + 1) & (TABLE_SIZE - 1);
+
+		this->_table[index].Key      = key;
+		this->_table[index].Sent     = true;
+		this->_table[index].Deadline = CanBus::GetTick() + timeout;
+		this->_table[index].Request  = request;
+		this->_table[index].Done     = done;
+		this->_count++;
+	}
+
+	this->Send(key, request);
+	return true;
+}
+
+bool CanRpc::OnFrame(CanBus*, const CanBus::Frame& frame)
+{
+	if (!frame.IsExtended)
+		return false;
+
+	CanBus::CanId id = CanBus::CanId::FromValue(frame.Id);
+	if (id.Dst != this->_nodeId)
+		return false;
+
+	Completion done;
+	{
+		CanOs::CriticalSection section;
+
+		uint32_t index = this->Find(MakeKey(id.Src, id.Message));
+		if (index == TABLE_SIZE || !this->_table[index].Sent)
+			return false;
+
+		done = std::move(this->_table[index].Done);
+		this->Remove(index);
+	}
+
+	if (done)
+		done(Status::OK, frame);
+
+	return true;
+}
+
+void CanRpc::Poll()
+{
+	if (this->_count == 0)
+		return;
+
+	uint32_t now = CanBus::GetTick();
+	CanBus::Frame empty;
+
+	uint32_t index = 0;
+	while (index < TABLE_SIZE)
+	{
+		Completion done;
+		Status status   = Status::TIMEOUT;
+		uint16_t resend = EMPTY_KEY;
+		CanBus::Frame request;
+		{
+			CanOs::CriticalSection section;
+
+			Pending& pending = this->_table[index];
+			if (pending.Key == EMPTY_KEY)
+			{
+				index++;
+				continue;
+			}
+
+			if ((int32_t)(now - pending.Deadline) < 0)
+			{
+				index++;
+				if (pending.Sent)
+					continue;
+
+				pending.Sent = true;
+				resend       = pending.Key;
+				request      = pending.Request;
+			}
+			else
+			{
+				// Removing shifts a later entry into this slot, so the index is checked again
+				status = pending.Sent ? Status::TIMEOUT : Status::SEND_FAILED;
+				done   = std::move(pending.Done);
+				this->Remove(index);
+			}
+		}
+
+		if (resend != EMPTY_KEY)
+			this->Send(resend, request);
+		else if (done)
+			done(status, empty);
+	}
+}
+
+} // namespace PSR
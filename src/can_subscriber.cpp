@@ -0,0 +1,230 @@
+/**
+ * @file can_subscriber.cpp
+ * @author Purdue Solar Racing
+ * @brief CanId subscription and perfect hash dispatch implementation file
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_subscriber.hpp"
+
+#include <algorithm>
+
+namespace PSR
+{
+
+bool CanSubscriber::AddEntry(const Entry& entry)
+{
+	const Subscription& sub = entry.Sub;
+	if (this->_attached || sub.MessageFirst > sub.MessageLast || sub.MessageLast > 0x3F || sub.Type > 0x1F)
+		return false;
+
+	this->_entries.push_back(entry);
+
+	return true;
+}
+
+bool CanSubscriber::Subscribe(const Subscription& subscription, CanBus::Callback handler)
+{
+	return this->AddEntry(Entry(subscription, handler));
+}
+
+bool CanSubscriber::SubscribePooled(const Subscription& subscription, PooledCallback handler)
+{
+	return this->AddEntry(Entry(subscription, handler));
+}
+
+CanBus::Filter CanSubscriber::GetFilter() const
+{
+	CanBus::Filter filter;
+	filter.Type       = CanBus::FilterType::ID_MASK;
+	filter.IsExtended = true;
+	filter.Id         = 0;
+	filter.Mask       = 0;
+
+	if (this->_entries.empty())
+		return filter;
+
+	// Only fields that every subscription constrains can be part of the hardware mask
+	bool matchDst = true;
+	bool matchSrc = true;
+	for (const Entry& entry : this->_entries)
+	{
+		matchDst = matchDst && !entry.Sub.AnyDst;
+		matchSrc = matchSrc && !entry.Sub.AnySrc;
+	}
+
+	uint32_t fields = CanBus::CanId::TypeMask() | CanBus::CanId::MessageMask();
+	fields |= matchDst ? CanBus::CanId::DstMask().Value : 0;
+	fields |= matchSrc ? CanBus::CanId::SrcMask().Value : 0;
+
+	// Keep the bits that have the same value in every accepted identifier
+	uint32_t reference = 0;
+	uint32_t agree     = 0xFFFFFFFF;
+	bool first         = true;
+	for (const Entry& entry : this->_entries)
+	{
+		const Subscription& sub = entry.Sub;
+		uint8_t dsts[2]         = { sub.Dst, CanBus::CanId::MulticastDestination };
+		uint32_t dstCount       = sub.AnyDst ? 1 : (sub.Multicast ? 2 : 1);
+
+		for (uint32_t message = sub.MessageFirst; message <= sub.MessageLast; message++)
+		{
+			for (uint32_t i = 0; i < dstCount; i++)
+			{
+				uint32_t value = CanBus::CanId::FromParts(dsts[i], sub.Src, message, sub.Type, 0) & fields;
+				if (first)
+				{
+					reference = value;
+					first     = false;
+				}
+				agree &= ~(value ^ reference);
+			}
+		}
+	}
+
+	filter.Mask = agree & fields;
+	filter.Id   = reference & filter.Mask;
+	return filter;
+}
+
+bool CanSubscriber::BuildTable()
+{
+	this->_routes.clear();
+	for (size_t i = 0; i < this->_entries.size(); i++)
+	{
+		const Subscription& sub = this->_entries[i].Sub;
+		for (uint32_t message = sub.MessageFirst; message <= sub.MessageLast; message++)
+		{
+			Route route;
+			route.Key   = MakeKey(sub.Type, message);
+			route.Entry = (uint16_t)i;
+			this->_routes.push_back(route);
+		}
+	}
+
+	// Group the routes of each key while keeping subscription order within a key
+	std::stable_sort(this->_routes.begin(), this->_routes.end(), [](const Route& a, const Route& b) { return a.Key < b.Key; });
+
+	size_t keys = 0;
+	for (size_t i = 0; i < this->_routes.size(); i++)
+	{
+		if (i == 0 || this->_routes[i].Key != this->_routes[i - 1].Key)
+			keys++;
+	}
+
+	uint32_t bits = 0;
+	while ((1U << bits) < keys)
+		bits++;
+
+	// Search for a multiplier that maps every key to a distinct slot, growing the table if none is found
+	constexpr uint32_t seedAttempts = 256;
+	for (uint32_t tableBits = bits; tableBits <= bits + 3 && tableBits <= 11; tableBits++)
+	{
+		uint32_t size = 1U << tableBits;
+		for (uint32_t attempt = 0; attempt < seedAttempts; attempt++)
+		{
+			this->_seed  = 0x9E3779B1U + 2 * attempt;
+			this->_shift = 32 - tableBits;
+			if (tableBits == 0)
+			{
+				// A single key does not need hashing, a shift of 32 is not defined so the seed is cleared instead
+				this->_seed  = 0;
+				this->_shift = 0;
+			}
+
+			Slot empty;
+			empty.Key   = EMPTY_KEY;
+			empty.First = 0;
+			empty.Count = 0;
+			this->_table.assign(size, empty);
+
+			bool collision = false;
+			for (size_t i = 0; i < this->_routes.size() && !collision; i++)
+			{
+				Slot& slot = this->_table[this->Hash(this->_routes[i].Key)];
+				if (slot.Key == EMPTY_KEY)
+				{
+					slot.Key   = this->_routes[i].Key;
+					slot.First = (uint16_t)i;
+					slot.Count = 1;
+				}
+				else if (slot.Key == this->_routes[i].Key)
+				{
+					slot.Count++;
+				}
+				else
+				{
+					collision = true;
+				}
+			}
+
+			if (!collision)
+				return true;
+		}
+	}
+
+	this->_table.clear();
+	return false;
+}
+
+bool CanSubscriber::Attach(CanBus& bus, uint32_t fifo)
+{
+	if (this->_attached || this->_entries.empty())
+		return false;
+
+	if (!this->BuildTable())
+		return false;
+
+	// A failed attach leaves the subscriber free to try another bus or FIFO
+	if (!bus.AddRxCallback([this](CanBus* canbus, const CanBus::Frame& frame) { this->Dispatch(canbus, frame); }, this->GetFilter(), fifo))
+		return false;
+
+	this->_attached = true;
+	return true;
+}
+
+void CanSubscriber::Dispatch(CanBus* bus, const CanBus::Frame& frame) const
+{
+	if (!frame.IsExtended || this->_table.empty())
+		return;
+
+	CanBus::CanId id = CanBus::CanId::FromValue(frame.Id);
+	uint16_t key     = MakeKey(id.Type, id.Message);
+
+	const Slot& slot = this->_table[this->Hash(key)];
+	if (slot.Key != key)
+		return;
+
+	CanFramePool::Handle pooled;
+	bool stored = false;
+	for (uint32_t i = slot.First; i < (uint32_t)slot.First + slot.Count; i++)
+	{
+		const Entry& entry = this->_entries[this->_routes[i].Entry];
+		if (!entry.Sub.Accepts(id))
+			continue;
+
+		if (entry.Handler)
+		{
+			entry.Handler(bus, frame);
+			continue;
+		}
+
+		// The frame is stored for the first pooled handler, the ones after it share the same block
+		if (!stored)
+		{
+			pooled = CanFramePool::Allocate(frame);
+			stored = true;
+			if (!pooled)
+				this->_poolExhausted = this->_poolExhausted + 1;
+		}
+
+		if (pooled)
+			entry.Pooled(bus, pooled);
+	}
+}
+
+} // namespace PSR
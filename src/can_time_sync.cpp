@@ -0,0 +1,225 @@
+/**
+ * @file can_time_sync.cpp
+ * @author Purdue Solar Racing
+ * @brief Two step clock synchronization implementation file
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_time_sync.hpp"
+
+namespace PSR
+{
+
+CanTimeSync::CanTimeSync(CanBus& bus, const Config& config)
+	: _bus(&bus), _config(config), _syncFrame(), _followUpFrame(), _master(false), _sequence(0), _lastSync(0), _syncValid(false), _syncTime(0),
+	  _anchorShared(0), _anchorLocal(0), _drift(0), _anchored(false), _driftKnown(false), _synchronized(false), _syncs(0), _restarts(0),
+	  _chainedTxTimestamp()
+{
+	this->_syncFrame.Id         = CanBus::CanId::FromParts(CanBus::CanId::MulticastDestination, config.MasterSrc, GenericMessage::TIME_SYNC, config.MasterType,
+	                                                       CanBus::Priority::High);
+	this->_syncFrame.IsExtended = true;
+	this->_syncFrame.Length     = 1;
+
+	this->_followUpFrame.Id         = CanBus::CanId::FromParts(CanBus::CanId::MulticastDestination, config.MasterSrc, GenericMessage::TIME_FOLLOW_UP,
+	                                                           config.MasterType, CanBus::Priority::High);
+	this->_followUpFrame.IsExtended = true;
+	this->_followUpFrame.Length     = 8;
+}
+
+uint32_t CanTimeSync::StartOfFrame(const CanBus::Frame& frame) const
+{
+	if (CanBus::TIMESTAMP_AT_START_OF_FRAME || this->_config.Bitrate == 0)
+		return frame.Timestamp;
+
+	// The stamp is taken once the frame is complete, the interframe space has not passed yet
+	uint32_t bits = CanBus::EstimateFrameBits(frame) - 3;
+	return frame.Timestamp - (uint32_t)((uint64_t)bits * 1000000 / this->_config.Bitrate);
+}
+
+bool CanTimeSync::StartMaster()
+{
+#if PSR_CAN_MODE == 1
+	return false;
+#else
+	this->_master             = true;
+	this->_chainedTxTimestamp = this->_bus->TxTimestampEvent;
+
+	this->_bus->TxTimestampEvent = [this](const CanBus* bus, const CanBus::Frame& frame) {
+		if (frame.IsExtended && frame.Id == this->_syncFrame.Id)
+			this->OnTxTimestamp(frame);
+		else if (this->_chainedTxTimestamp)
+			this->_chainedTxTimestamp(bus, frame);
+	};
+
+	return true;
+#endif
+}
+
+bool CanTimeSync::StartFollower(uint32_t fifo)
+{
+	CanBus::Filter filter;
+	filter.Type       = CanBus::FilterType::DUAL;
+	filter.IsExtended = true;
+	filter.Id         = this->_syncFrame.Id;
+	filter.Id2        = this->_followUpFrame.Id;
+
+	this->_master = false;
+	return this->_bus->AddRxCallback([this](CanBus*, const CanBus::Frame& frame) { this->OnFrame(frame); }, filter, fifo);
+}
+
+void CanTimeSync::OnTxTimestamp(const CanBus::Frame& frame)
+{
+	CanOs::CriticalSection section;
+	this->_syncTime  = this->StartOfFrame(frame);
+	this->_syncValid = true;
+}
+
+void CanTimeSync::OnFrame(const CanBus::Frame& frame)
+{
+	// Every backend stamps received frames, a timestamp of 0 is a valid time once every 71 minutes
+	if (frame.Length < 1)
+		return;
+
+	if (frame.Id == this->_syncFrame.Id)
+	{
+		CanOs::CriticalSection section;
+		this->_sequence  = frame.Data.Bytes[0];
+		this->_syncTime  = this->StartOfFrame(frame);
+		this->_syncValid = true;
+		return;
+	}
+
+	// FOLLOW_UP is only used together with the SYNC it follows, a lost SYNC skips the whole sync
+	if (frame.Length < 8 || !this->_syncValid || frame.Data.Bytes[0] != this->_sequence)
+		return;
+
+	this->_syncValid = false;
+	this->Anchor(frame.Data.Words[1], this->_syncTime);
+}
+
+void CanTimeSync::Anchor(uint32_t shared, uint32_t local)
+{
+	int32_t drift    = this->_drift;
+	bool driftKnown  = this->_driftKnown;
+	uint32_t elapsed = local - this->_anchorLocal;
+
+	if (this->_anchored && elapsed != 0)
+	{
+		// Rate error over the interval between the two syncs, the master elapsed time is exact
+		int32_t error    = (int32_t)((shared - this->_anchorShared) - elapsed);
+		int64_t measured = (int64_t)error * 1000000000 / elapsed;
+		int64_t limit    = (int64_t)this->_config.MaxDrift * 1000;
+
+		if (measured > limit || measured < -limit)
+		{
+			// A jump of either clock, the estimate starts again from the new anchor
+			drift      = 0;
+			driftKnown = false;
+			this->_restarts++;
+		}
+		else if (!driftKnown)
+		{
+			drift      = (int32_t)measured;
+			driftKnown = true;
+		}
+		else
+		{
+			// Averaging over several syncs filters the jitter of single timestamps
+			drift += (int32_t)((measured - drift) / 4);
+		}
+	}
+
+	CanOs::CriticalSection section;
+	this->_anchorShared = shared;
+	this->_anchorLocal  = local;
+	this->_drift        = drift;
+	this->_driftKnown   = driftKnown;
+	this->_anchored     = true;
+	this->_synchronized = true;
+	this->_lastSync     = CanBus::GetTick();
+	this->_syncs++;
+}
+
+void CanTimeSync::Update()
+{
+	uint32_t now = CanBus::GetTick();
+
+	if (!this->_master)
+	{
+		if (this->_synchronized && now - this->_lastSync > this->_config.Timeout)
+			this->_synchronized = false;
+
+		return;
+	}
+
+	if (this->_syncValid)
+	{
+		CanBus::Frame followUp = this->_followUpFrame;
+		followUp.Data.Value    = 0;
+		{
+			CanOs::CriticalSection section;
+			followUp.Data.Bytes[0] = this->_sequence;
+			followUp.Data.Words[1] = this->_syncTime;
+		}
+
+		if (this->_bus->TryTransmit(followUp))
+			this->_syncValid = false;
+	}
+
+	if (now - this->_lastSync < this->_config.Period && this->_syncs != 0)
+		return;
+
+	// The sequence number is updated first, the TX event of the new SYNC can arrive before TransmitTimestamped returns
+	CanBus::Frame sync = this->_syncFrame;
+	{
+		CanOs::CriticalSection section;
+		this->_sequence++;
+		this->_syncValid   = false;
+		sync.Data.Value    = 0;
+		sync.Data.Bytes[0] = this->_sequence;
+	}
+
+	if (this->_bus->TransmitTimestamped(sync))
+	{
+		this->_lastSync = now;
+		this->_syncs++;
+	}
+}
+
+uint32_t CanTimeSync::ToShared(uint32_t local) const
+{
+	if (this->_master)
+		return local;
+
+	uint32_t shared;
+	uint32_t anchor;
+	int32_t drift;
+	{
+		CanOs::CriticalSection section;
+		shared = this->_anchorShared;
+		anchor = this->_anchorLocal;
+		drift  = this->_drift;
+	}
+
+	int32_t elapsed = (int32_t)(local - anchor);
+	return shared + elapsed + (int32_t)((int64_t)elapsed * drift / 1000000000);
+}
+
+CanTimeSync::Status CanTimeSync::GetStatus() const
+{
+	Status status;
+	CanOs::CriticalSection section;
+
+	status.Synchronized = this->IsSynchronized();
+	status.Offset       = this->_master ? 0 : (int32_t)(this->_anchorShared - this->_anchorLocal);
+	status.Drift        = this->_master ? 0 : this->_drift;
+	status.Syncs        = this->_syncs;
+	status.Restarts     = this->_restarts;
+	return status;
+}
+
+} // namespace PSR
@@ -0,0 +1,109 @@
+/**
+ * @file can_test.hpp
+ * @author Purdue Solar Racing
+ * @brief Minimal host test runner for the CAN library
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Tests are plain functions registered with CAN_TEST. A failed CHECK prints its location and marks the test as failed, the test keeps
+ * running so one run reports every broken expectation. Tests that need an environment the host lacks, like a CAN interface, skip.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace PSR
+{
+
+namespace CanTest
+{
+
+/**
+ * @brief A registered test
+ */
+struct Case
+{
+	const char* Name;
+	void (*Run)();
+};
+
+/**
+ * @brief Get the list of registered tests
+ */
+inline std::vector<Case>& Cases()
+{
+	static std::vector<Case> cases;
+	return cases;
+}
+
+/**
+ * @brief Get the number of failed checks of the running test
+ */
+inline uint32_t& Failures()
+{
+	static uint32_t failures = 0;
+	return failures;
+}
+
+/**
+ * @brief Get whether the running test was skipped because its environment is missing
+ */
+inline bool& Skipped()
+{
+	static bool skipped = false;
+	return skipped;
+}
+
+/**
+ * @brief Skip the running test, call before returning from it
+ *
+ * @param reason Printed with the test name
+ */
+inline void Skip(const char* reason)
+{
+	printf("  skipped: %s\n", reason);
+	Skipped() = true;
+}
+
+/**
+ * @brief Adds a test to the list when constructed at namespace scope
+ */
+struct Registration
+{
+	Registration(const char* name, void (*run)())
+	{
+		Cases().push_back({ name, run });
+	}
+};
+
+/**
+ * @brief Run every registered test whose name starts with a prefix
+ *
+ * @param prefix The prefix, nullptr runs every test
+ * @return int The number of failed tests
+ */
+int RunAll(const char* prefix);
+
+} // namespace CanTest
+
+} // namespace PSR
+
+#define CAN_TEST(name)                                                                                                                                                       \
+	static void name();                                                                                                                                                      \
+	static PSR::CanTest::Registration name##Registration(#name, name);                                                                                                      \
+	static void name()
+
+#define CHECK(condition)                                                                                                                                                     \
+	do                                                                                                                                                                       \
+	{                                                                                                                                                                        \
+		if (!(condition))                                                                                                                                                    \
+		{                                                                                                                                                                    \
+			printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);                                                                                           \
+			PSR::CanTest::Failures()++;                                                                                                                                      \
+		}                                                                                                                                                                    \
+	} while (0)
@@ -0,0 +1,53 @@
+/**
+ * @file main.cpp
+ * @author Purdue Solar Racing
+ * @brief Host test runner entry point
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_test.hpp"
+
+#include <cstring>
+
+using namespace PSR;
+
+int CanTest::RunAll(const char* prefix)
+{
+	int failed  = 0;
+	int run     = 0;
+	int skipped = 0;
+	for (const Case& test : Cases())
+	{
+		if (prefix != nullptr && strncmp(test.Name, prefix, strlen(prefix)) != 0)
+			continue;
+
+		Failures() = 0;
+		Skipped()  = false;
+		test.Run();
+
+		if (Skipped() && Failures() == 0)
+		{
+			printf("SKIP %s\n", test.Name);
+			skipped++;
+			continue;
+		}
+
+		run++;
+		printf("%s %s\n", Failures() == 0 ? "PASS" : "FAIL", test.Name);
+		if (Failures() != 0)
+			failed++;
+	}
+
+	printf("%d of %d tests passed, %d skipped\n", run - failed, run, skipped);
+	return failed;
+}
+
+int main(int argc, char** argv)
+{
+	// An optional argument selects the tests whose name starts with it
+	return CanTest::RunAll(argc > 1 ? argv[1] : nullptr) == 0 ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+/**
+ * @file test_coro.cpp
+ * @author Purdue Solar Racing
+ * @brief Tests of the coroutine executor on the simulated bus, built as C++20
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_coro.hpp"
+#include "can_sim.hpp"
+#include "can_test.hpp"
+
+#include <vector>
+
+using namespace PSR;
+
+/**
+ * @brief An executor attached to a bus shared with a peer controller
+ * @remark Initialized buses stay registered with the backend, so every test keeps its network in a static variable
+ */
+struct CoroNetwork
+{
+	CanSimBus SimBus;
+	CanSimController Controller;
+	CanSimController Peer;
+	CanBus Bus;
+	CanExecutor Executor;
+	bool Started;
+
+	CoroNetwork() : SimBus(500000), Controller("executor"), Peer("peer"), Bus(&Controller), Executor(), Started(false)
+	{
+		this->SimBus.Attach(this->Controller);
+		this->SimBus.Attach(this->Peer);
+		this->Started = this->Executor.Attach(this->Bus, AllExtended(), CanBus::RX_FIFO0) && this->Bus.Init();
+	}
+
+	/**
+	 * @brief Accept every extended identifier
+	 */
+	static CanBus::Filter AllExtended()
+	{
+		CanBus::Filter filter;
+		filter.Type       = CanBus::FilterType::ID_MASK;
+		filter.IsExtended = true;
+		filter.Id         = 0;
+		filter.Mask       = 0;
+		return filter;
+	}
+};
+
+/**
+ * @brief Build an extended frame
+ */
+static CanBus::Frame MakeFrame(uint32_t id, uint8_t data)
+{
+	CanBus::Frame frame;
+	frame.Id            = id;
+	frame.IsExtended    = true;
+	frame.Length        = 1;
+	frame.Data.Value    = 0;
+	frame.Data.Bytes[0] = data;
+	return frame;
+}
+
+/**
+ * @brief Records how a coroutine finished
+ */
+struct Result
+{
+	bool Done;
+	bool Value;
+	CanBus::Frame Frame;
+};
+
+static CanTask AwaitFrame(CoroNetwork& network, uint32_t id, uint32_t timeout, Result& result)
+{
+	CanBus::Filter filter = CoroNetwork::AllExtended();
+	filter.Id             = id;
+	filter.Mask           = CanBus::EXT_ID_MASK;
+
+	std::optional<CanBus::Frame> frame = co_await network.Executor.Next(network.Bus, filter, timeout);
+	result.Value                       = frame.has_value();
+	if (frame)
+		result.Frame = *frame;
+	result.Done = true;
+}
+
+static CanTask AwaitSend(CoroNetwork& network, CanBus::Frame frame, Result& result)
+{
+	result.Value = co_await network.Executor.Send(network.Bus, frame);
+	result.Done  = true;
+}
+
+static CanTask Idle()
+{
+	co_return;
+}
+
+CAN_TEST(CoroNextReceivesFrame)
+{
+	static CoroNetwork network;
+	CHECK(network.Started);
+
+	Result result = {};
+	CHECK(network.Executor.Spawn(AwaitFrame(network, 0x1234, CanExecutor::NO_TIMEOUT, result)));
+	network.Executor.Poll();
+
+	// Frames the filter of the coroutine rejects do not resume it
+	network.Peer.Queue(MakeFrame(0x1235, 1));
+	network.Peer.Queue(MakeFrame(0x1234, 2));
+	network.SimBus.RunUntil(CanSimBus::Now() + 1000000);
+	CHECK(!result.Done);
+
+	// Without a timeout the wait does not expire however long the frame takes
+	CanSimBus::Advance(1000000000);
+
+	network.Executor.Poll();
+	CHECK(result.Done);
+	CHECK(result.Value);
+	CHECK(result.Frame.Id == 0x1234);
+	CHECK(result.Frame.Data.Bytes[0] == 2);
+}
+
+CAN_TEST(CoroNextTimesOut)
+{
+	static CoroNetwork network;
+	CHECK(network.Started);
+
+	Result result = {};
+	CHECK(network.Executor.Spawn(AwaitFrame(network, 0x1234, 5, result)));
+	network.Executor.Poll();
+
+	CanSimBus::Advance(4000000);
+	network.Executor.Poll();
+	CHECK(!result.Done);
+
+	CanSimBus::Advance(1000000);
+	network.Executor.Poll();
+	CHECK(result.Done);
+	CHECK(!result.Value);
+}
+
+CAN_TEST(CoroSendCompletesAfterTransmission)
+{
+	static CoroNetwork network;
+	CHECK(network.Started);
+
+	Result result = {};
+	CHECK(network.Executor.Spawn(AwaitSend(network, MakeFrame(0x100, 1), result)));
+	network.Executor.Poll();
+	CHECK(!result.Done);
+
+	// The TX complete event counts the frame, the coroutine resumes on the next poll
+	CHECK(network.SimBus.Step());
+	CHECK(!result.Done);
+	network.Executor.Poll();
+	CHECK(result.Done);
+	CHECK(result.Value);
+}
+
+CAN_TEST(CoroSendFailsAtDeadline)
+{
+	static CoroNetwork network;
+	CHECK(network.Started);
+
+	// The bus is not stepped, so the first three frames stay in the mailboxes and the fourth never leaves the executor
+	Result results[4] = {};
+	for (uint32_t i = 0; i < 4; i++)
+		CHECK(network.Executor.Spawn(AwaitSend(network, MakeFrame(0x100 + i, (uint8_t)i), results[i])));
+	network.Executor.Poll();
+	CHECK(network.Controller.FreeMailboxes() == 0);
+
+	CanSimBus::Advance((CanExecutor::SEND_TIMEOUT - 1) * 1000000ULL);
+	network.Executor.Poll();
+	for (const Result& result : results)
+		CHECK(!result.Done);
+
+	CanSimBus::Advance(1000000);
+	network.Executor.Poll();
+	for (const Result& result : results)
+	{
+		CHECK(result.Done);
+		CHECK(!result.Value);
+	}
+}
+
+CAN_TEST(CoroBlockedSendsQueueOldestFirst)
+{
+	static CoroNetwork network;
+	CHECK(network.Started);
+
+	// The last three sends find the mailboxes full, their identifiers descend so arbitration cannot hide the order they are queued in
+	const uint32_t ids[6] = { 0x100, 0x101, 0x102, 0x202, 0x201, 0x200 };
+	Result results[6]     = {};
+	for (uint32_t i = 0; i < 6; i++)
+		CHECK(network.Executor.Spawn(AwaitSend(network, MakeFrame(ids[i], (uint8_t)i), results[i])));
+	network.Executor.Poll();
+	CHECK(network.Controller.FreeMailboxes() == 0);
+
+	for (uint32_t blocked = 3; blocked < 6; blocked++)
+	{
+		CHECK(network.SimBus.Step());
+		network.Executor.Poll();
+
+		bool queued = false;
+		for (const CanSimController::Mailbox& mailbox : network.Controller.Mailboxes)
+			queued = queued || (mailbox.Pending && mailbox.Frame.Id == ids[blocked]);
+		CHECK(queued);
+	}
+
+	network.SimBus.RunUntil(CanSimBus::Now() + 10000000);
+	network.Executor.Poll();
+	for (const Result& result : results)
+	{
+		CHECK(result.Done);
+		CHECK(result.Value);
+	}
+}
+
+CAN_TEST(CoroSpawnFailsWhenPoolIsExhausted)
+{
+	static CoroNetwork network;
+	CHECK(network.Started);
+
+	std::vector<void*> held;
+	while (void* block = CanCoroutinePool::Allocate(CanCoroutinePool::BLOCK_SIZE))
+		held.push_back(block);
+	CHECK(CanCoroutinePool::Available() == 0);
+
+	CHECK(!network.Executor.Spawn(Idle()));
+
+	for (void* block : held)
+		CanCoroutinePool::Free(block);
+
+	size_t available = CanCoroutinePool::Available();
+	CHECK(network.Executor.Spawn(Idle()));
+	CHECK(CanCoroutinePool::Available() == available - 1);
+	network.Executor.Poll();
+	CHECK(CanCoroutinePool::Available() == available);
+}
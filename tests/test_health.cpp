@@ -0,0 +1,71 @@
+/**
+ * @file test_health.cpp
+ * @author Purdue Solar Racing
+ * @brief Tests of throttling on the simulated bus
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_lib.hpp"
+#include "can_sim.hpp"
+#include "can_test.hpp"
+
+using namespace PSR;
+
+using CanId = CanBus::CanId;
+
+/**
+ * @brief Raise the throttle level of a bus to 1 by reporting an error passive controller for one load window
+ */
+static void StartThrottling(CanBus& bus, CanSimController& controller)
+{
+	CanBus::HealthConfig health;
+	health.LoadWindow = 10;
+	health.ThrottleId = 0;
+	bus.SetHealthConfig(health);
+
+	controller.TxErrors = 130;
+	CanSimBus::Advance(health.LoadWindow * 1000000ULL);
+	bus.UpdateHealth();
+	controller.TxErrors = 0;
+}
+
+/**
+ * @brief Offer a frame with a free mailbox, so only throttling can refuse it
+ */
+static bool Offer(CanBus& bus, CanSimController& controller, uint32_t id)
+{
+	for (CanSimController::Mailbox& mailbox : controller.Mailboxes)
+		mailbox.Pending = false;
+
+	CanBus::Frame frame;
+	frame.Id         = id;
+	frame.IsExtended = true;
+	frame.Length     = 0;
+	return bus.TryTransmit(frame);
+}
+
+CAN_TEST(HealthThrottlesEachMessageSeparately)
+{
+	CanSimController controller("health");
+	CanBus bus(&controller);
+	StartThrottling(bus, controller);
+	CHECK(bus.GetHealthStatus().ThrottleLevel == 1);
+
+	// Interleaved messages must each keep every second frame, a shared count would send all of one and none of the other
+	uint32_t first   = CanId::FromParts(0x20, 0x10, 1, 0, 0);
+	uint32_t second  = CanId::FromParts(0x20, 0x10, 2, 0, 0);
+	uint32_t sent[2] = { 0, 0 };
+	for (uint32_t i = 0; i < 8; i++)
+	{
+		sent[0] += Offer(bus, controller, first) ? 1 : 0;
+		sent[1] += Offer(bus, controller, second) ? 1 : 0;
+	}
+
+	CHECK(sent[0] == 4);
+	CHECK(sent[1] == 4);
+	CHECK(bus.GetHealthStatus().ThrottledFrames == 8);
+}
@@ -0,0 +1,218 @@
+/**
+ * @file test_router.cpp
+ * @author Purdue Solar Racing
+ * @brief Tests of the gateway between simulated buses
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_router.hpp"
+#include "can_sim.hpp"
+#include "can_test.hpp"
+
+#include <vector>
+
+using namespace PSR;
+
+/**
+ * @brief A frame seen on a destination bus
+ */
+struct SentFrame
+{
+	uint32_t Id;
+	uint8_t Data;
+};
+
+/**
+ * @brief A source bus with a sender and two destination buses, the router owns one controller on each
+ * @remark Initialized buses stay registered with the backend, so every test keeps its network in a static variable
+ */
+struct RouterNetwork
+{
+	CanSimBus SourceBus;
+	CanSimBus FirstBus;
+	CanSimBus SecondBus;
+	CanSimController Sender;
+	CanSimController SourceController;
+	CanSimController FirstController;
+	CanSimController SecondController;
+	CanBus Source;
+	CanBus First;
+	CanBus Second;
+	CanRouter Router;
+	std::vector<SentFrame> FirstSent;
+	std::vector<SentFrame> SecondSent;
+
+	RouterNetwork()
+		: SourceBus(500000), FirstBus(500000), SecondBus(500000), Sender("sender"), SourceController("router source"), FirstController("router first"),
+		  SecondController("router second"), Source(&SourceController), First(&FirstController), Second(&SecondController), Router(), FirstSent(),
+		  SecondSent()
+	{
+		this->SourceBus.Attach(this->Sender);
+		this->SourceBus.Attach(this->SourceController);
+		this->FirstBus.Attach(this->FirstController);
+		this->SecondBus.Attach(this->SecondController);
+
+		this->FirstBus.Sent = [this](const CanSimController&, const CanBus::Frame& frame, uint64_t, uint64_t, uint64_t)
+		{
+			this->FirstSent.push_back({ frame.Id, frame.Data.Bytes[0] });
+		};
+		this->SecondBus.Sent = [this](const CanSimController&, const CanBus::Frame& frame, uint64_t, uint64_t, uint64_t)
+		{
+			this->SecondSent.push_back({ frame.Id, frame.Data.Bytes[0] });
+		};
+	}
+
+	/**
+	 * @brief Initialize the buses once every route is added
+	 */
+	bool Init()
+	{
+		return this->Source.Init() && this->First.Init() && this->Second.Init();
+	}
+
+	/**
+	 * @brief Send a standard frame on the source bus, the router forwards it from the receive interrupt
+	 */
+	void Send(uint32_t id, uint8_t data)
+	{
+		CanBus::Frame frame;
+		frame.Id            = id;
+		frame.IsExtended    = false;
+		frame.Length        = 1;
+		frame.Data.Value    = 0;
+		frame.Data.Bytes[0] = data;
+
+		this->Sender.Queue(frame);
+		this->SourceBus.Step();
+	}
+};
+
+/**
+ * @brief Accept every standard identifier
+ */
+static CanBus::Filter AllStandard()
+{
+	CanBus::Filter filter;
+	filter.Type       = CanBus::FilterType::RANGE;
+	filter.IsExtended = false;
+	filter.Id         = 0;
+	filter.Id2        = CanBus::STD_ID_MASK;
+	return filter;
+}
+
+CAN_TEST(RouterQueuesByPriorityThenArrival)
+{
+	static RouterNetwork network;
+	uint32_t route;
+	CHECK(network.Router.AddRoute(CanRouter::Route(network.Source, AllStandard(), network.First), CanBus::RX_FIFO0, route));
+	CHECK(network.Init());
+
+	// The first bus is not stepped, so the first three frames fill its mailboxes and the rest wait in the router
+	network.Send(0x010, 0);
+	network.Send(0x011, 1);
+	network.Send(0x012, 2);
+	CHECK(network.FirstController.FreeMailboxes() == 0);
+
+	network.Send(0x300, 3);
+	network.Send(0x100, 4);
+	network.Send(0x200, 5);
+	network.Send(0x100, 6);
+	CHECK(network.Router.GetQueueHighWater(network.First) == 4);
+
+	network.FirstBus.RunUntil(CanSimBus::Now() + 10000000);
+
+	const SentFrame expected[] = { { 0x010, 0 }, { 0x011, 1 }, { 0x012, 2 }, { 0x100, 4 }, { 0x100, 6 }, { 0x200, 5 }, { 0x300, 3 } };
+	CHECK(network.FirstSent.size() == 7);
+	for (uint32_t i = 0; i < 7 && i < network.FirstSent.size(); i++)
+	{
+		CHECK(network.FirstSent[i].Id == expected[i].Id);
+		CHECK(network.FirstSent[i].Data == expected[i].Data);
+	}
+
+	CanRouter::Counters counters = network.Router.GetCounters(route);
+	CHECK(counters.Forwarded == 7);
+	CHECK(counters.RateLimited == 0);
+	CHECK(counters.Overflowed == 0);
+}
+
+CAN_TEST(RouterCountsOverflow)
+{
+	static RouterNetwork network;
+	uint32_t route;
+	CHECK(network.Router.AddRoute(CanRouter::Route(network.Source, AllStandard(), network.First), CanBus::RX_FIFO0, route));
+	CHECK(network.Init());
+
+	// Three frames take the mailboxes, the queue holds QUEUE_SIZE more and the last two are dropped
+	uint32_t total = CanSimController::TX_MAILBOXES + CanRouter::QUEUE_SIZE + 2;
+	for (uint32_t i = 0; i < total; i++)
+		network.Send(0x100 + i, (uint8_t)i);
+
+	CanRouter::Counters counters = network.Router.GetCounters(route);
+	CHECK(counters.Forwarded == CanSimController::TX_MAILBOXES + CanRouter::QUEUE_SIZE);
+	CHECK(counters.Overflowed == 2);
+	CHECK(network.Router.GetQueueHighWater(network.First) == CanRouter::QUEUE_SIZE);
+
+	network.FirstBus.RunUntil(CanSimBus::Now() + 100000000);
+	CHECK(network.FirstSent.size() == CanSimController::TX_MAILBOXES + CanRouter::QUEUE_SIZE);
+}
+
+CAN_TEST(RouterLimitsRate)
+{
+	static RouterNetwork network;
+	uint32_t route;
+	CHECK(network.Router.AddRoute(CanRouter::Route(network.Source, AllStandard(), network.First).Limit(100, 2), CanBus::RX_FIFO0, route));
+	CHECK(network.Init());
+
+	// The burst lets two frames through back to back, at 100 frames per second one more is earned every 10 ms
+	for (uint8_t i = 0; i < 5; i++)
+		network.Send(0x100, i);
+
+	CanRouter::Counters counters = network.Router.GetCounters(route);
+	CHECK(counters.Forwarded == 2);
+	CHECK(counters.RateLimited == 3);
+
+	network.FirstBus.RunUntil(CanSimBus::Now() + 10000000);
+	network.Send(0x100, 5);
+	network.Send(0x100, 6);
+
+	counters = network.Router.GetCounters(route);
+	CHECK(counters.Forwarded == 3);
+	CHECK(counters.RateLimited == 4);
+	CHECK(counters.Overflowed == 0);
+
+	network.FirstBus.RunUntil(CanSimBus::Now() + 10000000);
+	CHECK(network.FirstSent.size() == 3);
+	if (network.FirstSent.size() == 3)
+		CHECK(network.FirstSent[2].Data == 5);
+}
+
+CAN_TEST(RouterRewritesAndFansOut)
+{
+	static RouterNetwork network;
+	uint32_t unchanged;
+	uint32_t rewritten;
+	CHECK(network.Router.AddRoute(CanRouter::Route(network.Source, AllStandard(), network.First), CanBus::RX_FIFO0, unchanged));
+	CHECK(network.Router.AddRoute(CanRouter::Route(network.Source, AllStandard(), network.Second).Rewrite(0x0F0, 0x050), CanBus::RX_FIFO0, rewritten));
+	CHECK(network.Init());
+
+	network.Send(0x123, 7);
+	network.FirstBus.RunUntil(CanSimBus::Now() + 1000000);
+	network.SecondBus.RunUntil(CanSimBus::Now() + 1000000);
+
+	CHECK(network.FirstSent.size() == 1);
+	CHECK(network.SecondSent.size() == 1);
+	if (network.FirstSent.size() == 1 && network.SecondSent.size() == 1)
+	{
+		CHECK(network.FirstSent[0].Id == 0x123);
+		CHECK(network.SecondSent[0].Id == 0x153);
+		CHECK(network.FirstSent[0].Data == 7);
+		CHECK(network.SecondSent[0].Data == 7);
+	}
+
+	CHECK(network.Router.GetCounters(unchanged).Forwarded == 1);
+	CHECK(network.Router.GetCounters(rewritten).Forwarded == 1);
+}
@@ -0,0 +1,323 @@
+/**
+ * @file test_rpc.cpp
+ * @author Purdue Solar Racing
+ * @brief Tests of the request/response layer on the simulated bus
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_rpc.hpp"
+#include "can_sim.hpp"
+#include "can_test.hpp"
+
+#include <vector>
+
+using namespace PSR;
+
+using CanId = CanBus::CanId;
+
+static constexpr uint8_t NODE_ID = 0x10;
+
+/**
+ * @brief Build a request from this node to a peer
+ */
+static CanBus::Frame MakeRequest(uint8_t peer, uint8_t message)
+{
+	CanBus::Frame frame;
+	frame.Id            = CanId::FromParts(peer, NODE_ID, message, 0, 0);
+	frame.IsExtended    = true;
+	frame.Length        = 1;
+	frame.Data.Bytes[0] = message;
+	return frame;
+}
+
+/**
+ * @brief Build the reply of a peer to a request of this node
+ */
+static CanBus::Frame MakeReply(uint8_t peer, uint8_t message)
+{
+	CanBus::Frame frame;
+	frame.Id            = CanId::FromParts(NODE_ID, peer, message, 0, 0);
+	frame.IsExtended    = true;
+	frame.Length        = 1;
+	frame.Data.Bytes[0] = peer;
+	return frame;
+}
+
+/**
+ * @brief The slot a request to a peer hashes to, the same hash as CanRpc
+ */
+static uint32_t HomeOf(uint8_t peer, uint8_t message)
+{
+	uint32_t key = ((uint32_t)peer << 6) | message;
+	return ((key * 0x9E3779B1U) >> 16) & (2 * CanRpc::MAX_PENDING - 1);
+}
+
+/**
+ * @brief Records how a request completed
+ */
+struct Outcome
+{
+	uint32_t Calls;
+	CanRpc::Status Status;
+	uint8_t Peer;
+
+	CanRpc::Completion Recorder()
+	{
+		return [this](CanRpc::Status status, const CanBus::Frame& reply)
+		{
+			this->Calls++;
+			this->Status = status;
+			this->Peer   = reply.Data.Bytes[0];
+		};
+	}
+};
+
+/**
+ * @brief Free the transmit mailboxes of a controller that is not attached to a bus
+ */
+static void ClearMailboxes(CanSimController& controller)
+{
+	for (CanSimController::Mailbox& mailbox : controller.Mailboxes)
+		mailbox.Pending = false;
+}
+
+CAN_TEST(RpcReplyCompletesRequest)
+{
+	CanSimController controller("rpc");
+	CanBus bus(&controller);
+	CanRpc rpc(bus, NODE_ID);
+
+	Outcome outcome = {};
+	CHECK(rpc.Request(MakeRequest(0x20, 5), 100, outcome.Recorder()));
+	CHECK(rpc.PendingCount() == 1);
+	CHECK(controller.FreeMailboxes() == CanSimController::TX_MAILBOXES - 1);
+
+	// A reply from another peer or to another message does not match
+	CHECK(!rpc.OnFrame(&bus, MakeReply(0x21, 5)));
+	CHECK(!rpc.OnFrame(&bus, MakeReply(0x20, 6)));
+	CHECK(outcome.Calls == 0);
+
+	CHECK(rpc.OnFrame(&bus, MakeReply(0x20, 5)));
+	CHECK(outcome.Calls == 1);
+	CHECK(outcome.Status == CanRpc::Status::OK);
+	CHECK(outcome.Peer == 0x20);
+	CHECK(rpc.PendingCount() == 0);
+
+	// A second reply finds no request
+	CHECK(!rpc.OnFrame(&bus, MakeReply(0x20, 5)));
+	CHECK(outcome.Calls == 1);
+}
+
+CAN_TEST(RpcRejectsDuplicateAndStandardRequests)
+{
+	CanSimController controller("rpc");
+	CanBus bus(&controller);
+	CanRpc rpc(bus, NODE_ID);
+
+	Outcome outcome = {};
+	CHECK(rpc.Request(MakeRequest(0x20, 5), 100, outcome.Recorder()));
+	CHECK(!rpc.Request(MakeRequest(0x20, 5), 100, outcome.Recorder()));
+
+	CanBus::Frame standard = MakeRequest(0x20, 6);
+	standard.IsExtended    = false;
+	CHECK(!rpc.Request(standard, 100, outcome.Recorder()));
+	CHECK(rpc.PendingCount() == 1);
+}
+
+CAN_TEST(RpcTableHoldsMaxPending)
+{
+	CanSimController controller("rpc");
+	CanBus bus(&controller);
+	CanRpc rpc(bus, NODE_ID);
+
+	std::vector<Outcome> outcomes(CanRpc::MAX_PENDING + 1, Outcome {});
+	for (uint32_t i = 0; i < CanRpc::MAX_PENDING; i++)
+	{
+		ClearMailboxes(controller);
+		CHECK(rpc.Request(MakeRequest((uint8_t)(0x40 + i), 1), 100, outcomes[i].Recorder()));
+	}
+	CHECK(!rpc.Request(MakeRequest(0x80, 1), 100, outcomes[CanRpc::MAX_PENDING].Recorder()));
+	CHECK(rpc.PendingCount() == CanRpc::MAX_PENDING);
+
+	// Every request is still found after the ones before it were removed, in an order unrelated to the probe sequences
+	for (uint32_t i = 0; i < CanRpc::MAX_PENDING; i++)
+	{
+		uint32_t peer = 0x40 + (i * 7) % CanRpc::MAX_PENDING;
+		CHECK(rpc.OnFrame(&bus, MakeReply((uint8_t)peer, 1)));
+		CHECK(outcomes[peer - 0x40].Calls == 1);
+	}
+	CHECK(rpc.PendingCount() == 0);
+}
+
+CAN_TEST(RpcRemoveShiftsCollidingEntriesBack)
+{
+	CanSimController controller("rpc");
+	CanBus bus(&controller);
+	CanRpc rpc(bus, NODE_ID);
+
+	// Four peers share one home slot and one more hashes to the slot after it, so its entry is displaced by the chain
+	std::vector<uint8_t> chain;
+	uint8_t neighbour = 0;
+	uint32_t home     = HomeOf(0, 1);
+	for (uint32_t peer = 0; peer < 256; peer++)
+	{
+		if (chain.size() < 4 && HomeOf((uint8_t)peer, 1) == home)
+			chain.push_back((uint8_t)peer);
+		else if (neighbour == 0 && HomeOf((uint8_t)peer, 1) == ((home + 1) & (2 * CanRpc::MAX_PENDING - 1)))
+			neighbour = (uint8_t)peer;
+	}
+	CHECK(chain.size() == 4);
+	CHECK(neighbour != 0);
+
+	std::vector<uint8_t> peers = chain;
+	peers.insert(peers.begin() + 1, neighbour);
+
+	std::vector<Outcome> outcomes(peers.size(), Outcome {});
+	for (size_t i = 0; i < peers.size(); i++)
+	{
+		ClearMailboxes(controller);
+		CHECK(rpc.Request(MakeRequest(peers[i], 1), 100, outcomes[i].Recorder()));
+	}
+
+	// Removing from the middle of the chain must pull the later entries back past the gap
+	CHECK(rpc.OnFrame(&bus, MakeReply(chain[1], 1)));
+	CHECK(rpc.OnFrame(&bus, MakeReply(chain[0], 1)));
+	CHECK(rpc.OnFrame(&bus, MakeReply(neighbour, 1)));
+	CHECK(rpc.OnFrame(&bus, MakeReply(chain[3], 1)));
+	CHECK(rpc.OnFrame(&bus, MakeReply(chain[2], 1)));
+
+	for (size_t i = 0; i < peers.size(); i++)
+	{
+		CHECK(outcomes[i].Calls == 1);
+		CHECK(outcomes[i].Peer == peers[i]);
+	}
+	CHECK(rpc.PendingCount() == 0);
+}
+
+CAN_TEST(RpcPollTimesOutExpiredRequests)
+{
+	CanSimController controller("rpc");
+	CanBus bus(&controller);
+	CanRpc rpc(bus, NODE_ID);
+
+	Outcome shortOutcome = {};
+	Outcome longOutcome  = {};
+	CHECK(rpc.Request(MakeRequest(0x20, 1), 10, shortOutcome.Recorder()));
+	CHECK(rpc.Request(MakeRequest(0x21, 1), 50, longOutcome.Recorder()));
+
+	rpc.Poll();
+	CHECK(shortOutcome.Calls == 0);
+
+	CanSimBus::Advance(20 * 1000000ULL);
+	rpc.Poll();
+	CHECK(shortOutcome.Calls == 1);
+	CHECK(shortOutcome.Status == CanRpc::Status::TIMEOUT);
+	CHECK(longOutcome.Calls == 0);
+	CHECK(rpc.PendingCount() == 1);
+
+	// A late reply is not matched, the request already completed
+	CHECK(!rpc.OnFrame(&bus, MakeReply(0x20, 1)));
+	CHECK(shortOutcome.Calls == 1);
+
+	CanSimBus::Advance(40 * 1000000ULL);
+	rpc.Poll();
+	CHECK(longOutcome.Calls == 1);
+	CHECK(longOutcome.Status == CanRpc::Status::TIMEOUT);
+	CHECK(rpc.PendingCount() == 0);
+}
+
+CAN_TEST(RpcUnsentRequestIsRetriedByPoll)
+{
+	CanSimController controller("rpc");
+	CanBus bus(&controller);
+	CanRpc rpc(bus, NODE_ID);
+
+	CanBus::Frame other = MakeRequest(0x30, 2);
+	for (uint32_t i = 0; i < CanSimController::TX_MAILBOXES; i++)
+		CHECK(bus.TryTransmit(other));
+
+	// Every mailbox is busy, the request is registered but not sent and replies to it are ignored
+	Outcome outcome = {};
+	CHECK(rpc.Request(MakeRequest(0x20, 1), 50, outcome.Recorder()));
+	CHECK(controller.FreeMailboxes() == 0);
+	CHECK(!rpc.OnFrame(&bus, MakeReply(0x20, 1)));
+
+	rpc.Poll();
+	CHECK(outcome.Calls == 0);
+
+	ClearMailboxes(controller);
+	rpc.Poll();
+	CHECK(controller.FreeMailboxes() == CanSimController::TX_MAILBOXES - 1);
+	CHECK(controller.Mailboxes[0].Frame.Id == MakeRequest(0x20, 1).Id);
+
+	CHECK(rpc.OnFrame(&bus, MakeReply(0x20, 1)));
+	CHECK(outcome.Calls == 1);
+	CHECK(outcome.Status == CanRpc::Status::OK);
+}
+
+CAN_TEST(RpcUnsentRequestFailsAtDeadline)
+{
+	CanSimController controller("rpc");
+	CanBus bus(&controller);
+	CanRpc rpc(bus, NODE_ID);
+
+	CanBus::Frame other = MakeRequest(0x30, 2);
+	for (uint32_t i = 0; i < CanSimController::TX_MAILBOXES; i++)
+		CHECK(bus.TryTransmit(other));
+
+	Outcome outcome = {};
+	CHECK(rpc.Request(MakeRequest(0x20, 1), 10, outcome.Recorder()));
+
+	CanSimBus::Advance(20 * 1000000ULL);
+	rpc.Poll();
+	CHECK(outcome.Calls == 1);
+	CHECK(outcome.Status == CanRpc::Status::SEND_FAILED);
+	CHECK(rpc.PendingCount() == 0);
+}
+
+CAN_TEST(RpcRoundTripOnSimulatedBus)
+{
+	// Buses stay registered with the library once initialized, so this fixture lives for the whole run
+	static CanSimBus simBus(500000);
+	static CanSimController requesterController("requester");
+	static CanSimController responderController("responder");
+	static CanBus requester(&requesterController);
+	static CanBus responder(&responderController);
+	static CanRpc rpc(requester, NODE_ID);
+
+	simBus.Attach(requesterController);
+	simBus.Attach(responderController);
+	CHECK(requester.Init());
+	CHECK(responder.Init());
+	CHECK(rpc.Attach(CanBus::RX_FIFO0));
+
+	// The responder answers every request addressed to peer 0x20 with its own ID
+	CanBus::Filter filter;
+	filter.Type       = CanBus::FilterType::ID_MASK;
+	filter.IsExtended = true;
+	filter.Id         = CanId::FromParts(0x20, 0, 0, 0, 0);
+	filter.Mask       = CanId::DstMask();
+	CHECK(responder.AddRxCallback(
+		[](CanBus* bus, const CanBus::Frame& frame)
+		{
+			CanId id = CanId::FromValue(frame.Id);
+			bus->TryTransmit(MakeReply(0x20, (uint8_t)id.Message));
+		},
+		filter, CanBus::RX_FIFO0));
+
+	Outcome first  = {};
+	Outcome second = {};
+	CHECK(rpc.Request(MakeRequest(0x20, 3), 100, first.Recorder()));
+	CHECK(rpc.Request(MakeRequest(0x20, 4), 100, second.Recorder()));
+	while (simBus.Step()) {}
+
+	CHECK(first.Calls == 1);
+	CHECK(first.Status == CanRpc::Status::OK);
+	CHECK(second.Calls == 1);
+	CHECK(second.Status == CanRpc::Status::OK);
+	CHECK(rpc.PendingCount() == 0);
+}
@@ -0,0 +1,165 @@
+/**
+ * @file test_socketcan.cpp
+ * @author Purdue Solar Racing
+ * @brief Tests of the SocketCAN backend on a virtual CAN interface
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ * Two buses are opened on the same interface, `vcan0` unless CAN_TEST_INTERFACE names another one. A virtual interface delivers every
+ * frame to the other sockets on it, so the second bus plays the peer node. The tests skip when the interface cannot be opened.
+ */
+
+#include "can_lib.hpp"
+#include "can_test.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+using namespace PSR;
+
+/**
+ * @brief Wait until a condition holds, the dispatch thread runs the callbacks and events
+ *
+ * @return bool Whether the condition held within a second
+ */
+template <typename Condition>
+static bool WaitFor(Condition condition)
+{
+	for (uint32_t i = 0; i < 1000; i++)
+	{
+		if (condition())
+			return true;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	return condition();
+}
+
+/**
+ * @brief The two buses shared by the tests, opened once since buses stay registered with the dispatch thread
+ */
+struct VirtualBus
+{
+	CanBus::Interface NodeInterface;
+	CanBus::Interface PeerInterface;
+	CanBus Node;
+	CanBus Peer;
+	bool Open;
+
+	std::atomic<uint32_t> TxComplete;
+	std::atomic<uint32_t> TxStamped;
+	std::atomic<uint32_t> NodeReceived;
+	std::atomic<uint32_t> PeerReceived;
+
+	VirtualBus()
+		: NodeInterface({ Name(), -1 }), PeerInterface({ Name(), -1 }), Node(&NodeInterface), Peer(&PeerInterface), Open(false), TxComplete(0), TxStamped(0),
+		  NodeReceived(0), PeerReceived(0)
+	{
+		// The node only accepts 0x100, the peer accepts every standard identifier
+		CanBus::Filter nodeFilter;
+		nodeFilter.Type       = CanBus::FilterType::ID_MASK;
+		nodeFilter.IsExtended = false;
+		nodeFilter.Id         = 0x100;
+		nodeFilter.Mask       = CanBus::STD_ID_MASK;
+		this->Node.AddRxCallback([this](CanBus*, const CanBus::Frame&) { this->NodeReceived++; }, nodeFilter, CanBus::RX_FIFO0);
+
+		CanBus::Filter peerFilter = nodeFilter;
+		peerFilter.Mask           = 0;
+		this->Peer.AddRxCallback([this](CanBus*, const CanBus::Frame&) { this->PeerReceived++; }, peerFilter, CanBus::RX_FIFO0);
+
+		this->Node.TxCompleteEvent  = [this](const CanBus*) { this->TxComplete++; };
+		this->Node.TxTimestampEvent = [this](const CanBus*, const CanBus::Frame&) { this->TxStamped++; };
+
+		this->Open = this->Node.Init() && this->Peer.Init();
+	}
+
+	static const char* Name()
+	{
+		const char* name = getenv("CAN_TEST_INTERFACE");
+		return name != nullptr ? name : "vcan0";
+	}
+
+	static VirtualBus& Get()
+	{
+		static VirtualBus bus;
+		return bus;
+	}
+};
+
+/**
+ * @brief Build a standard data frame
+ */
+static CanBus::Frame MakeFrame(uint32_t id)
+{
+	CanBus::Frame frame;
+	frame.Id         = id;
+	frame.IsExtended = false;
+	frame.Length     = 8;
+	frame.Data.Value = 0x0123456789ABCDEFULL;
+	return frame;
+}
+
+CAN_TEST(SocketCanEchoOfFilteredOutIdCompletesTransmit)
+{
+	VirtualBus& bus = VirtualBus::Get();
+	if (!bus.Open)
+		return CanTest::Skip("the CAN interface could not be opened");
+
+	// 0x200 matches no filter of the node, its echo must still come back as the transmit confirmation
+	uint32_t complete = bus.TxComplete;
+	uint32_t peer     = bus.PeerReceived;
+	CHECK(bus.Node.Transmit(MakeFrame(0x200)));
+	CHECK(WaitFor([&]() { return bus.TxComplete == complete + 1; }));
+	CHECK(WaitFor([&]() { return bus.PeerReceived == peer + 1; }));
+	CHECK(bus.NodeReceived == 0);
+}
+
+CAN_TEST(SocketCanTimestampedEchoIsMatched)
+{
+	VirtualBus& bus = VirtualBus::Get();
+	if (!bus.Open)
+		return CanTest::Skip("the CAN interface could not be opened");
+
+	uint32_t stamped = bus.TxStamped;
+	for (uint32_t i = 0; i < 4; i++)
+		CHECK(bus.Node.TransmitTimestamped(MakeFrame(0x300 + i)));
+
+	CHECK(WaitFor([&]() { return bus.TxStamped == stamped + 4; }));
+}
+
+CAN_TEST(SocketCanTransmitForWaitsOnEcho)
+{
+	VirtualBus& bus = VirtualBus::Get();
+	if (!bus.Open)
+		return CanTest::Skip("the CAN interface could not be opened");
+
+	// A burst larger than the interface queue needs the echoes to wake TransmitFor
+	uint32_t complete = bus.TxComplete;
+	for (uint32_t i = 0; i < 64; i++)
+		CHECK(bus.Node.TransmitFor(MakeFrame(0x400), 100));
+
+	CHECK(WaitFor([&]() { return bus.TxComplete == complete + 64; }));
+}
+
+CAN_TEST(SocketCanOwnIdFromPeerIsFiltered)
+{
+	VirtualBus& bus = VirtualBus::Get();
+	if (!bus.Open)
+		return CanTest::Skip("the CAN interface could not be opened");
+
+	// The echo filter for 0x200 also lets frames of the peer with that identifier through the kernel, they must not reach the node
+	CHECK(bus.Node.Transmit(MakeFrame(0x200)));
+	CHECK(bus.Peer.Transmit(MakeFrame(0x200)));
+	CHECK(bus.Peer.Transmit(MakeFrame(0x100)));
+	CHECK(WaitFor([&]() { return bus.NodeReceived == 1; }));
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CanBus::Frame frame;
+	CHECK(!bus.Node.Receive(frame));
+	CHECK(bus.NodeReceived == 1);
+}
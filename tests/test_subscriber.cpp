@@ -0,0 +1,116 @@
+/**
+ * @file test_subscriber.cpp
+ * @author Purdue Solar Racing
+ * @brief Tests of pooled subscriptions and packed frames
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_frame_pool.hpp"
+#include "can_sim.hpp"
+#include "can_subscriber.hpp"
+#include "can_test.hpp"
+
+#include <vector>
+
+using namespace PSR;
+
+using CanId = CanBus::CanId;
+
+/**
+ * @brief Build an extended frame following the CanId layout
+ */
+static CanBus::Frame MakeFrame(uint8_t message)
+{
+	CanBus::Frame frame;
+	frame.Id         = CanId::FromParts(0x20, 0x10, message, 3, 0);
+	frame.IsExtended = true;
+	frame.Length     = 8;
+	frame.Timestamp  = 0x12345678;
+	frame.Data.Value = 0x0123456789ABCDEFULL;
+	return frame;
+}
+
+CAN_TEST(SubscriberPooledHandlersShareOneFrame)
+{
+	CanSubscriber subscriber;
+	std::vector<CanFramePool::Handle> kept;
+	uint32_t copies = 0;
+
+	CHECK(subscriber.SubscribePooled(CanSubscriber::Subscription(3), [&kept](CanBus*, const CanFramePool::Handle& frame) { kept.push_back(frame); }));
+	CHECK(subscriber.SubscribePooled(CanSubscriber::Subscription(3).Message(5), [&kept](CanBus*, const CanFramePool::Handle& frame) { kept.push_back(frame); }));
+	CHECK(subscriber.Subscribe(CanSubscriber::Subscription(3), [&copies](CanBus*, const CanBus::Frame&) { copies++; }));
+
+	CanSimController controller("subscriber");
+	CanBus bus(&controller);
+	CHECK(subscriber.Attach(bus, CanBus::RX_FIFO0));
+
+	size_t available = CanFramePool::Available();
+	subscriber.Dispatch(&bus, MakeFrame(5));
+
+	CHECK(copies == 1);
+	CHECK(kept.size() == 2);
+	CHECK(CanFramePool::Available() == available - 1);
+	if (kept.size() == 2)
+	{
+		CHECK(&*kept[0] == &*kept[1]);
+		CHECK(kept[0].References() == 2);
+		CHECK(kept[0]->Id() == MakeFrame(5).Id);
+	}
+
+	kept.clear();
+	CHECK(CanFramePool::Available() == available);
+	CHECK(subscriber.GetPoolExhaustedCount() == 0);
+}
+
+CAN_TEST(SubscriberCountsExhaustedPool)
+{
+	CanSubscriber subscriber;
+	uint32_t calls = 0;
+	CHECK(subscriber.SubscribePooled(CanSubscriber::Subscription(3), [&calls](CanBus*, const CanFramePool::Handle&) { calls++; }));
+
+	CanSimController controller("subscriber");
+	CanBus bus(&controller);
+	CHECK(subscriber.Attach(bus, CanBus::RX_FIFO0));
+
+	std::vector<CanFramePool::Handle> held;
+	while (CanFramePool::Available() > 0)
+		held.push_back(CanFramePool::Allocate(MakeFrame(1)));
+
+	subscriber.Dispatch(&bus, MakeFrame(1));
+	CHECK(calls == 0);
+	CHECK(subscriber.GetPoolExhaustedCount() == 1);
+
+	held.clear();
+	subscriber.Dispatch(&bus, MakeFrame(1));
+	CHECK(calls == 1);
+}
+
+CAN_TEST(PackedFrameDoesNotKeepTimestamp)
+{
+	CanBus::Frame frame  = MakeFrame(7);
+	CanBus::Frame packed = CanBus::PackedFrame::FromFrame(frame).ToFrame();
+
+	CHECK(packed.Id == frame.Id);
+	CHECK(packed.IsExtended);
+	CHECK(packed.Length == 8);
+	CHECK(packed.Data.Value == frame.Data.Value);
+	CHECK(packed.Timestamp == 0);
+}
+
+CAN_TEST(SubscriberCanRetryFailedAttach)
+{
+	CanSubscriber subscriber;
+	CHECK(subscriber.Subscribe(CanSubscriber::Subscription(3), [](CanBus*, const CanBus::Frame&) {}));
+
+	CanSimController controller("subscriber");
+	CanBus bus(&controller);
+
+	// The backend rejects the FIFO, so the subscriber is not attached and may try again
+	CHECK(!subscriber.Attach(bus, 2));
+	CHECK(subscriber.Attach(bus, CanBus::RX_FIFO0));
+	CHECK(!subscriber.Attach(bus, CanBus::RX_FIFO0));
+}
@@ -0,0 +1,173 @@
+/**
+ * @file test_time_sync.cpp
+ * @author Purdue Solar Racing
+ * @brief Tests of clock synchronization between simulated controllers with offset and drifting clocks
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#include "can_sim.hpp"
+#include "can_test.hpp"
+#include "can_time_sync.hpp"
+
+using namespace PSR;
+
+/**
+ * @brief A master and a follower on one bus
+ * @remark Initialized buses stay registered with the backend, so every test keeps its network in a static variable
+ */
+struct SyncNetwork
+{
+	CanSimBus Bus;
+	CanSimController MasterController;
+	CanSimController FollowerController;
+	CanBus Master;
+	CanBus Follower;
+	CanTimeSync MasterSync;
+	CanTimeSync FollowerSync;
+	bool Started;
+
+	SyncNetwork(int64_t masterOffset, int32_t masterDrift, int64_t followerOffset, int32_t followerDrift)
+		: Bus(500000), MasterController("master"), FollowerController("follower"), Master(&MasterController), Follower(&FollowerController),
+		  MasterSync(Master, CanTimeSync::Config()), FollowerSync(Follower, CanTimeSync::Config()), Started(false)
+	{
+		this->MasterController.ClockOffset   = masterOffset;
+		this->MasterController.ClockDrift    = masterDrift;
+		this->FollowerController.ClockOffset = followerOffset;
+		this->FollowerController.ClockDrift  = followerDrift;
+
+		this->Bus.Attach(this->MasterController);
+		this->Bus.Attach(this->FollowerController);
+
+		this->Started = this->MasterSync.StartMaster() && this->FollowerSync.StartFollower(CanBus::RX_FIFO0) && this->Master.Init() && this->Follower.Init();
+	}
+
+	/**
+	 * @brief Run both nodes from a 1 ms main loop
+	 *
+	 * @param ms The time to run in milliseconds
+	 */
+	void Run(uint32_t ms)
+	{
+		for (uint32_t i = 0; i < ms; i++)
+		{
+			this->MasterSync.Update();
+			this->FollowerSync.Update();
+			this->Bus.RunUntil(CanSimBus::Now() + 1000000);
+		}
+	}
+
+	/**
+	 * @brief Get the shared time of the follower minus the time of the master at the same instant in microseconds
+	 */
+	int32_t Error() const
+	{
+		return (int32_t)(this->FollowerSync.Now() - this->Master.GetTimestamp());
+	}
+};
+
+/**
+ * @brief Get the magnitude of a signed value
+ */
+static uint32_t Magnitude(int32_t value)
+{
+	return value < 0 ? (uint32_t)-value : (uint32_t)value;
+}
+
+CAN_TEST(TimeSyncFollowsOffsetAndDrift)
+{
+	// 37 ms apart and 200 ppm faster, the error would grow by 20 us between syncs without the drift estimate
+	static SyncNetwork network(5000000, -100, 42000000, 100);
+	CHECK(network.Started);
+
+	network.Run(50);
+	CHECK(network.FollowerSync.IsSynchronized());
+
+	network.Run(2000);
+	CanTimeSync::Status status = network.FollowerSync.GetStatus();
+	CHECK(status.Synchronized);
+	CHECK(status.Syncs >= 19);
+	CHECK(status.Restarts == 0);
+
+	// The master clock runs 200 ppm slower than the follower clock
+	CHECK(status.Drift < -195000 && status.Drift > -205000);
+
+	// The error must stay within the 100 us target at every point between syncs, not only right after one
+	uint32_t worst = 0;
+	for (uint32_t i = 0; i < 500; i++)
+	{
+		network.Run(1);
+		uint32_t error = Magnitude(network.Error());
+		worst          = error > worst ? error : worst;
+	}
+
+	CHECK(worst <= 2);
+	CHECK(network.FollowerSync.GetStatus().Restarts == 0);
+}
+
+CAN_TEST(TimeSyncRestartsAfterClockJump)
+{
+	static SyncNetwork network(0, 50, 1000000, -50);
+	CHECK(network.Started);
+
+	network.Run(1000);
+	CHECK(network.FollowerSync.GetStatus().Restarts == 0);
+	CHECK(Magnitude(network.Error()) <= 2);
+
+	// A 5 ms jump of the follower clock is far beyond MaxDrift over one sync period
+	network.FollowerController.ClockOffset += 5000000;
+	network.Run(150);
+	CHECK(network.FollowerSync.GetStatus().Restarts == 1);
+
+	// The estimate starts again from the new anchor and converges to the same drift, the master clock runs 100 ppm faster
+	network.Run(2000);
+	CanTimeSync::Status status = network.FollowerSync.GetStatus();
+	CHECK(status.Restarts == 1);
+	CHECK(status.Drift > 95000 && status.Drift < 105000);
+	CHECK(Magnitude(network.Error()) <= 2);
+}
+
+CAN_TEST(TimeSyncSkipsLostSync)
+{
+	static SyncNetwork network(0, 0, 3000000, 150);
+	CHECK(network.Started);
+
+	network.Run(1000);
+
+	// Finish the sync in progress, the next SYNC is then most of a period away
+	uint32_t syncs = network.MasterSync.GetStatus().Syncs;
+	while (network.MasterSync.GetStatus().Syncs == syncs)
+		network.Run(1);
+	network.Run(10);
+
+	CanTimeSync::Status before = network.FollowerSync.GetStatus();
+	CHECK(before.Syncs >= 9);
+
+	// Let the master queue the next SYNC, then take the follower off the bus while SYNC is sent so it only sees the FOLLOW_UP
+	syncs = network.MasterSync.GetStatus().Syncs;
+	while (network.MasterSync.GetStatus().Syncs == syncs)
+	{
+		network.MasterSync.Update();
+		if (network.MasterSync.GetStatus().Syncs == syncs)
+			CanSimBus::Advance(1000000);
+	}
+
+	network.FollowerController.TxErrors = 256;
+	CHECK(network.Bus.Step());
+	network.FollowerController.TxErrors = 0;
+
+	// The FOLLOW_UP goes out with the next update, the follower must not pair it with the previous SYNC
+	network.Run(50);
+	CanTimeSync::Status after = network.FollowerSync.GetStatus();
+	CHECK(after.Syncs == before.Syncs);
+	CHECK(after.Restarts == 0);
+	CHECK(Magnitude(network.Error()) <= 2);
+
+	// The next complete sync is taken again
+	network.Run(100);
+	CHECK(network.FollowerSync.GetStatus().Syncs == before.Syncs + 1);
+	CHECK(network.FollowerSync.GetStatus().Restarts == 0);
+}